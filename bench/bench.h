@@ -0,0 +1,102 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+/** Kernel checks and benchmarks: common parts <BR>
+  * ========================================================================<BR>
+  * Each program checks every kernel this CPU can run against the scalar one,
+  * on random vectors of random length and alignment.  Run with "bench", it
+  * also reports the throughput of each kernel.
+  *
+  * The kernels are static in their modules and picked at runtime, so each
+  * program includes the module source rather than linking it.  This header
+  * is only ever included once per program.
+  */
+
+#ifndef bench_h
+#define bench_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define _MAXLEN     8192
+#define _VECTORS    4000
+#define _BENCH_MS   200
+
+#if defined(__x86_64__) || defined(__i386__)
+#   define _CPU(FEATURE)    __builtin_cpu_supports(FEATURE)
+#   define _CPU_INIT()      __builtin_cpu_init()
+#else
+#   define _CPU(FEATURE)    0
+#   define _CPU_INIT()      do { } while(0)
+#endif
+
+#define _NUMKERNELS(TABLE)  (sizeof(TABLE)/sizeof(kernel_t))
+#define _NUMSIZES(TABLE)    (sizeof(TABLE)/sizeof(size_t))
+
+typedef struct {
+    const char* name;
+    void*       fn;
+    bool        usable;
+} kernel_t;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+static int failures = 0;
+
+
+
+static uint64_t sub_rand(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void sub_randfill(uint8_t* dst, size_t size) {
+    for (size_t i=0; i<size; i++) {
+        dst[i] = (uint8_t)sub_rand();
+    }
+}
+
+static double sub_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + ((double)now.tv_nsec / 1e9);
+}
+
+static void sub_fail(const char* kernel, size_t len, size_t offset) {
+    fprintf(stderr, "FAIL: %s (length %zu, offset %zu)\n", kernel, len, offset);
+    failures++;
+}
+
+static void sub_report(const char* kernel, size_t size, size_t bytes, double secs) {
+    printf("  %-16s %6zu B  %8.2f GB/s\n", kernel, size, (double)bytes / secs / 1e9);
+}
+
+static bool sub_isbench(int argc, char** argv) {
+    return (argc > 1) && (strcmp(argv[1], "bench") == 0);
+}
+
+static int sub_result(const char* checks) {
+    printf("%s checks: %s (%d failures)\n", checks, (failures == 0) ? "PASS" : "FAIL", failures);
+    return (failures == 0) ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,361 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+/** Text codec kernels <BR>
+  * ========================================================================<BR>
+  * The scalar kernels are checked with known answers, and every other
+  * kernel is checked against them.
+  *
+  * Usage: codecbench [bench]
+  */
+
+#include "../main/codec.c"
+#include "bench.h"
+
+
+typedef size_t (*hexencfn_t)(char*, const uint8_t*, size_t);
+typedef size_t (*hexdecfn_t)(uint8_t*, const char*, size_t);
+typedef size_t (*b64decfn_t)(uint8_t*, const char*, size_t, size_t*);
+
+
+
+
+/** Hex Encode <BR>
+  * ========================================================================<BR>
+  */
+static kernel_t hexenc_kernels[] = {
+    { "hexenc scalar",  (void*)&sub_hexenc_scalar, true },
+#   if defined(_CODEC_X86)
+    { "hexenc ssse3",   (void*)&sub_hexenc_ssse3, false },
+    { "hexenc avx2",    (void*)&sub_hexenc_avx2, false },
+#   endif
+};
+
+static kernel_t hexsp_kernels[] = {
+    { "hexenc_sp scalar", (void*)&sub_hexenc_sp_scalar, true },
+#   if defined(_CODEC_X86)
+    { "hexenc_sp ssse3",  (void*)&sub_hexenc_sp_ssse3, false },
+#   endif
+};
+
+#define _NUMHEXENC  _NUMKERNELS(hexenc_kernels)
+#define _NUMHEXSP   _NUMKERNELS(hexsp_kernels)
+
+static void sub_hexenc_setup(void) {
+#   if defined(_CODEC_X86)
+    hexenc_kernels[1].usable = _CPU("ssse3");
+    hexenc_kernels[2].usable = _CPU("avx2");
+    hexsp_kernels[1].usable  = _CPU("ssse3");
+#   endif
+}
+
+static void sub_hexenc_check(uint8_t* buf) {
+    static char ref[3*_MAXLEN];
+    static char out[3*_MAXLEN];
+
+    if ((sub_hexenc_scalar(ref, (const uint8_t*)"\x01\xAB\xF0", 3) != 6) || (memcmp(ref, "01ABF0", 6) != 0)) {
+        sub_fail("hexenc scalar", 3, 0);
+    }
+    if ((sub_hexenc_sp_scalar(ref, (const uint8_t*)"\x01\xAB", 2) != 6) || (memcmp(ref, "01 AB ", 6) != 0)) {
+        sub_fail("hexenc_sp scalar", 2, 0);
+    }
+
+    for (int v=0; v<_VECTORS; v++) {
+        size_t offset   = sub_rand() % 16;
+        size_t len      = sub_rand() % ((_MAXLEN/2) - 16);
+        size_t reflen;
+
+        reflen = sub_hexenc_scalar(ref, &buf[offset], len);
+        for (size_t k=1; k<_NUMHEXENC; k++) {
+            if (hexenc_kernels[k].usable
+            && ((((hexencfn_t)hexenc_kernels[k].fn)(out, &buf[offset], len) != reflen) || (memcmp(out, ref, reflen) != 0))) {
+                sub_fail(hexenc_kernels[k].name, len, offset);
+            }
+        }
+        reflen = sub_hexenc_sp_scalar(ref, &buf[offset], len);
+        for (size_t k=1; k<_NUMHEXSP; k++) {
+            if (hexsp_kernels[k].usable
+            && ((((hexencfn_t)hexsp_kernels[k].fn)(out, &buf[offset], len) != reflen) || (memcmp(out, ref, reflen) != 0))) {
+                sub_fail(hexsp_kernels[k].name, len, offset);
+            }
+        }
+    }
+}
+
+static void sub_hexenc_bench(uint8_t* buf) {
+    static const size_t sizes[] = { 64, 1024, 4096 };
+    static char text[3*_MAXLEN];
+
+    printf("Hex encode (bytes in)\n");
+    for (size_t s=0; s<_NUMSIZES(sizes); s++) {
+        for (size_t k=0; k<(_NUMHEXENC+_NUMHEXSP); k++) {
+            kernel_t* kernel = (k < _NUMHEXENC) ? &hexenc_kernels[k] : &hexsp_kernels[k-_NUMHEXENC];
+            size_t bytes = 0;
+            double start;
+            double secs;
+
+            if (kernel->usable == false) {
+                continue;
+            }
+            start = sub_now();
+            do {
+                for (int i=0; i<256; i++) {
+                    ((hexencfn_t)kernel->fn)(text, buf, sizes[s]);
+                }
+                bytes  += 256 * sizes[s];
+                secs    = sub_now() - start;
+            } while (secs < (_BENCH_MS / 1000.0));
+            sub_report(kernel->name, sizes[s], bytes, secs);
+        }
+    }
+}
+
+
+
+
+/** Hex Decode <BR>
+  * ========================================================================<BR>
+  */
+static kernel_t hexdec_kernels[] = {
+    { "hexdec scalar",  (void*)&sub_hexdec_scalar, true },
+#   if defined(_CODEC_X86)
+    { "hexdec ssse3",   (void*)&sub_hexdec_ssse3, false },
+    { "hexdec avx2",    (void*)&sub_hexdec_avx2, false },
+#   endif
+};
+
+#define _NUMHEXDEC  _NUMKERNELS(hexdec_kernels)
+
+static void sub_hexdec_setup(void) {
+#   if defined(_CODEC_X86)
+    hexdec_kernels[1].usable = _CPU("ssse3");
+    hexdec_kernels[2].usable = _CPU("avx2");
+#   endif
+}
+
+static void sub_hexdec_check(uint8_t* buf) {
+    static const char digits[] = "0123456789abcdefABCDEF";
+    static char ref[3*_MAXLEN];
+    static uint8_t refbin[_MAXLEN];
+    static uint8_t outbin[_MAXLEN];
+
+    for (int v=0; v<_VECTORS; v++) {
+        size_t offset   = sub_rand() % 16;
+        size_t len      = sub_rand() % ((_MAXLEN/2) - 16);
+        size_t reflen;
+        size_t refout;
+
+        // Mixed-case hex of the source bytes, odd lengths, and one bad char in
+        // half of them.  Decoding stops at the bad char, and everything
+        // before it must come back as the source.
+        reflen = 2*len + (v & 2 ? 1 : 0);
+        for (size_t i=0; i<reflen; i++) {
+            uint8_t nib = (i & 1) ? (buf[offset + i/2] & 15) : (buf[offset + i/2] >> 4);
+            ref[offset+i] = digits[((nib > 9) && (sub_rand() & 1)) ? (nib + 6) : nib];
+        }
+        refout = reflen;
+        if ((v & 1) && (reflen > 0)) {
+            static const char badchars[] = "gG/:@`\x80 \n";
+            refout = sub_rand() % reflen;
+            ref[offset + refout] = badchars[sub_rand() % (sizeof(badchars)-1)];
+        }
+        if ((sub_hexdec_scalar(refbin, &ref[offset], reflen) != refout)
+        || (memcmp(refbin, &buf[offset], refout/2) != 0)) {
+            sub_fail("hexdec scalar", reflen, offset);
+        }
+        for (size_t k=1; k<_NUMHEXDEC; k++) {
+            size_t decout;
+            if (hexdec_kernels[k].usable == false) {
+                continue;
+            }
+            decout = ((hexdecfn_t)hexdec_kernels[k].fn)(outbin, &ref[offset], reflen);
+            if ((decout != refout) || (memcmp(outbin, refbin, refout/2) != 0)) {
+                sub_fail(hexdec_kernels[k].name, reflen, offset);
+            }
+        }
+    }
+}
+
+static void sub_hexdec_bench(uint8_t* buf) {
+    static const size_t sizes[] = { 64, 1024, 4096 };
+    static char text[3*_MAXLEN];
+    static uint8_t bin[_MAXLEN];
+
+    printf("Hex decode (chars in)\n");
+    sub_hexenc_scalar(text, buf, _MAXLEN);
+    for (size_t s=0; s<_NUMSIZES(sizes); s++) {
+        for (size_t k=0; k<_NUMHEXDEC; k++) {
+            size_t bytes = 0;
+            double start;
+            double secs;
+
+            if (hexdec_kernels[k].usable == false) {
+                continue;
+            }
+            start = sub_now();
+            do {
+                for (int i=0; i<256; i++) {
+                    ((hexdecfn_t)hexdec_kernels[k].fn)(bin, text, sizes[s]);
+                }
+                bytes  += 256 * sizes[s];
+                secs    = sub_now() - start;
+            } while (secs < (_BENCH_MS / 1000.0));
+            sub_report(hexdec_kernels[k].name, sizes[s], bytes, secs);
+        }
+    }
+}
+
+
+
+
+/** Base64 Encode and Decode <BR>
+  * ========================================================================<BR>
+  */
+static kernel_t b64enc_kernels[] = {
+    { "b64enc scalar",  (void*)&sub_b64enc_scalar, true },
+#   if defined(_CODEC_X86)
+    { "b64enc ssse3",   (void*)&sub_b64enc_ssse3, false },
+#   endif
+};
+
+static kernel_t b64dec_kernels[] = {
+    { "b64dec scalar",  (void*)&sub_b64dec_scalar, true },
+#   if defined(_CODEC_X86)
+    { "b64dec ssse3",   (void*)&sub_b64dec_ssse3, false },
+#   endif
+};
+
+#define _NUMB64ENC  _NUMKERNELS(b64enc_kernels)
+#define _NUMB64DEC  _NUMKERNELS(b64dec_kernels)
+
+static void sub_b64_setup(void) {
+#   if defined(_CODEC_X86)
+    b64enc_kernels[1].usable = _CPU("ssse3");
+    b64dec_kernels[1].usable = _CPU("ssse3");
+#   endif
+}
+
+static void sub_b64_check(uint8_t* buf) {
+    static char ref[2*_MAXLEN];
+    static char out[2*_MAXLEN];
+    static uint8_t refbin[2*_MAXLEN];
+    static uint8_t outbin[2*_MAXLEN];
+
+    if ((sub_b64enc_scalar(ref, (const uint8_t*)"\xFB\xFF\x01\x02", 4) != 8) || (memcmp(ref, "+/8BAg==", 8) != 0)) {
+        sub_fail("b64enc scalar", 4, 0);
+    }
+
+    for (int v=0; v<_VECTORS; v++) {
+        size_t offset   = sub_rand() % 16;
+        size_t len      = sub_rand() % ((_MAXLEN/2) - 16);
+        size_t reflen;
+        size_t refout;
+        size_t refbad;
+
+        reflen = sub_b64enc_scalar(ref, &buf[offset], len);
+        for (size_t k=1; k<_NUMB64ENC; k++) {
+            if (b64enc_kernels[k].usable
+            && ((((hexencfn_t)b64enc_kernels[k].fn)(out, &buf[offset], len) != reflen) || (memcmp(out, ref, reflen) != 0))) {
+                sub_fail(b64enc_kernels[k].name, len, offset);
+            }
+        }
+
+        // The scalar decoder has to give back the input, and the others have
+        // to agree with it, including on truncated and corrupted text
+        refout = sub_b64dec_scalar(refbin, ref, reflen, &refbad);
+        if ((refout != len) || (refbad != reflen) || (memcmp(refbin, &buf[offset], len) != 0)) {
+            sub_fail("b64dec scalar round trip", len, offset);
+        }
+        if ((v & 1) && (reflen > 0)) {
+            if (v & 2) {
+                static const char badchars[] = "!-_.:=\x80 \n";
+                ref[sub_rand() % reflen] = badchars[sub_rand() % (sizeof(badchars)-1)];
+            }
+            else {
+                reflen -= sub_rand() % 4;
+            }
+        }
+        refout = sub_b64dec_scalar(refbin, ref, reflen, &refbad);
+        for (size_t k=1; k<_NUMB64DEC; k++) {
+            size_t decout;
+            size_t bad;
+            if (b64dec_kernels[k].usable == false) {
+                continue;
+            }
+            decout = ((b64decfn_t)b64dec_kernels[k].fn)(outbin, ref, reflen, &bad);
+            if ((decout != refout) || (bad != refbad) || (memcmp(outbin, refbin, refout) != 0)) {
+                sub_fail(b64dec_kernels[k].name, reflen, offset);
+            }
+        }
+    }
+}
+
+static void sub_b64_bench(uint8_t* buf) {
+    static const size_t sizes[] = { 64, 1024, 4096 };
+    static char text[2*_MAXLEN];
+    static uint8_t bin[2*_MAXLEN];
+
+    printf("Base64 encode (bytes in) and decode (chars in)\n");
+    sub_b64enc_scalar(text, buf, _MAXLEN);
+    for (size_t s=0; s<_NUMSIZES(sizes); s++) {
+        for (size_t k=0; k<(_NUMB64ENC+_NUMB64DEC); k++) {
+            kernel_t* kernel = (k < _NUMB64ENC) ? &b64enc_kernels[k] : &b64dec_kernels[k-_NUMB64ENC];
+            size_t bytes = 0;
+            size_t bad;
+            double start;
+            double secs;
+
+            if (kernel->usable == false) {
+                continue;
+            }
+            start = sub_now();
+            do {
+                for (int i=0; i<256; i++) {
+                    if (k < _NUMB64ENC) ((hexencfn_t)kernel->fn)(text, buf, sizes[s]);
+                    else                ((b64decfn_t)kernel->fn)(bin, text, sizes[s], &bad);
+                }
+                bytes  += 256 * sizes[s];
+                secs    = sub_now() - start;
+            } while (secs < (_BENCH_MS / 1000.0));
+            sub_report(kernel->name, sizes[s], bytes, secs);
+        }
+    }
+}
+
+
+
+
+int main(int argc, char** argv) {
+    static uint8_t buf[_MAXLEN + 64];
+    int rc;
+
+    _CPU_INIT();
+    sub_hexenc_setup();
+    sub_hexdec_setup();
+    sub_b64_setup();
+    sub_randfill(buf, sizeof(buf));
+
+    sub_hexenc_check(buf);
+    sub_hexdec_check(buf);
+    sub_b64_check(buf);
+    rc = sub_result("Codec");
+    if ((rc == 0) && sub_isbench(argc, argv)) {
+        sub_hexenc_bench(buf);
+        sub_hexdec_bench(buf);
+        sub_b64_bench(buf);
+    }
+    return rc;
+}
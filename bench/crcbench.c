@@ -0,0 +1,146 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+/** CRC16 and Modbus CRC kernels <BR>
+  * ========================================================================<BR>
+  * The bytewise kernels are checked with known answers, and every other
+  * kernel is checked against them.  crc_calc_partial() is checked to give the
+  * CRC of the whole when a block is done in two pieces.
+  *
+  * Usage: crcbench [bench]
+  */
+
+#include "../main/crc_calc_block.c"
+#include "bench.h"
+
+
+typedef uint16_t (*crcfn_t)(uint16_t, const uint8_t*, size_t);
+
+static kernel_t crc16_kernels[] = {
+    { "crc16 bytewise", (void*)&sub_crc16_bytewise, true },
+    { "crc16 slice4",   (void*)&sub_crc16_slice4, true },
+    { "crc16 slice8",   (void*)&sub_crc16_slice8, true },
+#   if defined(_CRC_CLMUL)
+    { "crc16 clmul",    (void*)&sub_crc16_clmul, false },
+#   endif
+};
+
+static kernel_t mbcrc_kernels[] = {
+    { "mbcrc bytewise", (void*)&sub_mbcrc_bytewise, true },
+    { "mbcrc slice4",   (void*)&sub_mbcrc_slice4, true },
+    { "mbcrc slice8",   (void*)&sub_mbcrc_slice8, true },
+#   if defined(_CRC_CLMUL)
+    { "mbcrc clmul",    (void*)&sub_mbcrc_clmul, false },
+#   endif
+};
+
+#define _NUMCRC _NUMKERNELS(crc16_kernels)
+
+
+
+static void sub_crc_setup(void) {
+/// The first CRC builds the tables, and the CLMUL constants if the CPU has it
+    uint8_t dummy = 0;
+    crc_calc_block(&dummy, 1);
+#   if defined(_CRC_CLMUL)
+    crc16_kernels[_NUMCRC-1].usable = (_CPU("pclmul") && _CPU("ssse3"));
+    mbcrc_kernels[_NUMCRC-1].usable = crc16_kernels[_NUMCRC-1].usable;
+#   endif
+}
+
+static void sub_crc_check(uint8_t* buf) {
+    // The bytewise kernels are the references, so they get known answers,
+    // taken from the table-driven CRC that came before the sliced ones
+    static const uint8_t katvec[9] = "123456789";
+    if (sub_crc16_bytewise(0xFFFF, katvec, 9) != 0xAEE7) {
+        sub_fail("crc16 bytewise", 9, 0);
+    }
+    if (sub_mbcrc_bytewise(0xFFFF, katvec, 9) != 0x4B37) {
+        sub_fail("mbcrc bytewise", 9, 0);
+    }
+
+    for (int v=0; v<_VECTORS; v++) {
+        size_t offset   = sub_rand() % 16;
+        size_t len      = sub_rand() % (_MAXLEN - 16);
+        uint16_t init   = (v & 1) ? 0xFFFF : (uint16_t)sub_rand();
+        uint16_t ref16  = sub_crc16_bytewise(init, &buf[offset], len);
+        uint16_t refmb  = sub_mbcrc_bytewise(init, &buf[offset], len);
+        size_t split    = (len > 0) ? (sub_rand() % len) : 0;
+
+        for (size_t k=1; k<_NUMCRC; k++) {
+            if (crc16_kernels[k].usable
+            && (((crcfn_t)crc16_kernels[k].fn)(init, &buf[offset], len) != ref16)) {
+                sub_fail(crc16_kernels[k].name, len, offset);
+            }
+            if (mbcrc_kernels[k].usable
+            && (((crcfn_t)mbcrc_kernels[k].fn)(init, &buf[offset], len) != refmb)) {
+                sub_fail(mbcrc_kernels[k].name, len, offset);
+            }
+        }
+
+        // Incremental CRC in two pieces matches the CRC of the whole
+        if (crc_calc_partial(crc_calc_partial(init, &buf[offset], split), &buf[offset+split], len-split) != ref16) {
+            sub_fail("crc_calc_partial", len, offset);
+        }
+    }
+}
+
+static void sub_crc_bench(uint8_t* buf) {
+    static const size_t sizes[] = { 16, 64, 256, 1024, 8000 };
+
+    printf("CRC kernels\n");
+    for (int t=0; t<2; t++) {
+        kernel_t* kernels = (t == 0) ? crc16_kernels : mbcrc_kernels;
+        for (size_t k=0; k<_NUMCRC; k++) {
+            if (kernels[k].usable == false) {
+                continue;
+            }
+            for (size_t s=0; s<_NUMSIZES(sizes); s++) {
+                volatile uint16_t sink = 0;
+                size_t bytes = 0;
+                double start = sub_now();
+                double secs;
+                do {
+                    for (int i=0; i<256; i++) {
+                        sink ^= ((crcfn_t)kernels[k].fn)(0xFFFF, buf, sizes[s]);
+                    }
+                    bytes  += 256 * sizes[s];
+                    secs    = sub_now() - start;
+                } while (secs < (_BENCH_MS / 1000.0));
+                sub_report(kernels[k].name, sizes[s], bytes, secs);
+            }
+        }
+    }
+}
+
+
+
+
+int main(int argc, char** argv) {
+    static uint8_t buf[_MAXLEN + 64];
+    int rc;
+
+    _CPU_INIT();
+    sub_crc_setup();
+    sub_randfill(buf, sizeof(buf));
+
+    sub_crc_check(buf);
+    rc = sub_result("CRC");
+    if ((rc == 0) && sub_isbench(argc, argv)) {
+        sub_crc_bench(buf);
+    }
+    return rc;
+}
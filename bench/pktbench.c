@@ -0,0 +1,320 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+/** Packet list under sustained RX load <BR>
+  * ========================================================================<BR>
+  * MPipe frames of 24 to 300 bytes come in bursts, and each burst is queued,
+  * parsed and deleted, as the reader and parser threads do it.  The pktlist
+  * ring is run through pktlist_add_rx() (copy) and through a lease that is
+  * posted to an inbox (no copy, as the MPipe reader does it).
+  *
+  * The linked-list pktlist it replaced is kept here only as a model: a
+  * talloc'ed packet and buffer per frame, linked under the list mutex, which
+  * is what its add, parse and del did for RX.
+  *
+  * Usage: pktbench [packets [burst]]
+  */
+
+#include "cliopt.h"
+#include "crc_calc_block.h"
+#include "devtable.h"
+#include "mpipe.h"
+#include "otter_cfg.h"
+#include "pktlist.h"
+#include "user.h"
+
+#include <talloc.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+// The rest of otter, as far as pktlist.c uses it on the RX side
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+bool cliopt_isdebug(void) { return false; }
+bool cliopt_isquiet(void) { return true; }
+IO_Type cliopt_getio(void) { return IO_mpipe; }
+int cliopt_getdstaddr(void) { return 0; }
+int cliopt_getsrcaddr(void) { return 0; }
+void* devtab_get_route(devtab_handle_t handle, devtab_node_t node) { return NULL; }
+int devtab_route_expect(devtab_handle_t handle, devtab_node_t node, uint32_t sequence) { return 0; }
+void user_endpoint_get(user_endpoint_t* dst, user_endpoint_t* endpoint) { *dst = *endpoint; }
+int user_preencrypt(USER_Type usertype, uint32_t* seqnonce, uint8_t* dst, uint8_t* hdr24) { return 0; }
+int user_encrypt(user_endpoint_t* endpoint, uint16_t vid, uint64_t uid, uint8_t* front, size_t payload_len) { return 0; }
+int user_decrypt(user_endpoint_t* endpoint, uint16_t vid, uint64_t uid, uint8_t* front, size_t* frame_len) { return 0; }
+bool mpipe_exthdr_get(void* intf) { return false; }
+void mpipe_exthdr_set(void* intf) { }
+#pragma GCC diagnostic pop
+
+
+#define _NUMFRAMES  64
+#define _MINFRAME   24
+#define _MAXFRAME   300
+
+static uint8_t frames[_NUMFRAMES][_MAXFRAME];
+static size_t frame_size[_NUMFRAMES];
+
+
+
+/** Linked-list model <BR>
+  * ========================================================================<BR>
+  */
+typedef struct lpkt {
+    uint8_t*        buffer;
+    size_t          size;
+    uint32_t        sequence;
+    time_t          tstamp;
+    struct lpkt*    prev;
+    struct lpkt*    next;
+} lpkt_t;
+
+typedef struct {
+    lpkt_t*         front;
+    lpkt_t*         last;
+    lpkt_t*         cursor;
+    pthread_mutex_t mutex;
+} llist_t;
+
+static lpkt_t* sub_llist_add(llist_t* list, uint8_t* data, size_t size) {
+    lpkt_t* pkt = talloc_size(list, sizeof(lpkt_t));
+    if (pkt == NULL) {
+        return NULL;
+    }
+    pthread_mutex_lock(&list->mutex);
+    pkt->prev   = list->last;
+    pkt->next   = NULL;
+    pkt->size   = size;
+    pkt->buffer = talloc_size(pkt, size);
+    if (pkt->buffer == NULL) {
+        pthread_mutex_unlock(&list->mutex);
+        talloc_free(pkt);
+        return NULL;
+    }
+    memcpy(pkt->buffer, data, size);
+    if (list->last != NULL) list->last->next = pkt;
+    else                    list->front = pkt;
+    list->last = pkt;
+    if (list->cursor == NULL) {
+        list->cursor = pkt;
+    }
+    pthread_mutex_unlock(&list->mutex);
+    return pkt;
+}
+
+static lpkt_t* sub_llist_parse(llist_t* list) {
+    lpkt_t* pkt;
+    pthread_mutex_lock(&list->mutex);
+    pkt = list->cursor;
+    if (pkt != NULL) {
+        list->cursor    = pkt->next;
+        pkt->tstamp     = time(NULL);
+        pkt->sequence   = pkt->buffer[4];
+    }
+    pthread_mutex_unlock(&list->mutex);
+    return pkt;
+}
+
+static void sub_llist_del(llist_t* list, lpkt_t* pkt) {
+    pthread_mutex_lock(&list->mutex);
+    if (pkt->prev != NULL)  pkt->prev->next = pkt->next;
+    else                    list->front = pkt->next;
+    if (pkt->next != NULL)  pkt->next->prev = pkt->prev;
+    else                    list->last = pkt->prev;
+    if (list->cursor == pkt) {
+        list->cursor = pkt->next;
+    }
+    talloc_free(pkt);
+    pthread_mutex_unlock(&list->mutex);
+}
+
+
+
+
+/** Load <BR>
+  * ========================================================================<BR>
+  */
+static void sub_mkframes(void) {
+/// MPipe frames: CRC, length, sequence, control, then an ALP record
+    uint32_t rng = 12345;
+
+    for (int i=0; i<_NUMFRAMES; i++) {
+        size_t size;
+        uint16_t crc;
+        rng         = (rng * 1103515245) + 12345;
+        size        = _MINFRAME + ((rng >> 8) % (_MAXFRAME - _MINFRAME + 1));
+        for (size_t j=2; j<size; j++) {
+            rng         = (rng * 1103515245) + 12345;
+            frames[i][j]= (uint8_t)(rng >> 16);
+        }
+        frames[i][2]    = (uint8_t)((size - 8) >> 8);
+        frames[i][3]    = (uint8_t)(size - 8);
+        frames[i][4]    = (uint8_t)i;
+        frames[i][5]    = 0;
+        crc             = crc_calc_block(&frames[i][2], size-2);
+        frames[i][0]    = (uint8_t)(crc >> 8);
+        frames[i][1]    = (uint8_t)crc;
+        frame_size[i]   = size;
+    }
+}
+
+static bool sub_crcok(const uint8_t* frame, size_t size) {
+/// The reader checks the CRC of each frame before it is queued
+    return crc_calc_block((uint8_t*)&frame[2], size-2) == (((uint16_t)frame[0] << 8) | frame[1]);
+}
+
+static double sub_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + ((double)now.tv_nsec / 1e9);
+}
+
+static void sub_report(const char* name, long packets, double secs) {
+    printf("  %-22s %9ld pkts  %7.1f ns/pkt  %6.2f Mpkt/s\n",
+            name, packets, (secs * 1e9) / packets, (packets / secs) / 1e6);
+}
+
+
+
+
+int main(int argc, char** argv) {
+    long packets    = (argc > 1) ? atol(argv[1]) : 2000000;
+    int burst       = (argc > 2) ? atoi(argv[2]) : 16;
+    user_endpoint_t endpoint;
+    pktlist_t* plist;
+    pktinbox_t* inbox;
+    llist_t* llist;
+    pkt_t* queued[OTTER_PARAM_RLISTSIZE];
+    lpkt_t* lqueued[OTTER_PARAM_RLISTSIZE];
+    int intf_dummy;
+    double start;
+    long done;
+    long parsed;
+    int errcode;
+    int rc;
+
+    if ((burst < 1) || (burst > OTTER_PARAM_RLISTSIZE)) {
+        fprintf(stderr, "Burst must be 1 to %d\n", OTTER_PARAM_RLISTSIZE);
+        return 1;
+    }
+    sub_mkframes();
+    memset(&endpoint, 0, sizeof(endpoint));
+    endpoint.usertype = USER_guest;
+
+    printf("RX load: %ld frames of %d-%d bytes, in bursts of %d\n", packets, _MINFRAME, _MAXFRAME, burst);
+
+    // Linked-list model
+    llist = talloc_zero_size(NULL, sizeof(llist_t));
+    if (llist == NULL) {
+        return 2;
+    }
+    pthread_mutex_init(&llist->mutex, NULL);
+    start = sub_now();
+    for (done=0, parsed=0; done<packets; ) {
+        int n;
+        for (n=0; n<burst; n++) {
+            int f = (int)((done + n) % _NUMFRAMES);
+            if (sub_crcok(frames[f], frame_size[f]) == false) {
+                break;
+            }
+            sub_llist_add(llist, frames[f], frame_size[f]);
+        }
+        for (n=0; n<burst; n++) {
+            lqueued[n] = sub_llist_parse(llist);
+            parsed += (lqueued[n] != NULL);
+        }
+        for (n=0; n<burst; n++) {
+            if (lqueued[n] != NULL) {
+                sub_llist_del(llist, lqueued[n]);
+            }
+        }
+        done += burst;
+    }
+    sub_report("talloc linked list", parsed, sub_now() - start);
+    talloc_free(llist);
+
+    // Ring, copying the frame in
+    if (pktlist_init(&plist, OTTER_PARAM_RLISTSIZE) != 0) {
+        fprintf(stderr, "pktlist_init() failed\n");
+        return 2;
+    }
+    start = sub_now();
+    for (done=0, parsed=0; done<packets; ) {
+        int n;
+        for (n=0; n<burst; n++) {
+            int f = (int)((done + n) % _NUMFRAMES);
+            if (sub_crcok(frames[f], frame_size[f]) == false) {
+                break;
+            }
+            pktlist_add_rx(&endpoint, &intf_dummy, plist, frames[f], frame_size[f]);
+        }
+        for (n=0; n<burst; n++) {
+            queued[n] = pktlist_parse(&errcode, plist);
+            parsed += (queued[n] != NULL);
+        }
+        for (n=0; n<burst; n++) {
+            pktlist_del(queued[n]);
+        }
+        done += burst;
+    }
+    sub_report("ring, pktlist_add_rx", parsed, sub_now() - start);
+
+    // Ring, through a lease and an inbox
+    inbox = pktlist_inbox_open(plist);
+    if (inbox == NULL) {
+        fprintf(stderr, "pktlist_inbox_open() failed\n");
+        pktlist_free(plist);
+        return 2;
+    }
+    start = sub_now();
+    for (done=0, parsed=0; done<packets; ) {
+        int n;
+        for (n=0; n<burst; n++) {
+            int f       = (int)((done + n) % _NUMFRAMES);
+            pkt_t* pkt  = pktlist_lease(plist, frame_size[f]);
+            if (pkt == NULL) {
+                break;
+            }
+            memcpy(pkt->buffer, frames[f], frame_size[f]);
+            if (sub_crcok(pkt->buffer, frame_size[f]) == false) {
+                pktlist_release(pkt);
+                break;
+            }
+            pktlist_post_rx(inbox, &intf_dummy, pkt, frame_size[f]);
+        }
+        for (n=0; n<burst; n++) {
+            queued[n] = pktlist_parse(&errcode, plist);
+            parsed += (queued[n] != NULL);
+        }
+        for (n=0; n<burst; n++) {
+            pktlist_del(queued[n]);
+        }
+        done += burst;
+    }
+    sub_report("ring, lease and inbox", parsed, sub_now() - start);
+
+    // A burst fits in the ring, so nothing should be allocated outside it
+    printf("  dropped %zu, fallback allocs %zu\n",
+            plist->drop_oldest + plist->drop_newest + plist->drop_lowprio, plist->alloc_fallback);
+    rc = (plist->alloc_fallback == 0) ? 0 : 3;
+    pktlist_free(plist);
+    return rc;
+}
@@ -0,0 +1,194 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+/** Round-trip time through a pty loopback <BR>
+  * ========================================================================<BR>
+  * The slave side of a pty is opened as an MPipe TTY interface, and a thread
+  * echoes everything that comes out of the master side.  A frame is written
+  * with mpipe_writeto_intf(), and the response is read back the way the
+  * reader does it: sleeping in poll(), or spinning on the fd while the
+  * interface is in its busy-poll window (see mpipe_lowlatency_set()).
+  *
+  * A pty has no driver buffering, so this shows the wakeup part of the
+  * latency only.  The low-latency flag is not taken by a pty, so that part
+  * needs a real USB-serial adapter.
+  *
+  * Usage: rttbench [iterations [busypoll_us]]
+  */
+
+#include "mpipe.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <pty.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// mpipe.c logs through the debug macros
+bool cliopt_isdebug(void) { return false; }
+bool cliopt_isverbose(void) { return false; }
+
+
+#define _FRAMESIZE  32
+
+static volatile bool echo_run = true;
+
+
+
+static int64_t sub_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int sub_cmp64(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void* sub_echo(void* args) {
+    int master = *(int*)args;
+    struct pollfd pfd = { master, POLLIN, 0 };
+    uint8_t buf[256];
+
+    while (echo_run) {
+        if (poll(&pfd, 1, 100) > 0) {
+            ssize_t n = read(master, buf, sizeof(buf));
+            if (n > 0) {
+                (void)!write(master, buf, (size_t)n);
+            }
+        }
+    }
+    return NULL;
+}
+
+static int sub_readframe(void* intf, int fd, uint8_t* dst, size_t size, bool busypoll) {
+/// Reads one response, with the same wait as the reader: spin while the
+/// busy-poll window is open, otherwise sleep in poll() until data arrives.
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    size_t got = 0;
+
+    while (got < size) {
+        ssize_t n;
+        if ((busypoll == false) || (mpipe_busypoll_get(intf, sub_now_ns()) == false)) {
+            if (poll(&pfd, 1, 1000) <= 0) {
+                return -1;
+            }
+        }
+        n = read(fd, &dst[got], size-got);
+        if (n > 0) {
+            got += (size_t)n;
+        }
+        else if ((n < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void sub_run(mpipe_handle_t mph, int iterations, bool busypoll) {
+    void* intf          = mpipe_intf_get(mph, 0);
+    int fd              = mpipe_fds_get(mph, 0)->in;
+    int64_t* rtt        = malloc(iterations * sizeof(int64_t));
+    uint8_t frame[_FRAMESIZE];
+    uint8_t resp[_FRAMESIZE];
+    int done;
+
+    if (rtt == NULL) {
+        return;
+    }
+    for (int i=0; i<_FRAMESIZE; i++) {
+        frame[i] = (uint8_t)i;
+    }
+    for (done=0; done<iterations; done++) {
+        int64_t start = sub_now_ns();
+        mpipe_writeto_intf(intf, frame, _FRAMESIZE);
+        if (sub_readframe(intf, fd, resp, _FRAMESIZE, busypoll) != 0) {
+            fprintf(stderr, "No response after %d round trips\n", done);
+            break;
+        }
+        rtt[done] = sub_now_ns() - start;
+        mpipe_busypoll_clear(intf);
+    }
+
+    if (done > 0) {
+        qsort(rtt, done, sizeof(int64_t), &sub_cmp64);
+        printf("  %-10s %6d frames  min %7.1f us  median %7.1f us  p99 %7.1f us\n",
+                busypoll ? "busy-poll" : "poll", done,
+                rtt[0] / 1e3, rtt[done/2] / 1e3, rtt[(done*99)/100] / 1e3);
+    }
+    free(rtt);
+}
+
+
+
+
+int main(int argc, char** argv) {
+    mpipe_handle_t mph  = NULL;
+    int iterations      = (argc > 1) ? atoi(argv[1]) : 10000;
+    int busypoll_us     = (argc > 2) ? atoi(argv[2]) : 1000;
+    char slave_name[256];
+    struct termios tio;
+    pthread_t echo;
+    int master;
+    int slave;
+    int rc = 0;
+
+    if (openpty(&master, &slave, slave_name, NULL, NULL) != 0) {
+        perror("openpty");
+        return 1;
+    }
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+    close(slave);
+
+    if ((mpipe_init(&mph, 1) != 0)
+    ||  (mpipe_opentty(mph, 0, slave_name, 115200, 8, 'N', 1, MPIPE_FLOW_NONE, MPIPE_LINE_KEEP, MPIPE_LINE_KEEP) < 0)) {
+        fprintf(stderr, "Cannot open %s as an MPipe interface\n", slave_name);
+        rc = 2;
+        goto main_EXIT;
+    }
+    pthread_create(&echo, NULL, &sub_echo, &master);
+
+    printf("Round trips of %d byte frames through %s\n", _FRAMESIZE, slave_name);
+    sub_run(mph, iterations, false);
+
+    if (mpipe_lowlatency_set(mph, 0, true, busypoll_us) < 0) {
+        fprintf(stderr, "Busy-poll is not available\n");
+        rc = 3;
+    }
+    else {
+        sub_run(mph, iterations, true);
+    }
+
+    echo_run = false;
+    pthread_join(echo, NULL);
+
+    main_EXIT:
+    mpipe_deinit(mph);
+    close(master);
+    return rc;
+}
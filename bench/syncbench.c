@@ -0,0 +1,146 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+/** FF55 sync scan kernels <BR>
+  * ========================================================================<BR>
+  * Every sync scan kernel is checked against a plain loop, on noise that is
+  * mostly FF and 55, so near misses and syncs across vector boundaries are
+  * common.  The benchmark resyncs on random noise, as the RX decoder does
+  * after a bad frame.
+  *
+  * Usage: syncbench [bench]
+  */
+
+#include "../main/crc_calc_block.c"
+#include "../main/mpipe_rx.c"
+#include "bench.h"
+
+
+// mpipe_rx.c logs through the debug macros
+bool cliopt_isdebug(void) { return false; }
+bool cliopt_isverbose(void) { return false; }
+
+
+typedef size_t (*syncfn_t)(const uint8_t*, size_t);
+
+static kernel_t sync_kernels[] = {
+    { "sync scalar",    (void*)&sub_findsync_scalar, true },
+#   if defined(_SYNC_X86) && defined(__SSE2__)
+    { "sync sse2",      (void*)&sub_findsync_sse2, true },
+#   endif
+#   if defined(_SYNC_X86)
+    { "sync avx2",      (void*)&sub_findsync_avx2, false },
+#   endif
+};
+
+#define _NUMSYNC _NUMKERNELS(sync_kernels)
+
+
+
+static size_t sub_sync_ref(const uint8_t* buf, size_t len) {
+    for (size_t i=0; (i+1)<len; i++) {
+        if ((buf[i] == 0xFF) && (buf[i+1] == 0x55)) {
+            return i;
+        }
+    }
+    return len;
+}
+
+static void sub_sync_setup(void) {
+#   if defined(_SYNC_X86)
+    sync_kernels[_NUMSYNC-1].usable = _CPU("avx2");
+#   endif
+}
+
+static void sub_sync_check(uint8_t* buf) {
+    for (int v=0; v<_VECTORS; v++) {
+        size_t offset   = sub_rand() % 16;
+        size_t len      = sub_rand() % 300;
+        uint8_t* vec    = &buf[offset];
+        size_t ref;
+
+        // Noise made of FF and 55 only, so near misses (FF FF, 55 FF) and
+        // pairs across the vector boundaries are common
+        for (size_t i=0; i<len; i++) {
+            uint64_t r = sub_rand();
+            vec[i] = (r & 7) ? ((r & 8) ? 0xFF : 0x55) : (uint8_t)(r >> 8);
+            if ((r & 0x3F0) == 0) {
+                vec[i] = 0x55;
+            }
+        }
+        // Half of them have no sync at all
+        if (v & 1) {
+            for (size_t i=1; i<len; i++) {
+                if ((vec[i-1] == 0xFF) && (vec[i] == 0x55)) {
+                    vec[i] = 0xFF;
+                }
+            }
+        }
+
+        ref = sub_sync_ref(vec, len);
+        for (size_t k=0; k<_NUMSYNC; k++) {
+            if (sync_kernels[k].usable && (((syncfn_t)sync_kernels[k].fn)(vec, len) != ref)) {
+                sub_fail(sync_kernels[k].name, len, offset);
+            }
+        }
+    }
+}
+
+static void sub_sync_bench(uint8_t* buf) {
+/// Resync on random noise: each scan restarts just past the last sync found,
+/// the way the decoder does after a bad frame.
+    printf("FF55 sync scan (random noise)\n");
+    sub_randfill(buf, _MAXLEN);
+    for (size_t k=0; k<_NUMSYNC; k++) {
+        size_t bytes = 0;
+        double start;
+        double secs;
+
+        if (sync_kernels[k].usable == false) {
+            continue;
+        }
+        start = sub_now();
+        do {
+            for (int i=0; i<64; i++) {
+                size_t pos = 0;
+                while (pos < _MAXLEN) {
+                    pos += ((syncfn_t)sync_kernels[k].fn)(&buf[pos], _MAXLEN-pos) + 1;
+                }
+            }
+            bytes  += 64 * _MAXLEN;
+            secs    = sub_now() - start;
+        } while (secs < (_BENCH_MS / 1000.0));
+        sub_report(sync_kernels[k].name, _MAXLEN, bytes, secs);
+    }
+}
+
+
+
+
+int main(int argc, char** argv) {
+    static uint8_t buf[_MAXLEN + 64];
+    int rc;
+
+    _CPU_INIT();
+    sub_sync_setup();
+
+    sub_sync_check(buf);
+    rc = sub_result("Sync scan");
+    if ((rc == 0) && sub_isbench(argc, argv)) {
+        sub_sync_bench(buf);
+    }
+    return rc;
+}
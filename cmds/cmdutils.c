@@ -16,6 +16,7 @@
 
 // Local Headers
 #include "cmdutils.h"
+#include "codec.h"
 
 #include <talloc.h>
 
@@ -29,54 +30,51 @@
 
 
 int cmdutils_uint8_to_hexstr(char* dst, uint8_t* src, size_t src_bytes) {
-    const char convert[] = "0123456789ABCDEF";
-    char* start = dst;
+    size_t len;
     
-    while (src_bytes-- != 0) {
-        *dst++ = convert[*src >> 4];
-        *dst++ = convert[*src & 0x0f];
-        src++;
-    }
-    *dst = 0;
+    len         = codec_hexenc(dst, src, src_bytes);
+    dst[len]    = 0;
     
-    return (int)(dst - start);
+    return (int)len;
 }
 
 int cmdutils_hexstr_to_uint8(uint8_t* dst, const char* src) {
+/// Input must be hex digits only.  A trailing odd digit is ignored.
     size_t chars;
-    int bytes;
+    size_t bad;
+    size_t bytes;
     
     chars   = strlen(src);
-    chars >>= 1;    // round down to nearest even
-    bytes   = (int)chars;
-    
-    while (chars != 0) {
-        char c;
-        uint8_t a, b;
-        chars--;
-        
-        c = *src++;
-        if      (c >= '0' && c <= '9')  a = c - '0';
-        else if (c >= 'A' && c <= 'F')  a = 10 + c - 'A';
-        else if (c >= 'a' && c <= 'f')  a = 10 + c - 'a';
-        else    a = 0;
-        
-        c = *src++;
-        if      (c >= '0' && c <= '9')  b = c - '0';
-        else if (c >= 'A' && c <= 'F')  b = 10 + c - 'A';
-        else if (c >= 'a' && c <= 'f')  b = 10 + c - 'a';
-        else    b = 0;
-        
-        *dst++ = (a << 4) + b;
+    bytes   = codec_hexdec(dst, src, chars, &bad);
+    
+    if (bad < chars) {
+        return -1 - (int)bad;
     }
+    return (int)bytes;
+}
+
+int cmdutils_base64_to_uint8(uint8_t* dst, const char* src) {
+    size_t chars;
+    size_t bad;
+    size_t bytes;
     
-    return bytes;
+    chars   = strlen(src);
+    bytes   = codec_b64dec(dst, src, chars, &bad);
+    
+    if (bad < chars) {
+        return -1 - (int)bad;
+    }
+    return (int)bytes;
 }
 
 
-int cmdutils_base64_to_uint8(uint8_t* dst, const char* src) {
-///@todo build this function on a rainy day -- probably reference a BASE64 lib.
-    return 0;
+const char* cmdutils_base64_payload(const char* src) {
+    size_t prefix_len = sizeof(CMDUTILS_BASE64_PREFIX) - 1;
+    
+    if ((src == NULL) || (strncmp(src, CMDUTILS_BASE64_PREFIX, prefix_len) != 0)) {
+        return NULL;
+    }
+    return &src[prefix_len];
 }
 
 
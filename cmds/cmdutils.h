@@ -31,12 +31,24 @@
 int cmdutils_uint8_to_hexstr(char* dst, uint8_t* src, size_t src_bytes);
 
 
+/// Returns bytes written to dst, or if src has a char that isn't a hex digit,
+/// -1 - (offset of that char).
 int cmdutils_hexstr_to_uint8(uint8_t* dst, const char* src);
 
 
+/// Returns bytes written to dst, or if src can't be decoded, -1 - (offset of
+/// the first bad char).  dst needs room for 3*((strlen(src)+3)/4) bytes.
 int cmdutils_base64_to_uint8(uint8_t* dst, const char* src);
 
 
+/// Binary data in commands may be given as base64 instead of bintex, marked
+/// by this prefix, e.g. base64:AAECAw==
+#define CMDUTILS_BASE64_PREFIX  "base64:"
+
+/// Returns the base64 following the prefix, or NULL if src doesn't have it.
+const char* cmdutils_base64_payload(const char* src);
+
+
 uint8_t* cmdutils_markstring(uint8_t** psrc, int* search_limit, int string_limit);
 
 
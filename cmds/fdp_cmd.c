@@ -29,6 +29,7 @@
 #include "cmds.h"
 #include "cmd_api.h"
 #include "cmdutils.h"
+#include "codec.h"
 #include "cliopt.h"
 #include "dterm.h"
 #include "otter_cfg.h"
@@ -654,8 +655,6 @@ static const char* msg_rp   = "Read Permissions";
 static const char* msg_rh   = "Read Header";
 static const char* msg_rhd  = "Read Header+Data";
 
-static const char hexconv[16]  = "0123456789ABCDEF";
-
 
 #define RELIMIT(CNT, MARKER) \
     do { dst += CNT; limit -= CNT; if (limit <= 0) { goto MARKER; } } while(0)
@@ -691,49 +690,49 @@ static int _get_u16(const char** src, const char* end) {
 
 
 
-///@todo these hex output functions are the same in both ASAPI and FDP formatters
-
 static int sub_dumphex(char* dst, int limit, const char** src, size_t srcsz) {
-    char* start = dst;
+    size_t fit = (limit > 0) ? (size_t)limit / 2 : 0;
     
-    while ((srcsz-- != 0) && (limit >= 2)) {
-        char byte = **src;
-        (*src)++;
-        *dst++ = hexconv[(byte >> 4) & 0x0f];
-        *dst++ = hexconv[byte & 0x0f];
+    if (srcsz > fit) {
+        srcsz = fit;
     }
+    codec_hexenc(dst, (const uint8_t*)*src, srcsz);
+    *src += srcsz;
     
-    return (int)(dst - start);
+    return (int)(2 * srcsz);
+}
+
+
+static int sub_dumpb64(char* dst, int limit, const char** src, size_t srcsz) {
+    size_t fit = (limit > 0) ? 3 * ((size_t)limit / 4) : 0;
+    size_t cnt;
+    
+    if (srcsz > fit) {
+        srcsz = fit;
+    }
+    cnt     = codec_b64enc(dst, (const uint8_t*)*src, srcsz);
+    *src   += srcsz;
+    
+    return (int)cnt;
 }
 
 
 static int sub_printhex(char* dst, int limit, const char** src, size_t print_bytes, size_t cols) {
-    int i;
-    char* start = dst;
-    int cnt;
+/// Every byte takes 3 chars, and only whole bytes are printed.  As with
+/// snprintf(), the output is null-terminated when there is room.
+    size_t fit = (limit > 0) ? (size_t)limit / 3 : 0;
+    size_t cnt;
     
-    i = (int)cols;
-    while (print_bytes-- != 0) {
-        char hexstr[4] = {0, 0, ' ', 0};
-        char byte;
-        
-        byte        = **src;
-        (*src)++;
-        hexstr[0]   = hexconv[(byte >> 4) & 0x0f];
-        hexstr[1]   = hexconv[byte & 0x0f];
-        i--;
-        
-        if ((i == 0) && (print_bytes != 0)) {
-            i = (int)cols;
-            hexstr[2] = '\n';
-        }
-        
-        cnt = snprintf(dst, limit, "%s", hexstr);
-        RELIMIT(cnt, sub_printhex_END);
+    if (print_bytes > fit) {
+        print_bytes = fit;
+    }
+    cnt     = codec_hexenc_cols(dst, (const uint8_t*)*src, print_bytes, cols, ' ');
+    *src   += print_bytes;
+    if ((int)cnt < limit) {
+        dst[cnt] = 0;
     }
     
-    sub_printhex_END:
-    return (int)(dst-start);
+    return (int)cnt;
 }
 
 //snprintf(buf, sizeof(buf), "range:{pos:%hu, size:%hu}, ", offset, bytes);
@@ -1142,6 +1141,12 @@ int fmt_fdp(char* dst, size_t* dst_accum, size_t dst_limit, FORMAT_Type fmt, uin
         RELIMIT(cnt, fdp_formatter_END);
     }
     
+    // JsonB64 mode returns the same field as base64
+    else if (fmt == FORMAT_JsonB64) {
+        cnt = sub_dumpb64(dst, limit, (const char**)src, srcsz);
+        RELIMIT(cnt, fdp_formatter_END);
+    }
+    
     // Json mode returns a Json object (utf-8, with Json syntax)
     else if (fmt == HBFMT_Json) {
         switch (cmd & 15) {
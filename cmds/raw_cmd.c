@@ -42,9 +42,11 @@ int home_path_len               = 2;
 
 ///@todo make separate commands for file & string based input
 // Raw Protocol Entry: This is implemented fully and it takes a Bintex
-// expression as input, with no special keywords or arguments.
+// expression as input, with no special keywords or arguments.  Input with the
+// base64 prefix (see cmdutils.h) is decoded as base64 instead.
 int cmd_raw(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, size_t dstmax) {
     const char* filepath;
+    const char* b64;
     FILE*       fp;
     int         bytesout;
     
@@ -56,6 +58,21 @@ int cmd_raw(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, size_
     
     INPUT_SANITIZE();
     
+    // Base64 input is decoded straight into the packet buffer.  Error
+    // positions are made relative to the start of the input, as with bintex.
+    b64 = cmdutils_base64_payload((const char*)src);
+    if (b64 != NULL) {
+        if ((3 * ((strlen(b64) + 3) / 4)) > dstmax) {
+            sprintf((char*)dst, "input exceeds %zu bytes", dstmax);
+            return -1;
+        }
+        bytesout = cmdutils_base64_to_uint8(dst, b64);
+        if (bytesout < 0) {
+            bytesout -= (int)(b64 - (const char*)src);
+        }
+        goto cmd_raw_OUT;
+    }
+    
     // Consider absolute path
     if (src[0] == '/') {
         filepath = (const char*)src;
@@ -83,6 +100,7 @@ int cmd_raw(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, size_
     // Undo whatever was done to the home_path
     home_path[home_path_len] = 0;
     
+    cmd_raw_OUT:
     ///@todo convert the character number into a line and character number
     if (bytesout < 0) {
         sprintf((char*)dst, "input error on character %i", -bytesout);
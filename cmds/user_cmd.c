@@ -116,8 +116,7 @@ int cmd_chuser(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, si
             goto cmd_chuser_TERM;
         }
         rc = 0;
-        appdata->endpoint.usertype  = usertype;
-        appdata->endpoint.node      = node;
+        user_endpoint_set(&appdata->endpoint, usertype, node);
 
         cmd_chuser_TERM:
         arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
@@ -169,15 +168,14 @@ int cmd_whoami(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, si
         strcpy((char*)dst, "Usage: whoami [no parameters], Indicates the current user and address");
         rc = -1;
     }
-    else if (appdata->endpoint.node == NULL) {
-        rc = -2;
-    }
     else {
         char output[80];
         char* cursor;
         devtab_endpoint_t* endpoint;
+        user_endpoint_t active;
         
-        endpoint = devtab_resolve_endpoint(appdata->endpoint.node);
+        user_endpoint_get(&active, &appdata->endpoint);
+        endpoint = devtab_resolve_endpoint(active.node);
         if (endpoint == NULL) {
             rc = -2;
             goto cmd_whoami_END;
@@ -185,7 +183,7 @@ int cmd_whoami(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, si
         
         cursor = output;
         
-        switch (appdata->endpoint.usertype) {
+        switch (active.usertype) {
             case USER_root: cursor = stpcpy(cursor, "root@");   break;
             case USER_user: cursor = stpcpy(cursor, "user@");   break;
             default:        cursor = stpcpy(cursor, "guest@");  break;
@@ -19,6 +19,7 @@
 #include "cmd_api.h"
 #include "cmdutils.h"
 #include "cliopt.h"
+#include "codec.h"
 #include "dterm.h"
 #include "otter_cfg.h"
 #include "subscribers.h"
@@ -42,6 +43,7 @@ typedef enum {
     DATA_binary,
     DATA_bintex,
     DATA_text,
+    DATA_base64,
 } DATA_enum;
 
 typedef struct {
@@ -166,13 +168,14 @@ static int sub_getinput(TALLOC_CTX* tctx, loop_input_t* loop, const char* cmdnam
     }
     else {
         struct arg_lit* file    = arg_lit0("-f","file",                 "Use file for loop input, instead of line input");
+        struct arg_lit* lines   = arg_lit0("-l","lines",                "Loop line input as text, line by line");
         struct arg_int* bsize   = arg_int0("-b","bsize","bytes",        "Segment binary inputs into blocks of specified size");
         struct arg_int* timeout = arg_int0("-t","timeout","ms",         "Loop response timeout in ms.  Default 1000.");
         struct arg_int* retries = arg_int0("-r","retries","count",      "Number of retries until exit loop.  Default 3.");
         struct arg_str* loopcmd = arg_str1(NULL,NULL,"loop cmd",        "Command put in quotes (\"\") to loop");
-        struct arg_str* loopdat = arg_str1(NULL,NULL,"loop data",       "Loop data as bintex or file, per -f flag.");
-        struct arg_end* end     = arg_end(7);
-        void* argtable[]        = { file, bsize, loopcmd, loopdat, end };
+        struct arg_str* loopdat = arg_str1(NULL,NULL,"loop data",       "Loop data as bintex, base64 or file, per -f flag.");
+        struct arg_end* end     = arg_end(8);
+        void* argtable[]        = { file, lines, bsize, loopcmd, loopdat, end };
         
         rc = cmdutils_argcheck(argtable, end, argc, argv);
         if (rc != 0) {
@@ -214,6 +217,7 @@ static int sub_getinput(TALLOC_CTX* tctx, loop_input_t* loop, const char* cmdnam
             // binary: in chunks of bsize.
             // bintex: conversion to binary, then chunks of bsize.
             // text: line by line, cutoff at bsize.
+            // base64: conversion to binary, then chunks of bsize.
             {   const char* extension;
                 extension = &(loopdat->sval[0][strlen(loopdat->sval[0])-4]);
                 if (strcmp(extension, ".btx") == 0) {
@@ -225,6 +229,9 @@ static int sub_getinput(TALLOC_CTX* tctx, loop_input_t* loop, const char* cmdnam
                 else if (strcmp(extension, ".hex") == 0) {
                     loop->data_type = DATA_text;
                 }
+                else if (strcmp(extension, ".b64") == 0) {
+                    loop->data_type = DATA_base64;
+                }
                 else {
                     loop->data_type = DATA_binary;
                 }
@@ -244,6 +251,29 @@ static int sub_getinput(TALLOC_CTX* tctx, loop_input_t* loop, const char* cmdnam
                         rc = -6;
                     }
                     break;
+                
+                // Line breaks and other whitespace are dropped, then the
+                // base64 is decoded in place.
+                case DATA_base64: {
+                    char* b64 = (char*)loop->data;
+                    int b64_size = 0;
+                    size_t bad;
+                    
+                    if (fread(loop->data, loop->data_size, sizeof(uint8_t), fp) == 0) {
+                        rc = -6;
+                        break;
+                    }
+                    for (int i=0; i<loop->data_size; i++) {
+                        if (isspace(b64[i]) == 0) {
+                            b64[b64_size++] = b64[i];
+                        }
+                    }
+                    loop->data_size = (int)codec_b64dec(loop->data, b64, b64_size, &bad);
+                    loop->data_type = DATA_binary;
+                    if (bad < (size_t)b64_size) {
+                        rc = -6;
+                    }
+                } break;
                     
                 case DATA_text: {
                     char* cursor = (char*)loop->data;
@@ -284,9 +314,25 @@ static int sub_getinput(TALLOC_CTX* tctx, loop_input_t* loop, const char* cmdnam
         }
         
         /// Copy line input into buffer for loop
+        else if (cmdutils_base64_payload(loopdat->sval[0]) != NULL) {
+            const char* b64 = cmdutils_base64_payload(loopdat->sval[0]);
+            
+            // One spare byte keeps text input null terminated for the loop
+            loop->data_size = (int)(3 * ((strlen(b64) + 3) / 4));
+            loop->data      = talloc_zero_size(tctx, loop->data_size + 1);
+            if (loop->data == NULL) {
+                rc = -5;
+            }
+            else {
+                loop->data_size = cmdutils_base64_to_uint8(loop->data, b64);
+                if (loop->data_size < 0) {
+                    rc = -6;
+                }
+            }
+        }
         else {
             loop->data_size = (int)strlen(loopdat->sval[0]) / 2;
-            loop->data      = talloc_size(tctx, loop->data_size);
+            loop->data      = talloc_zero_size(tctx, loop->data_size + 1);
             if (loop->data == NULL) {
                 rc = -5;
             }
@@ -295,6 +341,20 @@ static int sub_getinput(TALLOC_CTX* tctx, loop_input_t* loop, const char* cmdnam
             }
         }
         
+        /// Line input looped as text.  CRs are dropped, so CRLF line breaks
+        /// become LF, as with text files.
+        if ((rc == 0) && (file->count == 0) && (lines->count > 0)) {
+            int text_size = 0;
+            for (int i=0; i<loop->data_size; i++) {
+                if (loop->data[i] != '\r') {
+                    loop->data[text_size++] = loop->data[i];
+                }
+            }
+            loop->data[text_size]   = 0;
+            loop->data_size         = text_size;
+            loop->data_type         = DATA_text;
+        }
+        
         /// Copy Command data into Command Line Buffer
         if (rc == 0) {
             size_t linealloc;
@@ -332,8 +392,8 @@ static int sub_binaryblock(char* dst, loop_input_t* loop, int dat_i) {
     dst             = stpcpy(dst, loop->cmdline);
     dst[0]          = '[';
     cmdutils_uint8_to_hexstr(&dst[1], &loop->data[dat_i], blocksz);
-    dst[1+blocksz]  = ']';
-    dst[2+blocksz]  = 0;
+    dst[1+2*blocksz]= ']';
+    dst[2+2*blocksz]= 0;
 
     return blocksz;
 }
@@ -447,7 +507,8 @@ int cmd_xloop(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, siz
             goto cmd_xloop_TERM3;
         }
 
-        // Unlock the dtwrite mutex so parser thread can operate
+        // Unlock the isolation mutex while waiting on responses, so commands
+        // from other clients are not held up
         pthread_mutex_unlock(dth->iso_mutex);
 
         // Loop the command until all data is gone
@@ -458,6 +519,7 @@ int cmd_xloop(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, siz
                 default:
                 case DATA_binary:
                 case DATA_bintex:
+                case DATA_base64:
                     blocksize = sub_binaryblock(xloop_cmd, &loop, dat_i);
                     break;
                 case DATA_text:
@@ -513,7 +575,7 @@ int cmd_xloop(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, siz
             write(fd_out, "\n", 1);
         }
 
-        // Relock dtwrite mutex to block parser
+        // Relock the isolation mutex before returning to dterm
         pthread_mutex_lock(dth->iso_mutex);
 
         // Delete Subscriber (also closes), unsquelch, free
@@ -537,10 +599,12 @@ int cmd_xloop(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, siz
 int cmd_sendhex(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, size_t dstmax) {
     static const char sendhex_name[] = "sendhex";
     static const char xloop_fmt[] = "-f \"file wo 255 [5A5A]\" %s";
+    static const char xloop_b64fmt[] = "-l \"file wo 255 [5A5A]\" %s";
     int rc;
     int argc;
     char** argv;
     char* xloop_cmd = NULL;
+    const char* fmt;
     int xloop_bytes;
     
     /// dt == NULL is the initialization case.
@@ -556,7 +620,7 @@ int cmd_sendhex(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, s
         rc = -256 + argc;
     }
     else {
-        struct arg_file* hexfile= arg_file1(NULL,NULL,"<.hex file>", "Motorola .hex File to send to target.");
+        struct arg_file* hexfile= arg_file1(NULL,NULL,"<.hex file>", "Motorola .hex File to send to target, or its contents as base64:...");
         struct arg_end* end     = arg_end(2);
         void* argtable[]        = { hexfile, end };
         
@@ -566,19 +630,27 @@ int cmd_sendhex(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, s
             goto cmd_sendhex_EXEC;
         }
         
-        if (strcmp(hexfile->extension[0], ".hex") != 0) {
+        // Hex file contents may be sent inline as base64, which xloop then
+        // loops line by line like the file.
+        if (cmdutils_base64_payload(hexfile->filename[0]) != NULL) {
+            fmt = xloop_b64fmt;
+        }
+        else if (strcmp(hexfile->extension[0], ".hex") != 0) {
             strcpy((char*)dst, "Input Error, file not with .hex");
             rc = -2;
             goto cmd_sendhex_EXEC;
         }
+        else {
+            fmt = xloop_fmt;
+        }
         
-        xloop_cmd = talloc_zero_size(dth->tctx, (strlen(xloop_fmt) + strlen(hexfile->filename[0]) + 1) * sizeof(char));
+        xloop_cmd = talloc_zero_size(dth->tctx, (strlen(fmt) + strlen(hexfile->filename[0]) + 1) * sizeof(char));
         if (xloop_cmd == NULL) {
             rc = -1;
             goto cmd_sendhex_EXEC;
         }
         
-        xloop_bytes = sprintf(xloop_cmd, xloop_fmt, hexfile->filename[0]);
+        xloop_bytes = sprintf(xloop_cmd, fmt, hexfile->filename[0]);
         
         cmd_sendhex_EXEC:
         arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
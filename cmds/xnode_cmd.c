@@ -97,8 +97,7 @@ int cmd_xnode(dterm_handle_t* dth, uint8_t* dst, int* inbytes, uint8_t* src, siz
             rc = -4;
             goto cmd_xnode_FREEARGS;
         }
-        appdata->endpoint.usertype  = usertype;
-        appdata->endpoint.node      = node;
+        user_endpoint_set(&appdata->endpoint, usertype, node);
         
         cmdptr  = cmd_quoteline_resolve((char*)nodecmd->sval[0], dth);
         rc      = cmd_run(cmdptr, dth, dst, &bytesin, (uint8_t*)nodecmd->sval[0], dstmax);
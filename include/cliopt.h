@@ -40,6 +40,7 @@ typedef enum {
     FORMAT_JsonHex  = 2,
     FORMAT_Bintex   = 3,
     FORMAT_Hex      = 4,
+    FORMAT_JsonB64  = 5,
     FORMAT_MAX
 } FORMAT_Type;
 
@@ -59,6 +60,12 @@ typedef struct {
     
     size_t      mempool_size;
     int         timeout_ms;
+    
+    size_t      rlist_size;
+    size_t      tlist_size;
+    int         rlist_policy;
+    int         tlist_policy;
+    int         parse_threads;
 } cliopt_t;
 
 
@@ -91,5 +98,11 @@ void cliopt_setpoolsize(size_t poolsize);
 int cliopt_gettimeout(void);
 void cliopt_settimeout(int timeout_ms);
 
+size_t cliopt_getrlistsize(void);
+size_t cliopt_gettlistsize(void);
+int cliopt_getrlistpolicy(void);
+int cliopt_gettlistpolicy(void);
+int cliopt_getparsethreads(void);
+
 
 #endif /* cliopt_h */
@@ -0,0 +1,98 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+#ifndef codec_h
+#define codec_h
+
+// Standard C & POSIX Libraries
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/** Byte Codecs <BR>
+  * ========================================================================<BR>
+  * Shared encoders used by the formatters, the rxstat output and the
+  * commands.  Where the CPU has them, vector versions are used (chosen at
+  * runtime).  All variants give identical output.
+  *
+  * Hex output is uppercase and is not null-terminated.  Hex input may be
+  * either case.  Base64 uses the standard alphabet with '=' padding.
+  */
+
+
+/** @brief Encodes bytes to contiguous hex
+  * @param dst          (char*) output, must have room for 2*srcsz chars
+  * @param src          (const uint8_t*) bytes to encode
+  * @param srcsz        (size_t) number of bytes
+  * @retval size_t      chars written, always 2*srcsz
+  */
+size_t codec_hexenc(char* dst, const uint8_t* src, size_t srcsz);
+
+
+/** @brief Encodes bytes to hex, in columns
+  * @param dst          (char*) output, must have room for 3*srcsz chars
+  * @param src          (const uint8_t*) bytes to encode
+  * @param srcsz        (size_t) number of bytes
+  * @param cols         (size_t) bytes per line, 0 for contiguous output
+  * @param term         (char) separator put after the last byte
+  * @retval size_t      chars written, 3*srcsz (2*srcsz if cols is 0)
+  *
+  * Each byte is followed by a space, or by a newline after every cols bytes.
+  * The last byte is followed by term instead, whatever its column.
+  */
+size_t codec_hexenc_cols(char* dst, const uint8_t* src, size_t srcsz, size_t cols, char term);
+
+
+/** @brief Decodes hex to bytes, stopping at the first invalid character
+  * @param dst          (uint8_t*) output, must have room for srcsz/2 bytes
+  * @param src          (const char*) hex chars to decode
+  * @param srcsz        (size_t) number of chars
+  * @param bad          (size_t*) output offset of the first char that isn't a
+  *                     hex digit, or srcsz if all are.  May be NULL.
+  * @retval size_t      bytes written
+  *
+  * Only complete pairs before the first invalid char are decoded.  A trailing
+  * odd digit is not decoded, and doesn't count as invalid.
+  */
+size_t codec_hexdec(uint8_t* dst, const char* src, size_t srcsz, size_t* bad);
+
+
+/** @brief Encodes bytes to base64
+  * @param dst          (char*) output, must have room for 4*((srcsz+2)/3) chars
+  * @param src          (const uint8_t*) bytes to encode
+  * @param srcsz        (size_t) number of bytes
+  * @retval size_t      chars written, always 4*((srcsz+2)/3)
+  */
+size_t codec_b64enc(char* dst, const uint8_t* src, size_t srcsz);
+
+
+/** @brief Decodes base64 to bytes, stopping at the first invalid character
+  * @param dst          (uint8_t*) output, must have room for 3*((srcsz+3)/4)
+  *                     bytes
+  * @param src          (const char*) base64 chars to decode
+  * @param srcsz        (size_t) number of chars
+  * @param bad          (size_t*) output offset of the first char that can't
+  *                     be decoded, or srcsz if all can.  May be NULL.
+  * @retval size_t      bytes written
+  *
+  * Padding is optional.  Anything after it counts as invalid, and so does a
+  * last quad of only one char.  dst may be the same buffer as src, to decode
+  * in place.
+  */
+size_t codec_b64dec(uint8_t* dst, const char* src, size_t srcsz, size_t* bad);
+
+
+#endif
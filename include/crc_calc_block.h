@@ -24,6 +24,11 @@
 // CRC Calculation function
 uint16_t crc_calc_block(uint8_t* src, size_t size);
 
+// Incremental CRC: start with CRC_CALC_INIT and feed the data in any number
+// of pieces.  The result is the same as crc_calc_block() over all of it.
+#define CRC_CALC_INIT   0xFFFF
+uint16_t crc_calc_partial(uint16_t crc, uint8_t* src, size_t size);
+
 uint16_t mbcrc_calc_block(uint8_t *src, size_t size);
 
 #endif
@@ -29,7 +29,7 @@
 
 #define _HEX_(HEX, SIZE, ...)  do { \
     fprintf(stderr, _E_YEL"DEBUG: "_E_NRM __VA_ARGS__); \
-    for (int i=0; i<(SIZE); i++) {   \
+    for (int i=0; i<(int)(SIZE); i++) {   \
         fprintf(stderr, "%02X ", (HEX)[i]);   \
     } \
     fprintf(stderr, "\n"); \
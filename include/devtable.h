@@ -19,6 +19,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <time.h>
 
 
 typedef void* devtab_handle_t;
@@ -32,6 +33,8 @@ typedef struct {
     void*       intf;
     void*       rootctx;
     void*       userctx;
+    void*       route;          // interface the device was last heard on
+    time_t      route_tstamp;   // CLOCK_MONOTONIC seconds, when heard
 } devtab_endpoint_t;
 
 
@@ -61,6 +64,52 @@ void* devtab_get_intf(devtab_handle_t handle, devtab_node_t node);
 void* devtab_get_rootctx(devtab_handle_t handle, devtab_node_t node);
 void* devtab_get_userctx(devtab_handle_t handle, devtab_node_t node);
 
+/** Learned Routing <BR>
+  * ========================================================================<BR>
+  * A device with no interface bound in the devtab would get its packets
+  * broadcast on every interface.  Instead, the interface a device was last
+  * heard on is learned and used for its packets, until it hasn't been heard
+  * from for OTTER_PARAM_ROUTETTL seconds.
+  *
+  * MPipe frames don't carry the device address, so a device is heard by way
+  * of the request/response sequence number: devtab_route_expect() is called
+  * with each request, and devtab_route_learn() with each response.  When a
+  * protocol has the device address in its frames (e.g. Modbus), the route
+  * is set directly with devtab_route_set().
+  */
+
+/** @brief Interface to use for packets to a device
+  * @param handle       (devtab_handle_t) devtab handle
+  * @param node         (devtab_node_t) device node
+  * @retval void*       the bound interface, else the learned one, else NULL
+  */
+void* devtab_get_route(devtab_handle_t handle, devtab_node_t node);
+
+int devtab_route_set(devtab_handle_t handle, devtab_node_t node, void* intfp);
+
+/** @brief Registers a request sent to a device
+  * @param handle       (devtab_handle_t) devtab handle
+  * @param node         (devtab_node_t) device node the request is sent to
+  * @param sequence     (uint32_t) request sequence number
+  * @retval int         0 if registered, 1 if the device has a bound interface
+  *                     (nothing to learn), negative on error
+  *
+  * The last OTTER_PARAM_ROUTEPEND requests are kept.
+  */
+int devtab_route_expect(devtab_handle_t handle, devtab_node_t node, uint32_t sequence);
+
+/** @brief Learns the route of the device a response comes from
+  * @param handle       (devtab_handle_t) devtab handle
+  * @param intfp        (void*) interface the response was received on
+  * @param sequence     (uint32_t) response sequence number
+  * @param seqmask      (uint32_t) sequence bits to compare, e.g. 0xFF for
+  *                     legacy MPipe frames
+  * @retval devtab_node_t  device node of the matched request, or NULL
+  */
+devtab_node_t devtab_route_learn(devtab_handle_t handle, void* intfp, uint32_t sequence, uint32_t seqmask);
+
+
+
 uint64_t devtab_lookup_uid(devtab_handle_t handle, uint16_t vid);
 uint16_t devtab_lookup_vid(devtab_handle_t handle, uint64_t uid);
 void* devtab_lookup_intf(devtab_handle_t handle, uint64_t uid);
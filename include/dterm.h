@@ -145,11 +145,21 @@ typedef struct {
     // * Initialized by DTerm
     pthread_mutex_t*    iso_mutex;
     
+    // Output Mutex
+    // * Serializes output that doesn't come from a command (i.e. rxstat) and
+    //    guards changes to fd, such as squelch.
+    // * Only held for the write itself, so received packets are output even
+    //    while a command is running.  Never take iso_mutex while holding it.
+    // * Initialized by DTerm
+    pthread_mutex_t*    out_mutex;
+    
     // Thread flags
     bool thread_active;
     
     // Externally Initialized data elements
-    // These should only be used within lock provided by isolation mutex
+    // These should only be used within lock provided by isolation mutex,
+    // except by the parser threads, which only use parts of it that have
+    // their own locks (lists, devtab, subscribers).
     void*               ext;
 
 } dterm_handle_t;
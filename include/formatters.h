@@ -30,7 +30,7 @@ int fmt_fprintalp(uint8_t* dst, size_t* dst_accum, uint8_t** src, size_t src_byt
 //void fmt_hexdump_raw(char* dst, uint8_t* src, size_t src_bytes);
 int fmt_hexdump_raw(uint8_t* dst, size_t* dst_accum, uint8_t** src, size_t src_bytes);
 
-const char* fmt_hexdump_header(uint8_t* data);
+const char* fmt_hexdump_header(uint8_t* data, char* buf);
 const char* fmt_crc(int crcqual, char* buf);
 const char* fmt_time(time_t* tstamp, char* buf);
 
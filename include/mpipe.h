@@ -19,6 +19,7 @@
 
 // Local Headers
 #include "formatters.h"
+#include "mpipe_rx.h"
 #include "otter_app.h"
 
 // HB Library Headers
@@ -38,6 +39,23 @@
 #define MPIOFLUSH   3
 #define MPODRAIN    4
 
+/// MPipe Control Field (header byte 7) flags.  A sender that sets EXTOK
+/// accepts frames with the extended header, and a frame with EXTHDR set has
+/// the extended header right after the legacy 8 byte header:
+/// [8] Session, [9:11] Sequence bits 31:8 (the legacy Sequence byte is 7:0).
+/// The Payload Length includes the extended header, so framing is unchanged.
+#define MPIPE_CTL_EXTOK     (1<<3)
+#define MPIPE_CTL_EXTHDR    (1<<4)
+#define MPIPE_EXTHDR_SIZE   4
+
+/// Flow control and modem line settings for mpipe_opentty().  A line left at
+/// MPIPE_LINE_KEEP stays however the driver sets it on open.
+#define MPIPE_FLOW_NONE     0
+#define MPIPE_FLOW_RTSCTS   1
+#define MPIPE_LINE_KEEP     0
+#define MPIPE_LINE_ON       1
+#define MPIPE_LINE_OFF      2
+
 
 
 // MPipe Data Type(s)
@@ -54,24 +72,66 @@ typedef struct {
 typedef enum {
     MPINTF_null   = 0,
     MPINTF_tty,
+    MPINTF_tcp,
+    MPINTF_udp,
+    MPINTF_unix,
     MPINTF_MAX
 } mpipe_intf_enum;
 
 typedef struct {
     char* path;
-    int baud;
+    int bps;            // baudrate in bits per second
+    int baud;           // baudrate as termios speed constant, -1 if none
     int data_bits;
     int parity;
     int stop_bits;
-    int flowctl;
-    int dtr;
-    int rts;
+    int flowctl;        // flow control as termios flag
+    int dtr;            // MPIPE_LINE_...
+    int rts;            // MPIPE_LINE_..., ignored with hardware flow control
+    long overruns;      // overruns counted on previous opens of the tty
+    long icount_base;   // driver overrun count when the tty was opened
+    int lowlatency;     // driver low-latency flag requested
 } mpipe_tty_t;
 
+/// Socket interfaces: path is the spec given to mpipe_opensock(), host and
+/// port are parsed out of it.  For unix sockets, host is the socket path.
+/// TCP/UDP addresses are resolved once, by mpipe_opensock(), so a reopen
+/// never waits on a name lookup.
+typedef struct {
+    char* path;
+    char* host;
+    char* port;
+    struct addrinfo* addrs;
+} mpipe_sock_t;
+
+/// TX counters of an interface.  They are kept by its TX worker in
+/// mpipe_writer(), and read with mpipe_txstats_get().
+typedef struct {
+    size_t matched;         // responses that matched a request sent
+    size_t unmatched;       // responses that matched no request
+    size_t completed;       // window requests completed by a response
+    size_t retransmits;
+    size_t timeouts;        // window requests dropped with no response
+    size_t dropped;         // packets refused by a full TX queue
+} mpipe_txstats_t;
+
 typedef struct {
     mpipe_intf_enum type;
     void*           params;
     mpipe_fd_t      fd;
+    mpipe_rx_t*     rx;         // RX decoder, owned by this interface
+    int             tx_gap_us;  // minimum idle time between TX frames
+    struct timespec tx_idle;    // estimated time the TX line goes idle
+    int             tx_window;  // max requests in flight, 0 = fire-and-forget
+    int             tx_timeout_ms;
+    int             tx_retries;
+    void*           tx;         // TX worker context, owned by mpipe_writer()
+    mpipe_txstats_t txstats;
+    int             exthdr;     // peer has sent frames with extended header
+    int             busypoll_us;
+    int64_t         busy_until; // CLOCK_MONOTONIC ns the reader busy-polls to
+    int             busy_wake[2];   // wakes the reader when busy_until is set
+    int             busy_pending;
 } mpipe_intf_t;
 
 typedef struct {
@@ -121,8 +181,113 @@ const char* mpipe_file_get(mpipe_handle_t handle, int id);
 void* mpipe_intf_get(mpipe_handle_t handle, int id);
 void* mpipe_intf_fromfile(mpipe_handle_t handle, const char* file);
 
+/** @brief Writes a frame to an interface, paced to the line rate
+  * @param intf         (void*) interface, from mpipe_intf_get() etc.
+  * @param data         (uint8_t*) frame to write
+  * @param data_bytes   (int) bytes in frame
+  * @retval None
+  *
+  * Frames are written back-to-back, so the output queue stays full and the
+  * line runs at full rate.  If the interface has an inter-frame gap (see
+  * mpipe_txgap_set()), the write waits until the previous frame has gone out
+  * on the wire, plus the gap.  Wire time is computed from the baudrate and
+  * byte framing, and corrected with TIOCOUTQ where available.
+  */
 void mpipe_writeto_intf(void* intf, uint8_t* data, int data_bytes);
 
+/** @brief Sets the minimum idle time between frames written to an interface
+  * @param handle       (mpipe_handle_t) mpipe handle
+  * @param id           (int) interface id
+  * @param gap_us       (int) gap in microseconds, 0 for back-to-back frames
+  * @retval int         0 on success, negative on bad handle/id
+  */
+int mpipe_txgap_set(mpipe_handle_t handle, int id, int gap_us);
+
+/** @brief Sets the outstanding-request window of an interface
+  * @param handle       (mpipe_handle_t) mpipe handle
+  * @param id           (int) interface id
+  * @param window       (int) max requests awaiting response, 0 to disable
+  * @param timeout_ms   (int) time to wait for a response before retransmit
+  * @param retries      (int) retransmissions before a request is given up
+  * @retval int         0 on success, negative on bad handle/id
+  *
+  * With a window, each request written to the interface is held until a
+  * response with the same MPipe sequence number comes back from it.  Up to
+  * window requests may be in flight, further requests wait in the TX queue.
+  * Window is clipped to OTTER_PARAM_TXWINDOW's limit of 128, which keeps
+  * in-flight sequence numbers unique.
+  */
+int mpipe_txwindow_set(mpipe_handle_t handle, int id, int window, int timeout_ms, int retries);
+
+/** @brief Reads the TX counters of an interface
+  * @param handle       (mpipe_handle_t) mpipe handle
+  * @param id           (int) interface id
+  * @param stats        (mpipe_txstats_t*) output
+  * @retval int         0 on success, negative on bad handle/id
+  *
+  * The counters are live, so this can be called while the TX workers run.
+  * Every response is counted as matched or unmatched, with or without a TX
+  * window, so unmatched shows sequence drift.  Completed, retransmits and
+  * timeouts only count when the interface has a TX window.
+  */
+int mpipe_txstats_get(mpipe_handle_t handle, int id, mpipe_txstats_t* stats);
+
+/** @brief Sets the low-latency mode of an interface
+  * @param handle       (mpipe_handle_t) mpipe handle
+  * @param id           (int) interface id
+  * @param enable       (bool) set the serial driver's low-latency flag
+  * @param busypoll_us  (int) after each frame written, the reader polls the
+  *                     interface without sleeping for this long, 0 to disable
+  * @retval int         0 on success, -1 on bad handle/id, -2 if the reader
+  *                     wakeup can't be opened (busypoll is left off).  1 if
+  *                     the driver won't take the low-latency flag (busypoll
+  *                     still applies).
+  *
+  * The low-latency flag is kept for the interface and applied again when it
+  * is reopened.  Only TTY interfaces have it.  Busy-polling trades a CPU core
+  * for the time it takes the reader thread to wake up after a response
+  * arrives, so keep the window to about one round-trip.
+  */
+int mpipe_lowlatency_set(mpipe_handle_t handle, int id, bool enable, int busypoll_us);
+
+/** @brief Tells if the reader should be busy-polling an interface
+  * @param intf         (void*) interface, from mpipe_intf_get() etc.
+  * @param now_ns       (int64_t) CLOCK_MONOTONIC time in ns
+  * @retval bool        true while inside the busy-poll window of the last TX
+  */
+bool mpipe_busypoll_get(void* intf, int64_t now_ns);
+
+/** @brief File descriptor that wakes the reader when a busy-poll window opens
+  * @param intf         (void*) interface, from mpipe_intf_get() etc.
+  * @retval int         fd to poll for POLLIN, or -1 if the interface has no
+  *                     busy-poll window
+  *
+  * The reader waits in poll() with no timeout, so it wouldn't see a window
+  * that opens while it sleeps.  mpipe_writeto_intf() signals this fd when it
+  * sets one.  The fd exists once mpipe_lowlatency_set() has been called with
+  * busypoll_us > 0, which must be done before the reader starts.
+  */
+int mpipe_busypoll_fd(void* intf);
+
+/** @brief Clears the busy-poll wakeup of an interface
+  * @param intf         (void*) interface, from mpipe_intf_get() etc.
+  * @retval None
+  */
+void mpipe_busypoll_clear(void* intf);
+
+/** @brief Extended header negotiation state of an interface
+  * @param intf         (void*) interface, from mpipe_intf_get() etc.
+  * @retval bool        true once the peer has sent an extended header frame
+  *
+  * Frames written to an interface use the extended header only after the
+  * peer has shown that it understands it, so legacy targets only ever see
+  * the legacy 8 byte header.  mpipe_exthdr_set() is called by the RX side.
+  * The state is cleared whenever the interface is opened or reopened, since
+  * the peer on the other end may have changed.
+  */
+bool mpipe_exthdr_get(void* intf);
+void mpipe_exthdr_set(void* intf);
+
 
 int mpipe_id_resolve(mpipe_handle_t handle, void* intfp);
 mpipe_fd_t* mpipe_fds_resolve(void* intfp);
@@ -131,13 +296,52 @@ const char* mpipe_file_resolve(void* intfp);
 
 int mpipe_close(mpipe_handle_t handle, int id);
 
+/** @brief Opens a TTY as an MPipe interface
+  * @param handle       (mpipe_handle_t) mpipe handle
+  * @param id           (int) interface id
+  * @param dev          (const char*) device file, e.g. /dev/ttyUSB0
+  * @param baud         (int) baudrate in bits per second
+  * @param data_bits    (int) 5-8
+  * @param parity       (char) 'N' for none, anything else for even
+  * @param stop_bits    (int) 1 or 2
+  * @param flowctrl     (int) MPIPE_FLOW_NONE or MPIPE_FLOW_RTSCTS
+  * @param dtr          (int) MPIPE_LINE_KEEP, _ON, or _OFF
+  * @param rts          (int) MPIPE_LINE_KEEP, _ON, or _OFF.  With RTS/CTS
+  *                     flow control the driver owns RTS, and this is ignored.
+  * @retval int         tty fd on success, negative on error
+  */
 int mpipe_opentty( mpipe_handle_t handle, int id,
                 const char *dev, int baud, 
                 int data_bits, char parity, int stop_bits, 
                 int flowctrl, int dtr, int rts    );
 
+/** @brief Opens a socket as an MPipe interface, in place of a TTY
+  * @param handle       (mpipe_handle_t) mpipe handle
+  * @param id           (int) interface id
+  * @param spec         (const char*) "tcp://host:port", "udp://host:port",
+  *                     or "unix:///path/to/socket"
+  * @retval int         socket fd on success, negative on error
+  *
+  * The socket is connected as a client, and the peer at the other end takes
+  * the place of the serial device.  Stream data goes through the same FF55
+  * decoder as a TTY, and UDP datagrams are treated as stream fragments.  A
+  * socket interface is reconnected by mpipe_reopen() like a TTY is reopened.
+  * mpipe_issock() tells whether a path names a socket interface.
+  */
+int mpipe_opensock(mpipe_handle_t handle, int id, const char* spec);
+
+bool mpipe_issock(const char* path);
+
 int mpipe_reopen( mpipe_handle_t handle, int id);
 
+/** @brief Receive overruns on an interface since it was first opened
+  * @param handle       (mpipe_handle_t) mpipe handle
+  * @param id           (int) interface id
+  * @retval long        UART and driver buffer overruns, or -1 if the interface
+  *                     doesn't report them (non-TTY, or not supported)
+  */
+long mpipe_overruns_get(mpipe_handle_t handle, int id);
+
 void mpipe_flush(mpipe_handle_t handle, int id, size_t est_rembytes, int queue_selector);
 
 
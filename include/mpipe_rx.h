@@ -0,0 +1,161 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+#ifndef mpipe_rx_h
+#define mpipe_rx_h
+
+// Local Headers
+#include "otter_cfg.h"
+
+// Standard C & POSIX Libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+
+/// Largest frame the decoder will assemble, not including the FF55 sync.
+/// This is the same limit mpipe_reader() has always used (1024 byte rbuf).
+#define MPIPE_RX_FRAMEMAX   1024
+#define MPIPE_RX_HDRSIZE    6
+
+/// Decoder states
+#define MPIPE_RX_SYNC0      0
+#define MPIPE_RX_SYNC1      1
+#define MPIPE_RX_HEADER     2
+#define MPIPE_RX_PAYLOAD    3
+
+
+/** MPipe RX Decoder <BR>
+  * ========================================================================<BR>
+  * Resumable decoder for MPipe frames.  Each interface owns one of these.
+  * mpipe_rx_fill() does a single large read() from the interface into the
+  * ring buffer, and mpipe_rx_getframe() is then called until it runs out of
+  * data, returning each complete frame as it gets assembled.  Partial frames
+  * are retained across calls, so a frame can arrive in any number of reads.
+  *
+  * Frames are returned without the FF55 sync, i.e. the same layout the reader
+  * has always passed to pktlist_add_rx():
+  * [0:1] CRC16, [2:3] Payload Length, [4] Sequence, [5] Control, [6..] Payload
+  * An extended header (see MPIPE_CTL_EXTHDR) is counted in the Payload Length,
+  * so the decoder frames it like any other payload.
+  *
+  * The CRC16 (over bytes 2 onward) is computed as the bytes are assembled, so
+  * a frame that fails it is dropped before it is ever queued.
+  *
+  * The caller may install lease functions (e.g. wrapping pktlist_lease()).
+  * Once the header of a frame is in, the decoder leases a buffer of the exact
+  * frame size and assembles the payload directly in it.  Ownership of the
+  * lease passes back to the caller with the frame.  Without a lease, frames
+  * are assembled in the decoder's own buffer.
+  */
+typedef uint8_t* (*mpipe_rx_leasefn_t)(void* ctx, size_t size, void** lease);
+typedef void (*mpipe_rx_releasefn_t)(void* lease);
+
+
+typedef struct {
+    size_t          head;           // free-running write count into ring
+    size_t          tail;           // free-running read count from ring
+    int             state;
+    bool            expired;
+    int             timeout_ms;
+    struct timespec lastrx;
+    size_t          frame_cursor;
+    size_t          frame_left;
+    uint16_t        crc;
+    uint8_t*        frame;
+    void*           lease;
+    void*           lease_ctx;
+    mpipe_rx_leasefn_t      lease_fn;
+    mpipe_rx_releasefn_t    release_fn;
+    uint8_t         spare[MPIPE_RX_FRAMEMAX];
+    uint8_t         ring[OTTER_PARAM_MPRXRING];
+} mpipe_rx_t;
+
+
+/** @brief Scans a buffer for the FF55 sync word
+  * @param buf          (const uint8_t*) buffer to scan
+  * @param len          (size_t) bytes in buffer
+  * @retval size_t      offset of the FF in the first FF55 pair, or len if none
+  *
+  * Uses AVX2 or SSE2 where the CPU has it (chosen at runtime), otherwise a
+  * memchr() based scalar scan.  All variants return identical results.
+  */
+size_t mpipe_rx_findsync(const uint8_t* buf, size_t len);
+
+
+/** @brief Initializes (or re-initializes) a decoder
+  * @param rx           (mpipe_rx_t*) decoder to initialize
+  * @param timeout_ms   (int) max inter-byte gap, in ms, within a frame
+  * @retval None
+  */
+void mpipe_rx_init(mpipe_rx_t* rx, int timeout_ms);
+
+
+/** @brief Drops buffered data and any partial frame, preserving timeout.
+  * @param rx           (mpipe_rx_t*) decoder to reset
+  * @retval None
+  *
+  * Use this whenever the underlying interface is flushed or reopened.  A
+  * lease holding a partial frame is released.
+  */
+void mpipe_rx_reset(mpipe_rx_t* rx);
+
+
+/** @brief Installs functions the decoder uses to lease frame buffers
+  * @param rx           (mpipe_rx_t*) decoder
+  * @param lease_fn     (mpipe_rx_leasefn_t) returns a buffer of at least size
+  *                     bytes and its lease handle, or NULL if none available
+  * @param release_fn   (mpipe_rx_releasefn_t) returns an unused lease
+  * @param ctx          (void*) passed to lease_fn
+  * @retval None
+  *
+  * Passing NULL functions reverts to the decoder's own buffer.
+  */
+void mpipe_rx_setlease(mpipe_rx_t* rx, mpipe_rx_leasefn_t lease_fn, mpipe_rx_releasefn_t release_fn, void* ctx);
+
+
+/** @brief Reads everything available on the fd into the decoder ring
+  * @param rx           (mpipe_rx_t*) decoder
+  * @param fd           (int) file descriptor, should be readable (via poll)
+  * @retval int         bytes read, 0 on EOF, negative on read() error
+  *
+  * If the gap since the last byte received exceeds the decoder timeout while
+  * a frame is partially assembled, the partial frame is discarded and the
+  * next call to mpipe_rx_getframe() reports the timeout.
+  */
+int mpipe_rx_fill(mpipe_rx_t* rx, int fd);
+
+
+/** @brief Pulls the next complete frame out of the decoder
+  * @param rx           (mpipe_rx_t*) decoder
+  * @param frame        (uint8_t**) output pointer to frame
+  * @param frame_size   (size_t*) output size of frame (header + payload)
+  * @param lease        (void**) output lease holding the frame, or NULL if the
+  *                     frame is in the decoder's own buffer (valid until the
+  *                     next call).  A returned lease is detached from rx.
+  * @retval int         0 when a frame is returned, -1 when more data is needed,
+  *                     2 on out-of-bounds payload length, 3 on CRC failure,
+  *                     4 on RX timeout.
+  *
+  * The positive error codes match the error codes used in mpipe_reader().
+  * On any error the decoder has already resynchronized, so the caller just
+  * keeps calling until -1 is returned.
+  */
+int mpipe_rx_getframe(mpipe_rx_t* rx, uint8_t** frame, size_t* frame_size, void** lease);
+
+
+#endif
@@ -0,0 +1,75 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+
+#ifndef mpipe_tty_h
+#define mpipe_tty_h
+
+/// Arbitrary integer baudrates are available through termios2 (BOTHER) on
+/// Linux.  Elsewhere, only the standard Bxxxx rates can be used.
+#if defined(__linux__)
+#   define MPIPE_TTY_ANYBAUD    1
+#else
+#   define MPIPE_TTY_ANYBAUD    0
+#endif
+
+/// Linux serial drivers keep error counters, available through TIOCGICOUNT,
+/// and take the ASYNC_LOW_LATENCY flag through TIOCSSERIAL.
+#if defined(__linux__)
+#   define MPIPE_TTY_ICOUNT     1
+#   define MPIPE_TTY_LOWLATENCY 1
+#else
+#   define MPIPE_TTY_ICOUNT     0
+#   define MPIPE_TTY_LOWLATENCY 0
+#endif
+
+
+/** @brief Sets a TTY to an arbitrary baudrate
+  * @param fd           (int) open TTY file descriptor, already configured
+  * @param bps          (int) baudrate in bits per second
+  * @retval int         baudrate set by the driver, negative on error or when
+  *                     MPIPE_TTY_ANYBAUD is 0
+  *
+  * Call this after tcsetattr(), which leaves the other termios settings in
+  * place.  Input and output are set to the same rate.
+  */
+int mpipe_tty_setbps(int fd, int bps);
+
+
+/** @brief Reads the receive overrun counter of a TTY
+  * @param fd           (int) open TTY file descriptor
+  * @retval long        UART overruns plus driver buffer overruns since the
+  *                     port was set up by the driver, negative if unavailable
+  *
+  * The counter is not reset when the TTY is opened, so callers should use it
+  * relative to a value read at open.
+  */
+long mpipe_tty_overruns(int fd);
+
+
+/** @brief Sets or clears the serial driver's low-latency flag
+  * @param fd           (int) open TTY file descriptor
+  * @param enable       (int) non-zero to set, 0 to clear
+  * @retval int         0 on success, negative if the driver doesn't take it
+  *
+  * With the flag, the driver pushes received bytes to the TTY layer right
+  * away instead of batching them.  USB-serial drivers such as ftdi_sio also
+  * drop their latency timer to 1 ms, which is most of the round-trip time.
+  */
+int mpipe_tty_lowlatency(int fd, int enable);
+
+
+#endif
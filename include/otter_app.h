@@ -54,10 +54,6 @@ typedef struct {
     pthread_cond_t*     tlist_cond;
     pthread_mutex_t*    tlist_cond_mutex;
     
-    bool                pktrx_cond_inactive;
-    pthread_cond_t*     pktrx_cond;
-    pthread_mutex_t*    pktrx_mutex;
-    
 } otter_app_t;
 
 
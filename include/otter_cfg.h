@@ -93,6 +93,14 @@
 #   define OTTER_FEATURE_MANDRAIN   (DISABLED /*|| OTTER_FEATURE_RUBBISHTTY*/)
 #endif
 
+#ifndef OTTER_FEATURE_MPRXTHREADS
+#   define OTTER_FEATURE_MPRXTHREADS    DISABLED
+#endif
+
+#ifndef OTTER_FEATURE_MPEXTHDR
+#   define OTTER_FEATURE_MPEXTHDR   ENABLED
+#endif
+
 #ifndef OTTER_FEATURE_HBUILDER
 #   ifdef __HBUILDER__
 #   define OTTER_FEATURE_HBUILDER   ENABLED
@@ -138,6 +146,60 @@
 #ifndef OTTER_PARAM_ENCALIGN
 #   define OTTER_PARAM_ENCALIGN     1
 #endif
+#ifndef OTTER_PARAM_MPRXRING
+#   define OTTER_PARAM_MPRXRING     4096
+#endif
+#ifndef OTTER_PARAM_MPRXTIMEOUT
+#   define OTTER_PARAM_MPRXTIMEOUT  50
+#endif
+#ifndef OTTER_PARAM_PKTBUFSIZE
+#   define OTTER_PARAM_PKTBUFSIZE   1024
+#endif
+#ifndef OTTER_PARAM_PKTSMALL
+#   define OTTER_PARAM_PKTSMALL     128
+#endif
+#ifndef OTTER_PARAM_PKTRESERVE
+#   define OTTER_PARAM_PKTRESERVE   8
+#endif
+#ifndef OTTER_PARAM_TXGAP
+#   define OTTER_PARAM_TXGAP        0
+#endif
+#ifndef OTTER_PARAM_TXWINDOW
+#   define OTTER_PARAM_TXWINDOW     0
+#endif
+#ifndef OTTER_PARAM_TXTIMEOUT
+#   define OTTER_PARAM_TXTIMEOUT    500
+#endif
+#ifndef OTTER_PARAM_TXRETRIES
+#   define OTTER_PARAM_TXRETRIES    2
+#endif
+#ifndef OTTER_PARAM_BUSYPOLL
+#   define OTTER_PARAM_BUSYPOLL     0
+#endif
+#ifndef OTTER_PARAM_RECONNECTMS
+#   define OTTER_PARAM_RECONNECTMS  100
+#endif
+#ifndef OTTER_PARAM_SOCKCONNECTMS
+#   define OTTER_PARAM_SOCKCONNECTMS 1000
+#endif
+#ifndef OTTER_PARAM_PKTBLOCKMS
+#   define OTTER_PARAM_PKTBLOCKMS   100
+#endif
+#ifndef OTTER_PARAM_RLISTSIZE
+#   define OTTER_PARAM_RLISTSIZE    32
+#endif
+#ifndef OTTER_PARAM_TLISTSIZE
+#   define OTTER_PARAM_TLISTSIZE    8
+#endif
+#ifndef OTTER_PARAM_PARSETHREADS
+#   define OTTER_PARAM_PARSETHREADS 1
+#endif
+#ifndef OTTER_PARAM_ROUTEPEND
+#   define OTTER_PARAM_ROUTEPEND    32
+#endif
+#ifndef OTTER_PARAM_ROUTETTL
+#   define OTTER_PARAM_ROUTETTL     60
+#endif
 #ifndef OTTER_DEVTAB_CHUNK
 #   define OTTER_DEVTAB_CHUNK       1
 #endif
@@ -158,6 +220,18 @@
 #   error "OTTER_PARAM_ENCALIGN must be 1, 2, or 4.  Default=1"
 #endif
 
+#if (OTTER_PARAM_PKTSMALL >= OTTER_PARAM_PKTBUFSIZE)
+#   error "OTTER_PARAM_PKTSMALL must be smaller than OTTER_PARAM_PKTBUFSIZE"
+#endif
+
+#if ((OTTER_PARAM_MPRXRING < 1024) || (OTTER_PARAM_MPRXRING & (OTTER_PARAM_MPRXRING-1)))
+#   error "OTTER_PARAM_MPRXRING must be a power of 2, at least 1024.  Default=4096"
+#endif
+
+#if ((OTTER_PARAM_TXWINDOW < 0) || (OTTER_PARAM_TXWINDOW > 128))
+#   error "OTTER_PARAM_TXWINDOW must be between 0 and 128.  Default=0"
+#endif
+
 
 
 
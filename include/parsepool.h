@@ -0,0 +1,112 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+#ifndef parsepool_h
+#define parsepool_h
+
+// Local Headers
+#include "pktlist.h"
+
+// Standard C & POSIX Libraries
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/** Parser Pool <BR>
+  * ========================================================================<BR>
+  * A fixed set of worker threads that format received packets in parallel.
+  * The parser thread keeps doing everything that depends on packet order
+  * (parsing the rlist, completing the TX window, learning routes), then
+  * hands each packet to a worker picked from its interface and a shard key.
+  * All packets with the same key go to the same worker, so they are still
+  * output in the order received, but separate keys are processed on
+  * separate cores.  The key must be known for every packet of a device:
+  * MPipe only knows the source of matched responses, so it shards by
+  * interface alone (key 0), while Modbus uses the slave address byte.
+  *
+  * Packets given to the pool must be detached from the rlist (see
+  * pktlist_detach()).  The worker function owns the packet and must delete
+  * it.
+  */
+typedef void (*parsepool_fn_t)(void* ctx, char* putsbuf, pkt_t* rpkt, uint64_t rxaddr);
+
+typedef struct {
+    pkt_t*          pkt;
+    uint64_t        rxaddr;
+} parsepool_job_t;
+
+typedef struct {
+    pthread_t       thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;           // job queued
+    pthread_cond_t  space_cond;     // job taken
+    parsepool_job_t* queue;
+    size_t          mask;
+    size_t          head;
+    size_t          tail;
+    char*           putsbuf;
+    void*           pool;
+} parsepool_worker_t;
+
+typedef struct {
+    parsepool_worker_t* worker;
+    int             count;
+    parsepool_fn_t  fn;
+    void*           ctx;
+} parsepool_t;
+
+
+/** @brief Starts the worker threads of a parser pool
+  * @param pool         (parsepool_t*) pool to start
+  * @param workers      (int) number of worker threads
+  * @param depth        (size_t) minimum queue depth of each worker
+  * @param fn           (parsepool_fn_t) called by a worker for each packet
+  * @param ctx          (void*) passed to fn
+  * @param bufsize      (size_t) size of the putsbuf each worker gives to fn
+  * @retval int         0 on success, negative on error
+  *
+  * On error, the pool must still be stopped to clean up the workers that
+  * did start.
+  */
+int parsepool_start(parsepool_t* pool, int workers, size_t depth, parsepool_fn_t fn, void* ctx, size_t bufsize);
+
+
+/** @brief Stops the workers of a parser pool and frees its resources
+  * @param pool         (void*) parsepool_t* of the pool to stop
+  * @retval None
+  *
+  * The argument is void* so this can be used as a pthread cleanup handler.
+  * A packet a worker is in the middle of is finished first.  Packets still
+  * queued are deleted without being processed.
+  */
+void parsepool_stop(void* pool);
+
+
+/** @brief Queues a packet on the worker for its interface and shard key
+  * @param pool         (parsepool_t*) started pool
+  * @param rpkt         (pkt_t*) detached packet
+  * @param rxaddr       (uint64_t) source address of the packet, 0 if unknown
+  * @param key          (uint64_t) shard key, 0 to shard by interface only
+  * @retval None
+  *
+  * Blocks while the worker's queue is full.
+  */
+void parsepool_dispatch(parsepool_t* pool, pkt_t* rpkt, uint64_t rxaddr, uint64_t key);
+
+
+#endif
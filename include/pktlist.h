@@ -17,19 +17,65 @@
 #include <time.h>
 #include <pthread.h>
 
+/// Overflow policy, applied when a packet is added to a full list
+typedef enum {
+    PKTLIST_DROPOLDEST = 0,     // delete the oldest packet
+    PKTLIST_DROPNEWEST,         // refuse the new packet
+    PKTLIST_BLOCK,              // wait for room up to block_ms, then refuse
+    PKTLIST_PRIORITY,           // evict low-priority (logger) packets first
+    PKTLIST_POLICY_MAX
+} pktlist_policy_t;
+
 typedef struct pkt {
     void*           parent;
     void*           intf;       //devtab_node_t   devnode;
     uint8_t*        buffer;
+    size_t          bufsize;    // capacity of buffer
+    int             slot;       // index in pktlist ring, or -1 if allocated
+    int             sizeclass;  // buffer slab size class, or -1 if allocated
     size_t          size;
     int             crcqual;
     uint32_t        sequence;
+    int             session;    // MPipe extended header session, or -1
+    int             refs;       // references held by TX writer workers
+    bool            lowprio;    // logger output, evicted first on overflow
     time_t          tstamp;
     struct pkt      *prev;
     struct pkt      *next;
 } pkt_t;
 
 
+/// Packet buffers come from fixed slabs, one per size class.  A buffer is
+/// taken from the smallest class that fits and has a free buffer.
+#define PKTLIST_NUMCLASSES  2
+
+typedef struct {
+    uint8_t*    base;
+    size_t      bufsize;
+    size_t      count;
+    size_t      free_count;
+    uint16_t*   free_stack;
+} pktslab_t;
+
+/// Lock-free handoff from one producer thread into a pktlist.  The producer
+/// (e.g. an RX interface) posts packets without taking the list mutex, and
+/// pktlist_parse() moves them into the list, under the list policy, before it
+/// takes the next one.  Producer and consumer indices are kept on separate
+/// cache lines.
+#define PKTLIST_CACHELINE   64
+
+typedef struct pktinbox {
+    pkt_t**             slot;
+    size_t              mask;
+    void*               parent;
+    struct pktinbox*    next;
+    uint8_t             pad0[PKTLIST_CACHELINE];
+    size_t              head;       // written only by producer
+    uint8_t             pad1[PKTLIST_CACHELINE - sizeof(size_t)];
+    size_t              tail;       // written only with the list mutex
+    uint8_t             pad2[PKTLIST_CACHELINE - sizeof(size_t)];
+} pktinbox_t;
+
 ///@todo put this inside C file
 typedef struct {
     pkt_t*  front;
@@ -38,6 +84,31 @@ typedef struct {
     size_t  size;
     size_t  max;
     int     txnonce;
+    
+    // Fixed-capacity ring of packet slots, and buffer slabs
+    pkt_t*      ring;
+    size_t      ring_size;
+    size_t      ring_next;
+    pktslab_t   slab[PKTLIST_NUMCLASSES];
+    
+    // Producer inboxes, and the wakeup used by RX producers.  The wakeup is an
+    // eventfd (or a pipe), so a signal is never lost, and it is only written
+    // when the consumer has not yet been woken, so bursts are coalesced.
+    pktinbox_t* inbox;
+    pktinbox_t* inbox_cursor;
+    int         bell_pending;
+    int         bell_fd[2];
+    
+    // Overflow policy and its drop counters.  Inbox posts count here too.
+    pktlist_policy_t policy;
+    int         block_ms;
+    size_t      drop_oldest;        // oldest packet deleted to make room
+    size_t      drop_newest;        // new packet refused
+    size_t      drop_lowprio;       // low-priority packet evicted or refused
+    size_t      block_timeouts;     // producer gave up waiting for room
+    size_t      alloc_fallback;     // packet allocated outside the ring/slabs
+    pthread_cond_t  space_cond;
+    
     pthread_mutex_t mutex;
 } pktlist_t;
 
@@ -47,17 +118,39 @@ typedef struct {
 int pktlist_init(pktlist_t** plist, size_t max);
 void pktlist_free(pktlist_t* plist);
 void pktlist_empty(pktlist_t* plist);
+int pktlist_policy_set(pktlist_t* plist, pktlist_policy_t policy, int block_ms);
 
 pkt_t* pktlist_get(pktlist_t* plist);
+pkt_t* pktlist_take(pktlist_t* plist);
+
+// Unlinks a packet returned by pktlist_parse(), so it can be handed to another
+// thread.  It must still be freed with pktlist_del().
+int pktlist_detach(pkt_t* pkt);
+
 pkt_t* pktlist_parse(int* errcode, pktlist_t* plist);
 pkt_t* pktlist_add_tx(user_endpoint_t* endpoint, void* intf, pktlist_t* plist, uint8_t* data, size_t size);
 pkt_t* pktlist_add_rx(user_endpoint_t* endpoint, void* intf, pktlist_t* plist,uint8_t* data, size_t size);
 
+// Zero-copy RX: lease a packet, fill its buffer in place, then post it to an
+// inbox.  A leased packet that is not posted must be released.
+pkt_t* pktlist_lease(pktlist_t* plist, size_t size);
+pktinbox_t* pktlist_inbox_open(pktlist_t* plist);
+pkt_t* pktlist_post_rx(pktinbox_t* inbox, void* intf, pkt_t* pkt, size_t size);
+void pktlist_release(pkt_t* pkt);
+
+// Blocks the consumer until RX packets have been added since the last wait.
+// After it returns, the consumer must parse until the list is empty.
+void pktlist_wait(pktlist_t* plist);
+
 int pktlist_punt(pkt_t* pkt);
 int pktlist_del(pkt_t* pkt);
 
 int pktlist_del_sequence(pktlist_t* plist, uint32_t sequence);
 
+// Session number this otter instance puts in MPipe extended headers.  It is
+// picked at startup, so responses to a previous instance are not matched.
+int pktlist_session(void);
+
 
 
 
@@ -66,6 +66,27 @@ void user_deinit(void);
 
 
 
+/** @brief Copies an endpoint, consistently with user_endpoint_set()
+  * @param dst          (user_endpoint_t*) copy output
+  * @param endpoint     (user_endpoint_t*) endpoint shared between threads
+  * @retval None
+  *
+  * The command handlers change the active endpoint while the reader and
+  * parser threads are using it, so those threads work from a copy.
+  */
+void user_endpoint_get(user_endpoint_t* dst, user_endpoint_t* endpoint);
+
+
+/** @brief Changes the user type and node of an endpoint
+  * @param endpoint     (user_endpoint_t*) endpoint shared between threads
+  * @param usertype     (USER_Type) new user type
+  * @param node         (devtab_node_t) new node
+  * @retval None
+  */
+void user_endpoint_set(user_endpoint_t* endpoint, USER_Type usertype, devtab_node_t node);
+
+
+
 /** @brief gets usertype from descriptive string
   * @param type_string  (const char*) user type string (root, user, guest)
   * @retval int         Zero on success. Negative on error.
@@ -105,3 +105,22 @@ void cliopt_settimeout(int timeout_ms) {
     master->timeout_ms = timeout_ms;
 }
 
+size_t cliopt_getrlistsize(void) {
+    return master->rlist_size;
+}
+
+size_t cliopt_gettlistsize(void) {
+    return master->tlist_size;
+}
+
+int cliopt_getrlistpolicy(void) {
+    return master->rlist_policy;
+}
+
+int cliopt_gettlistpolicy(void) {
+    return master->tlist_policy;
+}
+
+int cliopt_getparsethreads(void) {
+    return master->parse_threads;
+}
@@ -0,0 +1,563 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+// Application Includes
+#include "codec.h"
+
+// Standard C & POSIX libraries
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#   define _CODEC_X86
+#   include <immintrin.h>
+#endif
+
+
+static const char hexconv[16] = "0123456789ABCDEF";
+
+
+
+/** Hex Encoders <BR>
+  * ========================================================================<BR>
+  * The vector versions split each byte into nibbles and use them as indices
+  * into a 16 byte table of hex digits (pshufb), then interleave the high and
+  * low digits.  The spaced versions put a space after every byte, so columns
+  * only need a newline patched in now and then.  Tails go to the scalar one.
+  */
+static size_t sub_hexenc_scalar(char* dst, const uint8_t* src, size_t srcsz) {
+    for (size_t i=0; i<srcsz; i++) {
+        *dst++ = hexconv[src[i] >> 4];
+        *dst++ = hexconv[src[i] & 0x0f];
+    }
+    return 2*srcsz;
+}
+
+static size_t sub_hexenc_sp_scalar(char* dst, const uint8_t* src, size_t srcsz) {
+    for (size_t i=0; i<srcsz; i++) {
+        *dst++ = hexconv[src[i] >> 4];
+        *dst++ = hexconv[src[i] & 0x0f];
+        *dst++ = ' ';
+    }
+    return 3*srcsz;
+}
+
+#if defined(_CODEC_X86)
+__attribute__((target("ssse3")))
+static size_t sub_hexenc_ssse3(char* dst, const uint8_t* src, size_t srcsz) {
+    const __m128i lut   = _mm_loadu_si128((const __m128i*)hexconv);
+    const __m128i mask  = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; (i+16) <= srcsz; i+=16) {
+        __m128i v   = _mm_loadu_si128((const __m128i*)&src[i]);
+        __m128i hi  = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo  = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i*)&dst[2*i],    _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i*)&dst[2*i+16], _mm_unpackhi_epi8(hi, lo));
+    }
+    return 2*i + sub_hexenc_scalar(&dst[2*i], &src[i], srcsz-i);
+}
+
+__attribute__((target("ssse3")))
+static size_t sub_hexenc_sp_ssse3(char* dst, const uint8_t* src, size_t srcsz) {
+/// 16 bytes make 48 chars: three output vectors, each picking its digits
+/// from the high and low digit vectors.  -1 picks zero, where the space is
+/// OR'ed in.
+    const __m128i lut   = _mm_loadu_si128((const __m128i*)hexconv);
+    const __m128i mask  = _mm_set1_epi8(0x0f);
+    const __m128i hsel0 = _mm_setr_epi8( 0,-1,-1, 1,-1,-1, 2,-1,-1, 3,-1,-1, 4,-1,-1, 5);
+    const __m128i lsel0 = _mm_setr_epi8(-1, 0,-1,-1, 1,-1,-1, 2,-1,-1, 3,-1,-1, 4,-1,-1);
+    const __m128i hsel1 = _mm_setr_epi8(-1,-1, 6,-1,-1, 7,-1,-1, 8,-1,-1, 9,-1,-1,10,-1);
+    const __m128i lsel1 = _mm_setr_epi8( 5,-1,-1, 6,-1,-1, 7,-1,-1, 8,-1,-1, 9,-1,-1,10);
+    const __m128i hsel2 = _mm_setr_epi8(-1,11,-1,-1,12,-1,-1,13,-1,-1,14,-1,-1,15,-1,-1);
+    const __m128i lsel2 = _mm_setr_epi8(-1,-1,11,-1,-1,12,-1,-1,13,-1,-1,14,-1,-1,15,-1);
+    const __m128i sp0   = _mm_setr_epi8( 0, 0,32, 0, 0,32, 0, 0,32, 0, 0,32, 0, 0,32, 0);
+    const __m128i sp1   = _mm_setr_epi8( 0,32, 0, 0,32, 0, 0,32, 0, 0,32, 0, 0,32, 0, 0);
+    const __m128i sp2   = _mm_setr_epi8(32, 0, 0,32, 0, 0,32, 0, 0,32, 0, 0,32, 0, 0,32);
+    size_t i = 0;
+
+    for (; (i+16) <= srcsz; i+=16) {
+        __m128i v   = _mm_loadu_si128((const __m128i*)&src[i]);
+        __m128i hi  = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo  = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+        __m128i o0  = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(hi, hsel0), _mm_shuffle_epi8(lo, lsel0)), sp0);
+        __m128i o1  = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(hi, hsel1), _mm_shuffle_epi8(lo, lsel1)), sp1);
+        __m128i o2  = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(hi, hsel2), _mm_shuffle_epi8(lo, lsel2)), sp2);
+        _mm_storeu_si128((__m128i*)&dst[3*i],    o0);
+        _mm_storeu_si128((__m128i*)&dst[3*i+16], o1);
+        _mm_storeu_si128((__m128i*)&dst[3*i+32], o2);
+    }
+    return 3*i + sub_hexenc_sp_scalar(&dst[3*i], &src[i], srcsz-i);
+}
+
+__attribute__((target("avx2")))
+static size_t sub_hexenc_avx2(char* dst, const uint8_t* src, size_t srcsz) {
+/// pshufb and unpack work within each 128 bit lane, so the two halves of the
+/// output are put back in order with a lane permute.
+    const __m256i lut   = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)hexconv));
+    const __m256i mask  = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; (i+32) <= srcsz; i+=32) {
+        __m256i v   = _mm256_loadu_si256((const __m256i*)&src[i]);
+        __m256i hi  = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i lo  = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+        __m256i a   = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b   = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i*)&dst[2*i],    _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i*)&dst[2*i+32], _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    return 2*i + sub_hexenc_ssse3(&dst[2*i], &src[i], srcsz-i);
+}
+#endif
+
+
+/** Hex Decoders <BR>
+  * ========================================================================<BR>
+  * Each decoder stops at the first char that isn't a hex digit and returns
+  * the number of chars it got through.  Only complete pairs are decoded, so
+  * the char count is even unless it stopped on the second digit of a pair.
+  * The vector versions validate a whole vector at a time, and on an invalid
+  * char they hand the vector over to the scalar one, which finds it.
+  *
+  * Digits are validated and converted with unsigned range compares: c-'0'
+  * for 0-9, and (c|0x20)-'a' for a-f and A-F.  maddubs then makes each pair
+  * of nibbles into a byte (hi*16 + lo).
+  */
+static const uint8_t hexnib[256] = {
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+      0,  1,  2,  3,  4,  5,  6,  7,  8,  9,255,255,255,255,255,255,
+    255, 10, 11, 12, 13, 14, 15,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255, 10, 11, 12, 13, 14, 15,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255
+};
+
+static size_t sub_hexdec_scalar(uint8_t* dst, const char* src, size_t srcsz) {
+    size_t i;
+    
+    for (i=0; (i+2) <= srcsz; i+=2) {
+        uint8_t a = hexnib[(uint8_t)src[i]];
+        uint8_t b = hexnib[(uint8_t)src[i+1]];
+        if ((a | b) & 0xF0) {
+            return i + (a > 15 ? 0 : 1);
+        }
+        *dst++ = (uint8_t)((a << 4) | b);
+    }
+    if ((i < srcsz) && (hexnib[(uint8_t)src[i]] <= 15)) {
+        i++;
+    }
+    return i;
+}
+
+#if defined(_CODEC_X86)
+__attribute__((target("ssse3")))
+static inline __m128i sub_hexnib_ssse3(__m128i v, int* valid) {
+    const __m128i c0    = _mm_set1_epi8('0');
+    const __m128i ca    = _mm_set1_epi8('a');
+    const __m128i lc    = _mm_set1_epi8(0x20);
+    const __m128i c9    = _mm_set1_epi8(9);
+    const __m128i c5    = _mm_set1_epi8(5);
+    const __m128i c10   = _mm_set1_epi8(10);
+    __m128i d   = _mm_sub_epi8(v, c0);
+    __m128i l   = _mm_sub_epi8(_mm_or_si128(v, lc), ca);
+    __m128i isd = _mm_cmpeq_epi8(_mm_min_epu8(d, c9), d);
+    __m128i isl = _mm_cmpeq_epi8(_mm_min_epu8(l, c5), l);
+    
+    *valid = _mm_movemask_epi8(_mm_or_si128(isd, isl));
+    return _mm_or_si128(_mm_and_si128(isd, d), _mm_and_si128(isl, _mm_add_epi8(l, c10)));
+}
+
+__attribute__((target("ssse3")))
+static size_t sub_hexdec_ssse3(uint8_t* dst, const char* src, size_t srcsz) {
+    const __m128i pair = _mm_set1_epi16(0x0110);
+    size_t i = 0;
+
+    for (; (i+32) <= srcsz; i+=32) {
+        int valid0, valid1;
+        __m128i n0  = sub_hexnib_ssse3(_mm_loadu_si128((const __m128i*)&src[i]), &valid0);
+        __m128i n1  = sub_hexnib_ssse3(_mm_loadu_si128((const __m128i*)&src[i+16]), &valid1);
+        if ((valid0 & valid1) != 0xFFFF) {
+            break;
+        }
+        n0 = _mm_maddubs_epi16(n0, pair);
+        n1 = _mm_maddubs_epi16(n1, pair);
+        _mm_storeu_si128((__m128i*)&dst[i/2], _mm_packus_epi16(n0, n1));
+    }
+    return i + sub_hexdec_scalar(&dst[i/2], &src[i], srcsz-i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i sub_hexnib_avx2(__m256i v, unsigned int* valid) {
+    const __m256i c0    = _mm256_set1_epi8('0');
+    const __m256i ca    = _mm256_set1_epi8('a');
+    const __m256i lc    = _mm256_set1_epi8(0x20);
+    const __m256i c9    = _mm256_set1_epi8(9);
+    const __m256i c5    = _mm256_set1_epi8(5);
+    const __m256i c10   = _mm256_set1_epi8(10);
+    __m256i d   = _mm256_sub_epi8(v, c0);
+    __m256i l   = _mm256_sub_epi8(_mm256_or_si256(v, lc), ca);
+    __m256i isd = _mm256_cmpeq_epi8(_mm256_min_epu8(d, c9), d);
+    __m256i isl = _mm256_cmpeq_epi8(_mm256_min_epu8(l, c5), l);
+    
+    *valid = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(isd, isl));
+    return _mm256_or_si256(_mm256_and_si256(isd, d), _mm256_and_si256(isl, _mm256_add_epi8(l, c10)));
+}
+
+__attribute__((target("avx2")))
+static size_t sub_hexdec_avx2(uint8_t* dst, const char* src, size_t srcsz) {
+/// packus works within each 128 bit lane, so the 64 bit quarters of the
+/// result are put back in order with a permute.
+    const __m256i pair = _mm256_set1_epi16(0x0110);
+    size_t i = 0;
+
+    for (; (i+64) <= srcsz; i+=64) {
+        unsigned int valid0, valid1;
+        __m256i n0  = sub_hexnib_avx2(_mm256_loadu_si256((const __m256i*)&src[i]), &valid0);
+        __m256i n1  = sub_hexnib_avx2(_mm256_loadu_si256((const __m256i*)&src[i+32]), &valid1);
+        if ((valid0 & valid1) != 0xFFFFFFFFU) {
+            break;
+        }
+        n0 = _mm256_maddubs_epi16(n0, pair);
+        n1 = _mm256_maddubs_epi16(n1, pair);
+        _mm256_storeu_si256((__m256i*)&dst[i/2], _mm256_permute4x64_epi64(_mm256_packus_epi16(n0, n1), 0xD8));
+    }
+    return i + sub_hexdec_ssse3(&dst[i/2], &src[i], srcsz-i);
+}
+#endif
+
+
+/** Base64 Codecs <BR>
+  * ========================================================================<BR>
+  * Standard alphabet (RFC 4648) with '=' padding.  The vector versions work
+  * on 12 bytes / 16 chars at a time (Mula's method): the encoder shuffles
+  * each 3 bytes into a 32 bit lane and pulls out the four sextets with
+  * multiplies, then maps sextets to chars by adding an offset looked up by
+  * range.  The decoder validates each char from its nibbles with two small
+  * tables, then maps and packs the sextets back into bytes with multiply-
+  * adds.  A vector holding padding or an invalid char goes to the scalar one.
+  */
+static const char b64conv[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const uint8_t b64val[256] = {
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255, 62,255,255,255, 63,
+     52, 53, 54, 55, 56, 57, 58, 59, 60, 61,255,255,255,255,255,255,
+    255,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+     15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,255,255,255,255,255,
+    255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+     41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+    255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255
+};
+
+static size_t sub_b64enc_scalar(char* dst, const uint8_t* src, size_t srcsz) {
+    char* start = dst;
+    size_t i;
+    
+    for (i=0; (i+3) <= srcsz; i+=3) {
+        uint32_t acc = ((uint32_t)src[i] << 16) | ((uint32_t)src[i+1] << 8) | src[i+2];
+        *dst++ = b64conv[(acc >> 18) & 63];
+        *dst++ = b64conv[(acc >> 12) & 63];
+        *dst++ = b64conv[(acc >> 6) & 63];
+        *dst++ = b64conv[acc & 63];
+    }
+    if (i < srcsz) {
+        uint32_t acc = (uint32_t)src[i] << 16;
+        if ((i+1) < srcsz) {
+            acc |= (uint32_t)src[i+1] << 8;
+        }
+        *dst++ = b64conv[(acc >> 18) & 63];
+        *dst++ = b64conv[(acc >> 12) & 63];
+        *dst++ = ((i+1) < srcsz) ? b64conv[(acc >> 6) & 63] : '=';
+        *dst++ = '=';
+    }
+    return (size_t)(dst - start);
+}
+
+static size_t sub_b64dec_scalar(uint8_t* dst, const char* src, size_t srcsz, size_t* bad) {
+/// Decodes whole quads, then a last quad of 2-4 chars with optional padding.
+/// Stops at the first invalid char, or anything after the padding.
+    uint8_t* start = dst;
+    uint32_t acc;
+    size_t i;
+    int n;
+    
+    for (i=0; (i+4) <= srcsz; i+=4) {
+        uint8_t a = b64val[(uint8_t)src[i]];
+        uint8_t b = b64val[(uint8_t)src[i+1]];
+        uint8_t c = b64val[(uint8_t)src[i+2]];
+        uint8_t d = b64val[(uint8_t)src[i+3]];
+        if ((a | b | c | d) & 0xC0) {
+            break;
+        }
+        acc     = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | d;
+        *dst++  = (uint8_t)(acc >> 16);
+        *dst++  = (uint8_t)(acc >> 8);
+        *dst++  = (uint8_t)acc;
+    }
+    
+    for (acc=0, n=0; (i < srcsz) && (n < 4); i++, n++) {
+        uint8_t v = b64val[(uint8_t)src[i]];
+        if (v > 63) {
+            break;
+        }
+        acc = (acc << 6) | v;
+    }
+    switch (n) {
+        case 1: i--;
+                break;
+        case 2: *dst++ = (uint8_t)(acc >> 4);
+                break;
+        case 3: *dst++ = (uint8_t)(acc >> 10);
+                *dst++ = (uint8_t)(acc >> 2);
+                break;
+        default: break;
+    }
+    if (n >= 2) {
+        for (; (n < 4) && (i < srcsz) && (src[i] == '='); i++, n++);
+    }
+    
+    *bad = i;
+    return (size_t)(dst - start);
+}
+
+#if defined(_CODEC_X86)
+__attribute__((target("ssse3")))
+static size_t sub_b64enc_ssse3(char* dst, const uint8_t* src, size_t srcsz) {
+/// Each load takes 16 bytes and uses the first 12, so the loop stops while
+/// there are still 4 to spare.
+    const __m128i shuf  = _mm_setr_epi8(1,0,2,1, 4,3,5,4, 7,6,8,7, 10,9,11,10);
+    const __m128i lut   = _mm_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+                                        '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+                                        '+'-62, '/'-63, 'A', 0, 0);
+    size_t i = 0;
+    size_t j = 0;
+
+    for (; (i+16) <= srcsz; i+=12, j+=16) {
+        __m128i in  = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[i]), shuf);
+        __m128i t0  = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+        __m128i t1  = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+        __m128i idx = _mm_or_si128(t0, t1);
+        __m128i off = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+        __m128i lt  = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+        off = _mm_or_si128(off, _mm_and_si128(lt, _mm_set1_epi8(13)));
+        off = _mm_shuffle_epi8(lut, off);
+        _mm_storeu_si128((__m128i*)&dst[j], _mm_add_epi8(idx, off));
+    }
+    return j + sub_b64enc_scalar(&dst[j], &src[i], srcsz-i);
+}
+
+__attribute__((target("ssse3")))
+static size_t sub_b64dec_ssse3(uint8_t* dst, const char* src, size_t srcsz, size_t* bad) {
+/// Each store writes 16 bytes, of which 12 are decoded, so the loop stops
+/// while there are at least two more quads behind it.  Nothing gets written
+/// past what the scalar decoder will then write.
+    const __m128i shiftlut  = _mm_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i masklut   = _mm_setr_epi8((char)0xA8, (char)0xF8, (char)0xF8, (char)0xF8,
+                                            (char)0xF8, (char)0xF8, (char)0xF8, (char)0xF8,
+                                            (char)0xF8, (char)0xF8, (char)0xF0, 0x54,
+                                            0x50, 0x50, 0x50, 0x54);
+    const __m128i bitlut    = _mm_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+                                            0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack      = _mm_setr_epi8(2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1);
+    const __m128i nib       = _mm_set1_epi8(0x0F);
+    size_t i = 0;
+    size_t j = 0;
+    size_t pos;
+
+    for (; (i+24) <= srcsz; i+=16, j+=12) {
+        __m128i in  = _mm_loadu_si128((const __m128i*)&src[i]);
+        __m128i hi  = _mm_and_si128(_mm_srli_epi32(in, 4), nib);
+        __m128i lo  = _mm_and_si128(in, nib);
+        __m128i ok  = _mm_and_si128(_mm_shuffle_epi8(masklut, lo), _mm_shuffle_epi8(bitlut, hi));
+        __m128i sl  = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+        __m128i sh;
+        
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(ok, _mm_setzero_si128())) != 0) {
+            break;
+        }
+        sh  = _mm_shuffle_epi8(shiftlut, hi);
+        sh  = _mm_or_si128(_mm_andnot_si128(sl, sh), _mm_and_si128(sl, _mm_set1_epi8(16)));
+        in  = _mm_add_epi8(in, sh);
+        in  = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+        in  = _mm_madd_epi16(in, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i*)&dst[j], _mm_shuffle_epi8(in, pack));
+    }
+    j   += sub_b64dec_scalar(&dst[j], &src[i], srcsz-i, &pos);
+    *bad = i + pos;
+    return j;
+}
+#endif
+
+
+typedef size_t (*sub_hexenc_t)(char*, const uint8_t*, size_t);
+typedef size_t (*sub_hexdec_t)(uint8_t*, const char*, size_t);
+typedef size_t (*sub_b64dec_t)(uint8_t*, const char*, size_t, size_t*);
+
+static size_t sub_hexenc_resolve(char* dst, const uint8_t* src, size_t srcsz);
+static size_t sub_hexenc_sp_resolve(char* dst, const uint8_t* src, size_t srcsz);
+static size_t sub_hexdec_resolve(uint8_t* dst, const char* src, size_t srcsz);
+static sub_hexenc_t sub_hexenc      = &sub_hexenc_resolve;
+static sub_hexenc_t sub_hexenc_sp   = &sub_hexenc_sp_resolve;
+static size_t sub_b64enc_resolve(char* dst, const uint8_t* src, size_t srcsz);
+static size_t sub_b64dec_resolve(uint8_t* dst, const char* src, size_t srcsz, size_t* bad);
+static sub_hexdec_t sub_hexdec      = &sub_hexdec_resolve;
+static sub_hexenc_t sub_b64enc      = &sub_b64enc_resolve;
+static sub_b64dec_t sub_b64dec      = &sub_b64dec_resolve;
+
+static void sub_codec_select(void) {
+/// Runs once, on first use, to pick the best codecs for this CPU.  The race
+/// between threads is harmless: each writes the same values.
+    sub_hexenc_t enc    = &sub_hexenc_scalar;
+    sub_hexenc_t enc_sp = &sub_hexenc_sp_scalar;
+    sub_hexdec_t dec    = &sub_hexdec_scalar;
+    sub_hexenc_t b64enc = &sub_b64enc_scalar;
+    sub_b64dec_t b64dec = &sub_b64dec_scalar;
+
+#   if defined(_CODEC_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        enc     = &sub_hexenc_ssse3;
+        enc_sp  = &sub_hexenc_sp_ssse3;
+        dec     = &sub_hexdec_ssse3;
+        b64enc  = &sub_b64enc_ssse3;
+        b64dec  = &sub_b64dec_ssse3;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        enc     = &sub_hexenc_avx2;
+        dec     = &sub_hexdec_avx2;
+    }
+#   endif
+
+    sub_hexenc      = enc;
+    sub_hexenc_sp   = enc_sp;
+    sub_hexdec      = dec;
+    sub_b64enc      = b64enc;
+    sub_b64dec      = b64dec;
+}
+
+static size_t sub_hexenc_resolve(char* dst, const uint8_t* src, size_t srcsz) {
+    sub_codec_select();
+    return sub_hexenc(dst, src, srcsz);
+}
+
+static size_t sub_hexenc_sp_resolve(char* dst, const uint8_t* src, size_t srcsz) {
+    sub_codec_select();
+    return sub_hexenc_sp(dst, src, srcsz);
+}
+
+static size_t sub_hexdec_resolve(uint8_t* dst, const char* src, size_t srcsz) {
+    sub_codec_select();
+    return sub_hexdec(dst, src, srcsz);
+}
+
+static size_t sub_b64enc_resolve(char* dst, const uint8_t* src, size_t srcsz) {
+    sub_codec_select();
+    return sub_b64enc(dst, src, srcsz);
+}
+
+static size_t sub_b64dec_resolve(uint8_t* dst, const char* src, size_t srcsz, size_t* bad) {
+    sub_codec_select();
+    return sub_b64dec(dst, src, srcsz, bad);
+}
+
+
+
+size_t codec_hexenc(char* dst, const uint8_t* src, size_t srcsz) {
+    if ((dst == NULL) || (src == NULL)) {
+        return 0;
+    }
+    return sub_hexenc(dst, src, srcsz);
+}
+
+
+size_t codec_hexenc_cols(char* dst, const uint8_t* src, size_t srcsz, size_t cols, char term) {
+    size_t i;
+    
+    if (cols == 0) {
+        return codec_hexenc(dst, src, srcsz);
+    }
+    if ((dst == NULL) || (src == NULL) || (srcsz == 0)) {
+        return 0;
+    }
+    
+    sub_hexenc_sp(dst, src, srcsz);
+    for (i=cols; i<srcsz; i+=cols) {
+        dst[3*i - 1] = '\n';
+    }
+    dst[3*srcsz - 1] = term;
+    
+    return 3*srcsz;
+}
+
+
+size_t codec_hexdec(uint8_t* dst, const char* src, size_t srcsz, size_t* bad) {
+    size_t chars;
+    
+    if ((dst == NULL) || (src == NULL)) {
+        chars = 0;
+    }
+    else {
+        chars = sub_hexdec(dst, src, srcsz);
+    }
+    if (bad != NULL) {
+        *bad = chars;
+    }
+    return chars / 2;
+}
+
+
+size_t codec_b64enc(char* dst, const uint8_t* src, size_t srcsz) {
+    if ((dst == NULL) || (src == NULL)) {
+        return 0;
+    }
+    return sub_b64enc(dst, src, srcsz);
+}
+
+
+size_t codec_b64dec(uint8_t* dst, const char* src, size_t srcsz, size_t* bad) {
+    size_t pos      = 0;
+    size_t bytes    = 0;
+    
+    if ((dst != NULL) && (src != NULL)) {
+        bytes = sub_b64dec(dst, src, srcsz, &pos);
+    }
+    if (bad != NULL) {
+        *bad = pos;
+    }
+    return bytes;
+}
@@ -16,6 +16,13 @@
 
 #include "crc_calc_block.h"
 
+#include <pthread.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#   define _CRC_CLMUL
+#   include <immintrin.h>
+#endif
+
 
 #   ifdef __BIG_ENDIAN__
 #       define UPPER    0
@@ -404,10 +411,44 @@ static const uint8_t modbus_CRCLo[] = {
 
 
 
-// CRC Calculation function
+/** CRC Kernels <BR>
+  * ========================================================================<BR>
+  * Each CRC has three kernels, and all of them give identical results:
+  * <LI> bytewise: the original table loop, one byte per iteration. </LI>
+  * <LI> slice-by-4 / slice-by-8: 4 or 8 bytes per iteration, using tables
+  *      derived from the ones above.  Slice-by-8 is used on 64 bit hosts. </LI>
+  * <LI> clmul: x86-64 only, folds 64 bytes per iteration with PCLMULQDQ down
+  *      to 8 bytes, which go through the slice-by-8 kernel. </LI>
+  *
+  * The kernel is chosen on first use via CPUID.  crc16 (MPipe) is MSB-first,
+  * Modbus is LSB-first (reflected), both with polynomial 0x8005.
+  */
+#define _SLICES     8
+#define _CLMUL_MIN  64
 
-uint16_t crc_calc_block(uint8_t* src, size_t size) {
-    uint16_t init = CRCBASE;
+static uint16_t crc16_slice[_SLICES][256];
+static uint16_t mbcrc_slice[_SLICES][256];
+static pthread_once_t crc_slice_once = PTHREAD_ONCE_INIT;
+
+static void sub_slice_init(void) {
+    int i, k;
+    
+    for (i=0; i<256; i++) {
+        crc16_slice[0][i] = crc16_table[i];
+        mbcrc_slice[0][i] = (uint16_t)((modbus_CRCLo[i] << 8) | modbus_CRCHi[i]);
+    }
+    for (k=1; k<_SLICES; k++) {
+        for (i=0; i<256; i++) {
+            uint16_t a = crc16_slice[k-1][i];
+            uint16_t b = mbcrc_slice[k-1][i];
+            crc16_slice[k][i] = (uint16_t)(a << 8) ^ crc16_slice[0][a >> 8];
+            mbcrc_slice[k][i] = (uint16_t)(b >> 8) ^ mbcrc_slice[0][b & 0xFF];
+        }
+    }
+}
+
+
+static uint16_t sub_crc16_bytewise(uint16_t init, const uint8_t* src, size_t size) {
     uint8_t index;
     
     while (size-- != 0) {
@@ -418,11 +459,30 @@ uint16_t crc_calc_block(uint8_t* src, size_t size) {
     return init;
 }
 
+static uint16_t sub_crc16_slice4(uint16_t crc, const uint8_t* src, size_t size) {
+    for (; size>=4; size-=4, src+=4) {
+        crc    ^= (uint16_t)((src[0] << 8) | src[1]);
+        crc     = crc16_slice[3][crc >> 8] ^ crc16_slice[2][crc & 0xFF]
+                ^ crc16_slice[1][src[2]]   ^ crc16_slice[0][src[3]];
+    }
+    return sub_crc16_bytewise(crc, src, size);
+}
 
+static uint16_t sub_crc16_slice8(uint16_t crc, const uint8_t* src, size_t size) {
+    for (; size>=8; size-=8, src+=8) {
+        crc    ^= (uint16_t)((src[0] << 8) | src[1]);
+        crc     = crc16_slice[7][crc >> 8] ^ crc16_slice[6][crc & 0xFF]
+                ^ crc16_slice[5][src[2]]   ^ crc16_slice[4][src[3]]
+                ^ crc16_slice[3][src[4]]   ^ crc16_slice[2][src[5]]
+                ^ crc16_slice[1][src[6]]   ^ crc16_slice[0][src[7]];
+    }
+    return sub_crc16_slice4(crc, src, size);
+}
 
-uint16_t mbcrc_calc_block(uint8_t *src, size_t size) {
-    uint16_t crchi = 0xFF;
-    uint16_t crclo = 0xFF;
+
+static uint16_t sub_mbcrc_bytewise(uint16_t crc, const uint8_t* src, size_t size) {
+    uint16_t crchi = crc >> 8;
+    uint16_t crclo = crc & 0xFF;
     int index;
 
 	while (size-- != 0) {
@@ -436,3 +496,236 @@ uint16_t mbcrc_calc_block(uint8_t *src, size_t size) {
     return (uint16_t)((crchi << 8) | crclo);
 }
 
+static uint16_t sub_mbcrc_slice4(uint16_t crc, const uint8_t* src, size_t size) {
+    for (; size>=4; size-=4, src+=4) {
+        crc    ^= (uint16_t)(src[0] | (src[1] << 8));
+        crc     = mbcrc_slice[3][crc & 0xFF] ^ mbcrc_slice[2][crc >> 8]
+                ^ mbcrc_slice[1][src[2]]     ^ mbcrc_slice[0][src[3]];
+    }
+    return sub_mbcrc_bytewise(crc, src, size);
+}
+
+static uint16_t sub_mbcrc_slice8(uint16_t crc, const uint8_t* src, size_t size) {
+    for (; size>=8; size-=8, src+=8) {
+        crc    ^= (uint16_t)(src[0] | (src[1] << 8));
+        crc     = mbcrc_slice[7][crc & 0xFF] ^ mbcrc_slice[6][crc >> 8]
+                ^ mbcrc_slice[5][src[2]]     ^ mbcrc_slice[4][src[3]]
+                ^ mbcrc_slice[3][src[4]]     ^ mbcrc_slice[2][src[5]]
+                ^ mbcrc_slice[1][src[6]]     ^ mbcrc_slice[0][src[7]];
+    }
+    return sub_mbcrc_slice4(crc, src, size);
+}
+
+
+
+#if defined(_CRC_CLMUL)
+/// Folding constants are x^n mod P, computed once in sub_clmul_init().  For
+/// the reflected (Modbus) kernel they are bit-reversed, and n is one less,
+/// because a carry-less multiply of reflected operands gains a factor of x.
+static uint64_t crc16_k[5];     // x^576, x^512, x^192, x^128, x^64
+static uint64_t mbcrc_k[5];
+
+static uint64_t sub_xpow_mod(int n) {
+    uint32_t r = 1;
+    while (n-- > 0) {
+        r <<= 1;
+        if (r & 0x10000) {
+            r ^= 0x18005;
+        }
+    }
+    return r;
+}
+
+static uint64_t sub_bitrev64(uint64_t v) {
+    uint64_t r = 0;
+    for (int i=0; i<64; i++, v>>=1) {
+        r = (r << 1) | (v & 1);
+    }
+    return r;
+}
+
+static void sub_clmul_init(void) {
+    static const int power[5] = { 576, 512, 192, 128, 64 };
+    
+    for (int i=0; i<5; i++) {
+        crc16_k[i] = sub_xpow_mod(power[i]);
+        mbcrc_k[i] = sub_bitrev64(sub_xpow_mod(power[i]-1));
+    }
+}
+
+
+__attribute__((target("pclmul,ssse3")))
+static uint16_t sub_crc16_clmul(uint16_t crc, const uint8_t* src, size_t size) {
+/// Register layout is natural: after the byte swap, bit 127 is the first bit
+/// of the block.  Folding replaces X*x^n with Xhi*(x^(n+64) mod P) +
+/// Xlo*(x^n mod P), which is congruent mod P and fits in 128 bits.
+    const __m128i bswap = _mm_setr_epi8(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0);
+    const __m128i k512  = _mm_set_epi64x((long long)crc16_k[0], (long long)crc16_k[1]);
+    const __m128i k128  = _mm_set_epi64x((long long)crc16_k[2], (long long)crc16_k[3]);
+    const __m128i k64   = _mm_set_epi64x(0, (long long)crc16_k[4]);
+    __m128i x0, x1, x2, x3;
+    uint8_t v[8];
+    uint64_t rem;
+    
+    if (size < _CLMUL_MIN) {
+        return sub_crc16_slice8(crc, src, size);
+    }
+    
+    // The CRC state goes into the first two bytes of the message
+    x0  = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[0]), bswap);
+    x1  = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[16]), bswap);
+    x2  = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[32]), bswap);
+    x3  = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[48]), bswap);
+    x0  = _mm_xor_si128(x0, _mm_set_epi64x((long long)((uint64_t)crc << 48), 0));
+    src += 64;
+    size -= 64;
+    
+#   define _FOLD(X, K, NEXT) \
+        _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(X, K, 0x11), _mm_clmulepi64_si128(X, K, 0x00)), NEXT)
+    
+    for (; size>=64; size-=64, src+=64) {
+        x0 = _FOLD(x0, k512, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[0]), bswap));
+        x1 = _FOLD(x1, k512, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[16]), bswap));
+        x2 = _FOLD(x2, k512, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[32]), bswap));
+        x3 = _FOLD(x3, k512, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&src[48]), bswap));
+    }
+    x0 = _FOLD(x0, k128, x1);
+    x0 = _FOLD(x0, k128, x2);
+    x0 = _FOLD(x0, k128, x3);
+    for (; size>=16; size-=16, src+=16) {
+        x0 = _FOLD(x0, k128, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), bswap));
+    }
+#   undef _FOLD
+    
+    // Reduce to 64 bits congruent mod P: twice, because the first product
+    // spills up to 15 bits over.
+    x0  = _mm_xor_si128(_mm_clmulepi64_si128(x0, k64, 0x01), _mm_move_epi64(x0));
+    x0  = _mm_xor_si128(_mm_clmulepi64_si128(x0, k64, 0x01), x0);
+    rem = (uint64_t)_mm_cvtsi128_si64(x0);
+    
+    // CRC of the remainder (from zero) then continues over the tail
+    for (int i=0; i<8; i++) {
+        v[i] = (uint8_t)(rem >> (56 - 8*i));
+    }
+    crc = sub_crc16_slice8(0, v, 8);
+    return sub_crc16_slice8(crc, src, size);
+}
+
+
+__attribute__((target("pclmul,sse2")))
+static uint16_t sub_mbcrc_clmul(uint16_t crc, const uint8_t* src, size_t size) {
+/// Register layout is reflected: bit 0 is the first bit of the block, the
+/// low lane holds the high-order half.  Otherwise as sub_crc16_clmul().
+    const __m128i k512  = _mm_set_epi64x((long long)mbcrc_k[1], (long long)mbcrc_k[0]);
+    const __m128i k128  = _mm_set_epi64x((long long)mbcrc_k[3], (long long)mbcrc_k[2]);
+    const __m128i k64   = _mm_set_epi64x(0, (long long)mbcrc_k[4]);
+    __m128i x0, x1, x2, x3;
+    uint8_t v[8];
+    uint64_t rem;
+    
+    if (size < _CLMUL_MIN) {
+        return sub_mbcrc_slice8(crc, src, size);
+    }
+    
+    x0  = _mm_loadu_si128((const __m128i*)&src[0]);
+    x1  = _mm_loadu_si128((const __m128i*)&src[16]);
+    x2  = _mm_loadu_si128((const __m128i*)&src[32]);
+    x3  = _mm_loadu_si128((const __m128i*)&src[48]);
+    x0  = _mm_xor_si128(x0, _mm_cvtsi32_si128(crc));
+    src += 64;
+    size -= 64;
+    
+#   define _FOLD(X, K, NEXT) \
+        _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(X, K, 0x00), _mm_clmulepi64_si128(X, K, 0x11)), NEXT)
+    
+    for (; size>=64; size-=64, src+=64) {
+        x0 = _FOLD(x0, k512, _mm_loadu_si128((const __m128i*)&src[0]));
+        x1 = _FOLD(x1, k512, _mm_loadu_si128((const __m128i*)&src[16]));
+        x2 = _FOLD(x2, k512, _mm_loadu_si128((const __m128i*)&src[32]));
+        x3 = _FOLD(x3, k512, _mm_loadu_si128((const __m128i*)&src[48]));
+    }
+    x0 = _FOLD(x0, k128, x1);
+    x0 = _FOLD(x0, k128, x2);
+    x0 = _FOLD(x0, k128, x3);
+    for (; size>=16; size-=16, src+=16) {
+        x0 = _FOLD(x0, k128, _mm_loadu_si128((const __m128i*)src));
+    }
+#   undef _FOLD
+    
+    x0  = _mm_xor_si128(_mm_clmulepi64_si128(x0, k64, 0x00), _mm_unpackhi_epi64(_mm_setzero_si128(), x0));
+    x0  = _mm_xor_si128(_mm_clmulepi64_si128(x0, k64, 0x00), _mm_unpackhi_epi64(_mm_setzero_si128(), x0));
+    rem = (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(x0, x0));
+    
+    for (int i=0; i<8; i++) {
+        v[i] = (uint8_t)(rem >> (8*i));
+    }
+    crc = sub_mbcrc_slice8(0, v, 8);
+    return sub_mbcrc_slice8(crc, src, size);
+}
+#endif
+
+
+
+static uint16_t sub_crc16_resolve(uint16_t crc, const uint8_t* src, size_t size);
+static uint16_t sub_mbcrc_resolve(uint16_t crc, const uint8_t* src, size_t size);
+static uint16_t (*sub_crc16)(uint16_t, const uint8_t*, size_t) = &sub_crc16_resolve;
+static uint16_t (*sub_mbcrc)(uint16_t, const uint8_t*, size_t) = &sub_mbcrc_resolve;
+
+static void sub_kernel_init(void) {
+/// Runs once, on first use of either CRC.  The kernels are published only
+/// after their tables are complete.
+    uint16_t (*crc16)(uint16_t, const uint8_t*, size_t);
+    uint16_t (*mbcrc)(uint16_t, const uint8_t*, size_t);
+    
+    sub_slice_init();
+    
+#   if (UINTPTR_MAX > 0xFFFFFFFF)
+    crc16 = &sub_crc16_slice8;
+    mbcrc = &sub_mbcrc_slice8;
+#   else
+    crc16 = &sub_crc16_slice4;
+    mbcrc = &sub_mbcrc_slice4;
+#   endif
+    
+#   if defined(_CRC_CLMUL)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3")) {
+        sub_clmul_init();
+        crc16 = &sub_crc16_clmul;
+        mbcrc = &sub_mbcrc_clmul;
+    }
+#   endif
+    
+    __atomic_store_n(&sub_crc16, crc16, __ATOMIC_RELEASE);
+    __atomic_store_n(&sub_mbcrc, mbcrc, __ATOMIC_RELEASE);
+}
+
+static uint16_t sub_crc16_resolve(uint16_t crc, const uint8_t* src, size_t size) {
+    pthread_once(&crc_slice_once, &sub_kernel_init);
+    return sub_crc16(crc, src, size);
+}
+
+static uint16_t sub_mbcrc_resolve(uint16_t crc, const uint8_t* src, size_t size) {
+    pthread_once(&crc_slice_once, &sub_kernel_init);
+    return sub_mbcrc(crc, src, size);
+}
+
+
+
+
+// CRC Calculation function
+
+uint16_t crc_calc_partial(uint16_t init, uint8_t* src, size_t size) {
+    return sub_crc16(init, src, size);
+}
+
+
+uint16_t crc_calc_block(uint8_t* src, size_t size) {
+    return sub_crc16(CRCBASE, src, size);
+}
+
+
+
+uint16_t mbcrc_calc_block(uint8_t *src, size_t size) {
+    return sub_mbcrc(0xFFFF, src, size);
+}
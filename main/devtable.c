@@ -38,6 +38,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <time.h>
 
 ///@note devtab_item_t is the same as devtab_endpoint_t, for the time being.
 //typedef struct {
@@ -55,6 +56,13 @@ typedef struct {
     devtab_item_t*  cell;
 } devtab_vid_t;
 
+/// A request sent to a device that has no bound interface.  The response
+/// tells which interface the device is on.
+typedef struct {
+    devtab_item_t*  item;
+    uint32_t        sequence;
+} devtab_pending_t;
+
 typedef struct {
     devtab_vid_t*   vdex;
     devtab_item_t** cell;
@@ -62,6 +70,8 @@ typedef struct {
     size_t          size;
     size_t          alloc;
     pthread_mutex_t access_mutex;
+    devtab_pending_t pending[OTTER_PARAM_ROUTEPEND];
+    size_t          pending_head;
 } devtab_t;
 
 
@@ -102,6 +112,8 @@ int devtab_init(devtab_handle_t* new_handle) {
     newtab->size    = 0;
     newtab->vids    = 0;
     newtab->alloc   = 0;
+    newtab->pending_head = 0;
+    memset(newtab->pending, 0, sizeof(newtab->pending));
     
     *new_handle     = newtab;
     
@@ -167,13 +179,14 @@ int devtab_list(devtab_handle_t handle, char* dst, size_t dstmax) {
             
             cmdutils_uint8_to_hexstr(uidstr, (uint8_t*)&table->cell[i]->uid, 8);
 
-            dst += sprintf(dst, "%i. %s [vid:%i] [root:%s] [user:%s] [intf:%s]\n",
+            dst += sprintf(dst, "%i. %s [vid:%i] [root:%s] [user:%s] [intf:%s] [route:%s]\n",
                         i+1,
                         uidstr,
                         table->cell[i]->vid,
                         (table->cell[i]->rootctx == NULL) ? no : yes,
                         (table->cell[i]->userctx == NULL) ? no : yes,
-                        mpipe_file_resolve(table->cell[i]->intf)
+                        mpipe_file_resolve(table->cell[i]->intf),
+                        mpipe_file_resolve(table->cell[i]->route)
                     );
         }
         else {
@@ -285,6 +298,11 @@ int devtab_remove(devtab_handle_t handle, uint64_t uid) {
     
     item = sub_searchop_uid(table, uid, -1);
     if (item != NULL) {
+        for (int i=0; i<OTTER_PARAM_ROUTEPEND; i++) {
+            if (table->pending[i].item == item) {
+                table->pending[i].item = NULL;
+            }
+        }
         vid = item->vid;
         if (item->rootctx != NULL) free(item->rootctx);
         if (item->userctx != NULL) free(item->userctx);
@@ -467,6 +485,116 @@ void* devtab_get_userctx(devtab_handle_t handle, devtab_node_t node) {
 
 
 
+static time_t sub_route_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+
+void* devtab_get_route(devtab_handle_t handle, devtab_node_t node) {
+    devtab_t* table = handle;
+    devtab_item_t* item = node;
+    void* intf = NULL;
+    
+    if ((table == NULL) || (item == NULL)) {
+        return NULL;
+    }
+    if (pthread_mutex_lock(&table->access_mutex) != 0) {
+        return NULL;
+    }
+    
+    intf = item->intf;
+    if ((intf == NULL) && (item->route != NULL)) {
+        if ((sub_route_now() - item->route_tstamp) <= OTTER_PARAM_ROUTETTL) {
+            intf = item->route;
+        }
+        else {
+            item->route = NULL;
+        }
+    }
+    
+    pthread_mutex_unlock(&table->access_mutex);
+    return intf;
+}
+
+
+int devtab_route_set(devtab_handle_t handle, devtab_node_t node, void* intfp) {
+    devtab_t* table = handle;
+    devtab_item_t* item = node;
+    
+    if ((table == NULL) || (item == NULL)) {
+        return -1;
+    }
+    if (pthread_mutex_lock(&table->access_mutex) != 0) {
+        return -2;
+    }
+    
+    item->route         = intfp;
+    item->route_tstamp  = sub_route_now();
+    
+    pthread_mutex_unlock(&table->access_mutex);
+    return 0;
+}
+
+
+int devtab_route_expect(devtab_handle_t handle, devtab_node_t node, uint32_t sequence) {
+    devtab_t* table = handle;
+    devtab_item_t* item = node;
+    int rc = 1;
+    
+    if ((table == NULL) || (item == NULL)) {
+        return -1;
+    }
+    if (pthread_mutex_lock(&table->access_mutex) != 0) {
+        return -2;
+    }
+    
+    // The oldest pending request gets overwritten
+    if (item->intf == NULL) {
+        devtab_pending_t* pend = &table->pending[table->pending_head % OTTER_PARAM_ROUTEPEND];
+        pend->item          = item;
+        pend->sequence      = sequence;
+        table->pending_head++;
+        rc = 0;
+    }
+    
+    pthread_mutex_unlock(&table->access_mutex);
+    return rc;
+}
+
+
+devtab_node_t devtab_route_learn(devtab_handle_t handle, void* intfp, uint32_t sequence, uint32_t seqmask) {
+    devtab_t* table = handle;
+    devtab_item_t* item = NULL;
+    
+    if ((table == NULL) || (intfp == NULL)) {
+        return NULL;
+    }
+    if (pthread_mutex_lock(&table->access_mutex) != 0) {
+        return NULL;
+    }
+    
+    // Newest request first, since with a sequence mask an old request can
+    // alias a new one
+    for (size_t i=1; i<=OTTER_PARAM_ROUTEPEND; i++) {
+        devtab_pending_t* pend = &table->pending[(table->pending_head + OTTER_PARAM_ROUTEPEND - i) % OTTER_PARAM_ROUTEPEND];
+        if ((pend->item != NULL) && (((pend->sequence ^ sequence) & seqmask) == 0)) {
+            item                = pend->item;
+            item->route         = intfp;
+            item->route_tstamp  = sub_route_now();
+            pend->item          = NULL;
+            break;
+        }
+    }
+    
+    pthread_mutex_unlock(&table->access_mutex);
+    return (devtab_node_t)item;
+}
+
+
+
+
 uint64_t devtab_lookup_uid(devtab_handle_t handle, uint16_t vid) {
     devtab_node_t node;
     uint64_t uid = 0;
@@ -555,6 +683,8 @@ static devtab_item_t* sub_searchop_uid(devtab_t* table, uint64_t uid, int operat
             output->intf    = NULL;
             output->rootctx = NULL;
             output->userctx = NULL;
+            output->route   = NULL;
+            output->route_tstamp = 0;
             head[cci]       = output;
             table->size++;
         }
@@ -20,6 +20,7 @@
 #include "cliopt.h"         // to be part of dterm via environment variables
 #include "cmdhistory.h"     // to be part of dterm
 #include "cmd_api.h"        // to be part of dterm
+#include "codec.h"
 #include "dterm.h"
 #include "otter_app.h"      // must be external to dterm
 #include "../test/test.h"
@@ -205,41 +206,24 @@ static size_t sub_str_mark(char* str, size_t max) {
     return (str - s1);
 }
 
-static int sub_hexwrite(int fd, const uint8_t byte) {
-    static const char convert[] = "0123456789ABCDEF";
-    char dst[2];
-    dst[0]  = convert[byte >> 4];
-    dst[1]  = convert[byte & 0x0f];
-    write(fd, dst, 2);
-    return 2;
-}
-
 static int sub_hexswrite(char* dst, const uint8_t byte) {
-    static const char convert[] = "0123456789ABCDEF";
-    *dst++ = convert[byte >> 4];
-    *dst++ = convert[byte & 0x0f];
-    return 2;
+    return (int)codec_hexenc(dst, &byte, 1);
 }
 
-static int sub_hexstream(int fd, const uint8_t* src, size_t src_bytes) {
-    int bytesout = 0;
-    
-    while (src_bytes != 0) {
-        src_bytes--;
-        bytesout += sub_hexwrite(fd, *src++);
+static int sub_hexsnstream(char* dst, size_t lim, uint8_t* src, size_t srcsz) {
+    lim >>= 1;
+    if (srcsz > lim) {
+        srcsz = lim;
     }
-    
-    return bytesout;
+    return (int)codec_hexenc(dst, src, srcsz);
 }
 
-static int sub_hexsnstream(char* dst, size_t lim, uint8_t* src, size_t srcsz) {
-    char* start = dst;
-    lim >>= 1;
-    
-    while ((srcsz--) && (lim--)) {
-        dst += sub_hexswrite(dst, *src++);
+static int sub_b64snstream(char* dst, size_t lim, uint8_t* src, size_t srcsz) {
+    lim = 3 * (lim / 4);
+    if (srcsz > lim) {
+        srcsz = lim;
     }
-    return (int)(dst - start);
+    return (int)codec_b64enc(dst, src, srcsz);
 }
 
 
@@ -287,6 +271,7 @@ int dterm_init(dterm_handle_t* dth, void* ext_data, const char* logfile, INTF_Ty
     
     dth->intf = NULL;
     dth->iso_mutex = NULL;
+    dth->out_mutex = NULL;
     dth->logfile_path = logfile;
     
     talloc_disable_null_tracking();
@@ -330,6 +315,16 @@ int dterm_init(dterm_handle_t* dth, void* ext_data, const char* logfile, INTF_Ty
         goto dterm_init_TERM;
     }
     
+    dth->out_mutex = malloc(sizeof(pthread_mutex_t));
+    if (dth->out_mutex == NULL) {
+        rc = -8;
+        goto dterm_init_TERM;
+    }
+    if (pthread_mutex_init(dth->out_mutex, NULL) != 0 ) {
+        rc = -9;
+        goto dterm_init_TERM;
+    }
+    
     /// If sockets are being used, SIGPIPE can cause trouble that we don't
     /// want, and it is safe to ignore.
     if (dth->intf->type == INTF_socket) {
@@ -342,6 +337,7 @@ int dterm_init(dterm_handle_t* dth, void* ext_data, const char* logfile, INTF_Ty
     clithread_deinit(dth->clithread);
     talloc_free(dth->tctx);
     talloc_free(dth->pctx);
+    free(dth->out_mutex);
     free(dth->iso_mutex);
     free(dth->intf);
     
@@ -366,6 +362,10 @@ void dterm_deinit(dterm_handle_t* dth) {
         pthread_mutex_destroy(dth->iso_mutex);
         free(dth->iso_mutex);
     }
+    if (dth->out_mutex != NULL) {
+        pthread_mutex_destroy(dth->out_mutex);
+        free(dth->out_mutex);
+    }
     
     talloc_free(dth->tctx);
     talloc_free(dth->pctx);
@@ -489,9 +489,11 @@ int dterm_squelch(dterm_handle_t* dth) {
     int fd_out = -1;
     
     if (dth != NULL) {
+        pthread_mutex_lock(dth->out_mutex);
         fd_out          = dth->fd.out;
         dth->fd.squelch = dth->fd.out;
         dth->fd.out     = -1;
+        pthread_mutex_unlock(dth->out_mutex);
     }
 
     return fd_out;
@@ -501,10 +503,12 @@ int dterm_squelch(dterm_handle_t* dth) {
 
 void dterm_unsquelch(dterm_handle_t* dth) {
     if (dth != NULL) {
+        pthread_mutex_lock(dth->out_mutex);
         if (dth->fd.out < 0) {
             dth->fd.out     = dth->fd.squelch;
             dth->fd.squelch = -1;
         }
+        pthread_mutex_unlock(dth->out_mutex);
     }
 }
 
@@ -586,22 +590,32 @@ int dterm_send_log(dterm_handle_t* dth, const char* logmsg, size_t loglen) {
 }
 
 
+///@note Command output is written under out_mutex, like the parser output,
+///      so a response can't be interleaved with a received packet.
 int dterm_send_cmdmsg(dterm_handle_t* dth, const char* cmdname, const char* msg) {
+    int rc = -1;
+    
     if (dth != NULL) {
+        pthread_mutex_lock(dth->out_mutex);
         if (dth->fd.out >= 0) {
-            return dterm_force_cmdmsg(dth->fd.out, cmdname, msg);
+            rc = dterm_force_cmdmsg(dth->fd.out, cmdname, msg);
         }
+        pthread_mutex_unlock(dth->out_mutex);
     }
-    return -1;
+    return rc;
 }
 
 int dterm_send_error(dterm_handle_t* dth, const char* cmdname, int errcode, uint32_t sid, const char* desc) {
+    int rc = -1;
+    
     if (dth != NULL) {
+        pthread_mutex_lock(dth->out_mutex);
         if (dth->fd.out >= 0) {
-            return dterm_force_error(dth->fd.out, cmdname, errcode, sid, desc);
+            rc = dterm_force_error(dth->fd.out, cmdname, errcode, sid, desc);
         }
+        pthread_mutex_unlock(dth->out_mutex);
     }
-    return -1;
+    return rc;
 }
 
 int dterm_send_txstat(dterm_handle_t* dth, DFMT_Type dfmt, void* txdata, size_t txsize, uint64_t txaddr, uint32_t sid, time_t tstamp) {
@@ -616,6 +630,8 @@ int dterm_send_rxstat(dterm_handle_t* dth, DFMT_Type dfmt, void* rxdata, size_t
 ///@todo clithread_publish is not safe when the file descriptor is lost before
 ///      the response arrives.  Need to implement a way to indicate when a
 ///      client drops in order to skip write and update clithread-table
+///@note This is called by the parser threads without iso_mutex, so it must
+///      stay reentrant.  Only the write is serialized, by out_mutex.
 int dterm_publish_rxstat(dterm_handle_t* dth, DFMT_Type dfmt, void* rxdata, size_t rxsize, bool broadcast, uint64_t rxaddr, uint32_t sid, time_t tstamp, int crcqual) {
     char output[1024];
     int datasize = 0;
@@ -623,12 +639,14 @@ int dterm_publish_rxstat(dterm_handle_t* dth, DFMT_Type dfmt, void* rxdata, size
     if (dth != NULL) {
         datasize = sub_rxstat(output, 1024, dfmt, rxdata, rxsize, rxaddr, sid, tstamp, crcqual);
         if (datasize > 0) {
+            pthread_mutex_lock(dth->out_mutex);
             if (dth->intf->type == INTF_socket) {
                 clithread_publish(dth->clithread, broadcast, sid, (uint8_t*)output, datasize);
             }
             else if (dth->fd.out >= 0) {
                 write(dth->fd.out, output, datasize);
             }
+            pthread_mutex_unlock(dth->out_mutex);
         }
     }
     return datasize;
@@ -641,6 +659,7 @@ static int sub_rxstat(  char* dst, int dstlimit, DFMT_Type dfmt,
                         uint64_t rxaddr, uint32_t sid, time_t tstamp, int crcqual) {
     int bytesout;
     int max = dstlimit;
+    char timebuf[28];
     
     // exit if parameters are incorrect
     if (dstlimit <= 0) {
@@ -678,7 +697,8 @@ static int sub_rxstat(  char* dst, int dstlimit, DFMT_Type dfmt,
             bytesout += 2;
         } break;
         
-        case FORMAT_JsonHex: {
+        case FORMAT_JsonHex:
+        case FORMAT_JsonB64: {
             bytesout = snprintf(dst, dstlimit,
                                 "{\"type\":\"rxstat\", "\
                                 "\"data\":{\"sid\":%u, \"addr\":\"%llx\", \"qual\":%i, \"time\":%li, \"frame\":\"",
@@ -688,7 +708,9 @@ static int sub_rxstat(  char* dst, int dstlimit, DFMT_Type dfmt,
             if (dstlimit <= 0) break;
             
             if (dfmt == DFMT_Binary) {
-                int a = sub_hexsnstream(dst, dstlimit, rxdata, rxsize);
+                int a = (cliopt_getformat() == FORMAT_JsonB64) ?
+                        sub_b64snstream(dst, dstlimit, rxdata, rxsize) :
+                        sub_hexsnstream(dst, dstlimit, rxdata, rxsize);
                 bytesout += a;
                 dstlimit -= a;
                 dst      += a;
@@ -717,7 +739,7 @@ static int sub_rxstat(  char* dst, int dstlimit, DFMT_Type dfmt,
             if (cliopt_isverbose()) {
                 bytesout = snprintf(dst, dstlimit,
                                     _E_GRN"RX.%u: from %llx at %s, %s"_E_NRM"\n",
-                                    sid, rxaddr, fmt_time(&tstamp, NULL), fmt_crc(crcqual, NULL));
+                                    sid, rxaddr, fmt_time(&tstamp, timebuf), fmt_crc(crcqual, NULL));
             }
             else {
                 const char* valid_sym = _E_GRN"v";
@@ -785,7 +807,8 @@ int dterm_force_cmdmsg(int fd_out, const char* cmdname, const char* msg) {
         } break;
 
         case FORMAT_Json:
-        case FORMAT_JsonHex: {
+        case FORMAT_JsonHex:
+        case FORMAT_JsonB64: {
             const char* linefront;
             const char* lineback;
             const char* lineend;
@@ -900,7 +923,8 @@ int dterm_force_error(int fd_out, const char* cmdname, int errcode, uint32_t sid
         } break;
 
         case FORMAT_Json:
-        case FORMAT_JsonHex: {
+        case FORMAT_JsonHex:
+        case FORMAT_JsonB64: {
             a       = snprintf(dst, lim, "{\"type\":\"ack\", \"data\":{\"cmd\":\"%s\", \"err\":%i", cmdname, errcode);
             dst    += a;
             lim    -= a;
@@ -1372,8 +1396,10 @@ int dterm_cmdfile(dterm_handle_t* dth, const char* filename) {
     pthread_mutex_lock(dth->iso_mutex);
     local.in    = STDIN_FILENO;
     local.out   = STDOUT_FILENO;
+    pthread_mutex_lock(dth->out_mutex);
     saved       = dth->fd;
     dth->fd     = local;
+    pthread_mutex_unlock(dth->out_mutex);
 
     // Run the command on each line
     filecursor = filebuf;
@@ -1393,7 +1419,9 @@ int dterm_cmdfile(dterm_handle_t* dth, const char* filename) {
         dth->tctx   = talloc_pooled_object(NULL, void, est_poolobj, poolsize);
         
         // Echo input line to dterm
+        pthread_mutex_lock(dth->out_mutex);
         dprintf(dth->fd.out, _E_MAG"%s"_E_NRM"%s\n", prompt_root, filecursor);
+        pthread_mutex_unlock(dth->out_mutex);
         
         // Process the line-input command.  Exit on proc error
         sub_proc_lineinput(dth, &cmdrc, filecursor, linelen);
@@ -1404,7 +1432,9 @@ int dterm_cmdfile(dterm_handle_t* dth, const char* filename) {
         
         // Exit the command sequence on first detection of error.
         if (cmdrc < 0) {
+            pthread_mutex_lock(dth->out_mutex);
             dprintf(dth->fd.out, _E_RED"ERR: "_E_NRM"Command Returned %i: stopping.\n\n", cmdrc);
+            pthread_mutex_unlock(dth->out_mutex);
             break;
         }
         
@@ -1413,7 +1443,9 @@ int dterm_cmdfile(dterm_handle_t* dth, const char* filename) {
         filecursor += (linelen + 1);
     }
     
+    pthread_mutex_lock(dth->out_mutex);
     dth->fd = saved;
+    pthread_mutex_unlock(dth->out_mutex);
     pthread_mutex_unlock(dth->iso_mutex);
 
     dterm_cmdfile_END:
@@ -1474,6 +1506,7 @@ void* dterm_prompter(void* args) {
     char                cmdname[256];
     char                c           = 0;
     ssize_t             keychars    = 0;
+    bool                out_held    = false;
     dterm_handle_t*     dth         = args;
     
     ///@todo this needs to be abstracted to not require cmdtab or endpoint.usertype
@@ -1541,10 +1574,13 @@ void* dterm_prompter(void* args) {
             continue;
         }
         
-        // This mutex protects the terminal output from being written-to by
-        // this thread and mpipe_parser() at the same time.
+        // iso_mutex keeps commands from other sources out while the prompt
+        // is up.  out_mutex protects the terminal output from being written
+        // to by this thread and the parser at the same time.
         if (dth->intf->state == prompt_off) {
             pthread_mutex_lock(dth->iso_mutex);
+            pthread_mutex_lock(dth->out_mutex);
+            out_held = true;
         }
         
         // These are error conditions
@@ -1582,9 +1618,9 @@ void* dterm_prompter(void* args) {
         }
         
         // These are commands that cause input into the prompt.
-        // Note that the mutex is only released after ENTER is used, which has
+        // Note that out_mutex is only released after ENTER is used, which has
         // the effect of blocking printout of received messages while the 
-        // prompt is up
+        // prompt is up.  It is not held while the command runs.
         else {
             int cmdlen;
             char* cmdstr;
@@ -1622,6 +1658,8 @@ void* dterm_prompter(void* args) {
                     size_t poolsize;
                     size_t est_poolobj;
                     sub_putc(&dth->fd, '\n');
+                    pthread_mutex_unlock(dth->out_mutex);
+                    out_held = false;
 
                     if (!ch_contains(dth->ch, dth->intf->linebuf)) {
                         ch_add(dth->ch, dth->intf->linebuf);
@@ -1704,6 +1742,10 @@ void* dterm_prompter(void* args) {
         // Unlock Mutex
         if (dth->intf->state != prompt_on) {
             dth->intf->state = prompt_off;
+            if (out_held) {
+                pthread_mutex_unlock(dth->out_mutex);
+                out_held = false;
+            }
             pthread_mutex_unlock(dth->iso_mutex);
         }
         
@@ -9,8 +9,10 @@
 #include "formatters.h"
 
 #include "cliopt.h"
+#include "codec.h"
 #include "otter_cfg.h"
 
+#include <ctype.h>
 #include <string.h>
 #include <time.h>
 
@@ -103,23 +105,27 @@ static char* sub_findbreak(char* msg, size_t limit) {
 
 
 static int sub_hexdump_raw(uint8_t* dst, size_t* dst_accum, uint8_t** src, size_t srcsz) {
-    static const char convert[] = "0123456789ABCDEF";
-    char* dcurs;
-    uint8_t* scurs;
     int rc;
     
-    scurs = *src;
-    dcurs = (char*)dst;
+    rc      = (int)codec_hexenc((char*)dst, *src, srcsz);
+    dst[rc] = 0;        // trailing null
+    *src   += srcsz;
     
-    while (srcsz-- != 0) {
-        *dcurs++ = convert[(*scurs >> 4)];
-        *dcurs++ = convert[(*scurs & 0x0f)];
-        scurs++;
+    if (dst_accum != NULL) {
+        *dst_accum += rc;
     }
-    *dcurs  = 0;        // trailing null
-    *src    = scurs;
     
-    rc = (int)(dcurs-(char*)dst);
+    return rc;
+}
+
+
+static int sub_b64dump_raw(uint8_t* dst, size_t* dst_accum, uint8_t** src, size_t srcsz) {
+    int rc;
+    
+    rc      = (int)codec_b64enc((char*)dst, *src, srcsz);
+    dst[rc] = 0;        // trailing null
+    *src   += srcsz;
+    
     if (dst_accum != NULL) {
         *dst_accum += rc;
     }
@@ -128,39 +134,77 @@ static int sub_hexdump_raw(uint8_t* dst, size_t* dst_accum, uint8_t** src, size_
 }
 
 
-// Any characters that are not valid hex are ignored
-static int sub_passhex_loop(uint8_t* dst, uint8_t** src, size_t srcsz, size_t cols) {
-    int i, j;
-    char* scurs = (char*)*src;
-    char* dcurs = (char*)dst;
+static char* sub_passhex_put(char* dcurs, const uint8_t* bin, size_t binsz, size_t cols, size_t* col, bool final) {
+/// Writes binsz bytes as hex, continuing the line from *col bytes in.  The
+/// last byte of the output gets a newline when final is set.
+    size_t k;
+    char term;
+    
+    if (cols == 0) {
+        return dcurs + codec_hexenc(dcurs, bin, binsz);
+    }
+    while (binsz != 0) {
+        k       = cols - *col;
+        k       = (binsz < k) ? binsz : k;
+        *col    = (*col + k) % cols;
+        binsz  -= k;
+        term    = ((*col == 0) || (final && (binsz == 0))) ? '\n' : ' ';
+        dcurs  += codec_hexenc_cols(dcurs, bin, k, cols, term);
+        bin    += k;
+    }
+    return dcurs;
+}
 
-    i = (int)cols;
-    j = 2;
-    while (srcsz-- != 0) {
-        char x = *scurs++;
+
+// Any characters that are not valid hex are ignored.  Runs of valid hex are
+// decoded into a block and encoded back out of it, which validates them and
+// makes them uppercase at vector speed.  Only the invalid characters, and a
+// digit left unpaired in front of one, are handled individually.
+static int sub_passhex_loop(uint8_t* dst, uint8_t** src, size_t srcsz, size_t cols) {
+    uint8_t block[256];
+    size_t blocksz  = 0;
+    size_t col      = 0;
+    char odd        = 0;
+    char* scurs     = (char*)*src;
+    char* send      = scurs + srcsz;
+    char* dcurs     = (char*)dst;
+    
+    while (scurs < send) {
+        size_t lim, bad, bytes;
         
-        if ((x >= 'a') && (x <= 'f')) {
-            x -= ('a'-'A');
+        if (blocksz == sizeof(block)) {
+            dcurs   = sub_passhex_put(dcurs, block, blocksz, cols, &col, false);
+            blocksz = 0;
         }
         
-        if (((x >= '0') && (x <= '9')) || ((x >= 'A') && (x <= 'F'))) {
-            *dcurs++ = x;
-            
-            if (--j <= 0) {
-                j = 2;
-                if (cols != 0){
-                    i--;
-                    if ((i == 0) || (srcsz == 0)) {
-                        i = (int)cols;
-                        *dcurs++ = '\n';
-                    }
-                    else {
-                        *dcurs++ = ' ';
-                    }
-                }
+        // A digit left over from the last run is paired with the next valid
+        // one, skipping any invalid characters in between.
+        if (odd != 0) {
+            char pair[2] = { odd, *scurs++ };
+            if (codec_hexdec(&block[blocksz], pair, 2, NULL) != 0) {
+                blocksz++;
+                odd = 0;
+            }
+        }
+        else {
+            lim     = 2 * (sizeof(block) - blocksz);
+            lim     = ((size_t)(send - scurs) < lim) ? (size_t)(send - scurs) : lim;
+            bytes   = codec_hexdec(&block[blocksz], scurs, lim, &bad);
+            blocksz+= bytes;
+            scurs  += 2*bytes;
+            if (bad > 2*bytes) {
+                odd = *scurs++;
+            }
+            if (bad < lim) {
+                scurs++;
             }
         }
     }
+    
+    dcurs = sub_passhex_put(dcurs, block, blocksz, cols, &col, (odd == 0));
+    if (odd != 0) {
+        *dcurs++ = (char)toupper(odd);
+    }
     *dcurs  = 0;
     *src    = (uint8_t*)scurs;
     
@@ -236,6 +280,7 @@ static int sub_passhex(FORMAT_Type fmt, uint8_t* dst, size_t* dst_accum, uint8_t
     // to interactive console.
     switch (fmt) {
         case FORMAT_JsonHex:
+        case FORMAT_JsonB64:
         case FORMAT_Hex:
             cols = 0;
             strterm = NULL;
@@ -262,7 +307,7 @@ static int sub_passhex(FORMAT_Type fmt, uint8_t* dst, size_t* dst_accum, uint8_t
     }
     
     // Any characters that are not valid hex are ignored
-    dcurs += sub_passhex_loop(dst, src, srcsz, cols);
+    dcurs += sub_passhex_loop((uint8_t*)dcurs, src, srcsz, cols);
     
     // Apply terminator string
     if (strterm != NULL) {
@@ -280,10 +325,8 @@ static int sub_passhex(FORMAT_Type fmt, uint8_t* dst, size_t* dst_accum, uint8_t
 
 
 static int sub_printhex(FORMAT_Type fmt, uint8_t* dst, size_t* dst_accum, uint8_t** src, size_t srcsz, size_t cols) {
-    static const char convert[] = "0123456789ABCDEF";
     static const char* term_json = "\"";
     static const char* term_bintex = "]";
-    int i;
     int rc;
     char* dcurs;
     uint8_t* scurs;
@@ -296,6 +339,7 @@ static int sub_printhex(FORMAT_Type fmt, uint8_t* dst, size_t* dst_accum, uint8_
     // to interactive console.
     switch (fmt) {
         case FORMAT_JsonHex:
+        case FORMAT_JsonB64:
         case FORMAT_Hex:
             cols = 0;
             strterm = NULL;
@@ -321,27 +365,17 @@ static int sub_printhex(FORMAT_Type fmt, uint8_t* dst, size_t* dst_accum, uint8_
             break;
     }
     
-    // Convert input to hex encoding.
+    // Convert input to hex encoding, or base64 in JsonB64 format.
     // If cols==0, it will be as a contiguous string, no whitespace.
     // If cols!=0, it will have whitespace separating bytes and newlines after
-    // cols number of bytes.
-    i = (int)cols;
-    while (srcsz-- != 0) {
-        *dcurs++ = convert[*scurs >> 4];
-        *dcurs++ = convert[*scurs & 0x0f];
-        scurs++;
-        
-        if (cols != 0) {
-            i--;
-            if ((i == 0) || (srcsz == 0)) {
-                i = (int)cols;
-                *dcurs++ = '\n';
-            }
-            else {
-                *dcurs++ = ' ';
-            }
-        }
+    // cols number of bytes, and after the last byte.
+    if (fmt == FORMAT_JsonB64) {
+        dcurs  += codec_b64enc(dcurs, scurs, srcsz);
     }
+    else {
+        dcurs  += codec_hexenc_cols(dcurs, scurs, srcsz, cols, '\n');
+    }
+    scurs  += srcsz;
     *dcurs  = 0;
     *src    = scurs;
     
@@ -368,6 +402,7 @@ static int sub_printtext(FORMAT_Type fmt, uint8_t* dst, size_t* dst_accum, uint8
     // to interactive console.
     switch (fmt) {
         case FORMAT_JsonHex:
+        case FORMAT_JsonB64:
         case FORMAT_Hex:
             return sub_printhex(fmt, dst, dst_accum, src, srcsz, cols/3);
             
@@ -767,6 +802,10 @@ int fmt_fprintalp(uint8_t* dst, size_t* dst_accum, uint8_t** src, size_t srcsz)
         case FORMAT_Hex:
             rc = sub_hexdump_raw(dst, dst_accum, src, srcsz);
             goto fmt_fprintalp_END;
+            
+        case FORMAT_JsonB64:
+            rc = sub_b64dump_raw(dst, dst_accum, src, srcsz);
+            goto fmt_fprintalp_END;
     }
     
 //fprintf(stderr, "flags=%02x length=%02x cmd=%02x id=%02x\n", flags, length, cmd, id);
@@ -918,15 +957,17 @@ int fmt_hexdump_raw(uint8_t* dst, size_t* dst_accum, uint8_t** src, size_t srcsz
 }
 
 
-const char* fmt_hexdump_header(uint8_t* data) {
-    static uint8_t hexdump_buf[32*3 + 1];
+const char* fmt_hexdump_header(uint8_t* data, char* buf) {
+/// buf must have room for 13 chars.  It's the caller's, so this is reentrant.
     
     /// @todo header inspection to determine length.
     ///       this entails looking at CONTROL field to see encryption type
     
-    fmt_hexdump_raw(hexdump_buf, NULL, &data, 6);
+    if (fmt_hexdump_raw((uint8_t*)buf, NULL, &data, 6) < 0) {
+        return NULL;
+    }
     
-    return (const char*)hexdump_buf;
+    return buf;
 }
 
 
@@ -949,13 +990,15 @@ const char* fmt_crc(int crcqual, char* buf) {
 
 
 const char* fmt_time(time_t* tstamp, char* buf) {
+/// buf must have room for 28 chars.  Passing a buf makes this reentrant.
     static char time_buf[28];
     char* buf_select;
+    struct tm tmval;
     
     buf_select = (buf == NULL) ? time_buf : buf;
     
     // convert to time using time.h library functions
-    strftime(buf_select, 28, "%T", localtime(tstamp) );
+    strftime(buf_select, 28, "%T", localtime_r(tstamp, &tmval) );
     
     return buf_select;
 }
@@ -83,6 +83,15 @@ typedef struct {
     int enc_bits;
     int enc_parity;
     int enc_stopbits;
+    int txgap;
+    int window;
+    int txtimeout;
+    int txretries;
+    int flowctl;
+    int dtr;
+    int rts;
+    bool lowlatency;
+    int busypoll;
 } ttyspec_t;
 
 
@@ -166,7 +175,12 @@ void otter_json_loadargs(cJSON* json,
                        char** initfile,
                        char** xpath,
                        char** logfile_path,
-                       bool* verbose_val );
+                       bool* verbose_val,
+                       int* rlist_val,
+                       int* tlist_val,
+                       int* rpolicy_val,
+                       int* tpolicy_val,
+                       int* parsers_val );
 
 
 
@@ -192,6 +206,53 @@ static IO_Type sub_io_cmp(const char* s1) {
     return selected_io;
 }
 
+static int sub_policy_cmp(const char* s1) {
+/// Unknown policies are -1, so they can be rejected as input errors
+    int selected_policy;
+
+    if (strcmp(s1, "oldest") == 0) {
+        selected_policy = PKTLIST_DROPOLDEST;
+    }
+    else if (strcmp(s1, "newest") == 0) {
+        selected_policy = PKTLIST_DROPNEWEST;
+    }
+    else if (strcmp(s1, "block") == 0) {
+        selected_policy = PKTLIST_BLOCK;
+    }
+    else if (strcmp(s1, "priority") == 0) {
+        selected_policy = PKTLIST_PRIORITY;
+    }
+    else {
+        selected_policy = -1;
+    }
+    
+    return selected_policy;
+}
+
+static int sub_flow_cmp(const char* s1) {
+/// Unknown values are -1, so they can be rejected as input errors
+    if (strcmp(s1, "rtscts") == 0)  return MPIPE_FLOW_RTSCTS;
+    if (strcmp(s1, "none") == 0)    return MPIPE_FLOW_NONE;
+    return -1;
+}
+
+static int sub_line_cmp(const char* s1) {
+/// Unknown values are -1, so they can be rejected as input errors
+    int selected_line;
+
+    if ((strcmp(s1, "on") == 0) || (strcmp(s1, "1") == 0)) {
+        selected_line = MPIPE_LINE_ON;
+    }
+    else if ((strcmp(s1, "off") == 0) || (strcmp(s1, "0") == 0)) {
+        selected_line = MPIPE_LINE_OFF;
+    }
+    else {
+        selected_line = -1;
+    }
+    
+    return selected_line;
+}
+
 static INTF_Type sub_intf_cmp(const char* s1) {
     INTF_Type selected_intf;
 
@@ -220,6 +281,9 @@ static FORMAT_Type sub_fmt_cmp(const char* s1) {
     else if (strcmp(s1, "jsonhex") == 0) {
         selected_fmt = FORMAT_JsonHex;
     }
+    else if (strcmp(s1, "jsonb64") == 0) {
+        selected_fmt = FORMAT_JsonB64;
+    }
     else if (strcmp(s1, "bintex") == 0) {
         selected_fmt = FORMAT_Bintex;
     }
@@ -248,16 +312,28 @@ int main(int argc, char* argv[]) {
         memcpy(VAR, ARGITEM->filename[0], str_sz);          \
     } while(0);
 
-    struct arg_file *ttyfile = arg_file1(NULL,NULL,"ttyfile",           "Path to tty file (e.g. /dev/tty.usbmodem)");
+    struct arg_file *ttyfile = arg_file1(NULL,NULL,"ttyfile",           "Path to tty file (e.g. /dev/tty.usbmodem), or socket (tcp://host:port, udp://host:port, unix:///path)");
     struct arg_int  *brate   = arg_int0(NULL,NULL,"baudrate",           "Baudrate, default is 115200");
+    struct arg_int  *txgap   = arg_int0(NULL, "txgap", "us",            "Minimum idle time between TX frames, in us (default 0)");
+    struct arg_int  *window  = arg_int0(NULL, "window", "N",            "Max MPipe requests awaiting response, 0-128 (default 0: no tracking)");
+    struct arg_str  *flow    = arg_str0(NULL, "flow", "none|rtscts",    "TTY flow control (default none)");
+    struct arg_str  *dtr     = arg_str0(NULL, "dtr", "on|off",          "Set TTY DTR line (default: as opened)");
+    struct arg_str  *rts     = arg_str0(NULL, "rts", "on|off",          "Set TTY RTS line, without flow control (default: as opened)");
+    struct arg_lit  *lowlat  = arg_lit0(NULL, "lowlatency",              "Put the TTY driver in low latency mode");
+    struct arg_int  *busypoll= arg_int0(NULL, "busypoll", "us",         "Busy-poll RX for this long after each TX (default 0)");
     struct arg_str  *ttyenc  = arg_str0("e", "encoding", "ttyenc",      "Manual-entry for TTY encoding (default mpipe:8N1, modbus:8N2)");
     struct arg_str  *iobus   = arg_str0("b", "bus", "mpipe|modbus",      "Select \"mpipe\" or \"modbus\" bus (default=mpipe)");
-    struct arg_str  *fmt     = arg_str0("f", "fmt", "format",           "\"default\", \"json\", \"jsonhex\", \"bintex\", \"hex\"");
+    struct arg_str  *fmt     = arg_str0("f", "fmt", "format",           "\"default\", \"json\", \"jsonhex\", \"jsonb64\", \"bintex\", \"hex\"");
     struct arg_str  *intf    = arg_str0("i","intf", "interactive|pipe|socket", "Interface select.  Default: interactive");
     struct arg_file *socket  = arg_file0("S","socket","path/addr",      "Socket path/address to use for otter daemon");
     struct arg_file *initfile= arg_file0("I","init","path",             "Path to initialization routine to run at startup");
     struct arg_file *xpath   = arg_file0("x", "xpath", "path",          "Path to directory of external data processor programs");
     struct arg_file *logfile = arg_file0("L", "logfile", "path",        "Path to a file or named-pipe that may be used for log outputs");
+    struct arg_int  *rlist   = arg_int0(NULL, "rlist", "N",             "Max packets queued for RX parsing (default 32)");
+    struct arg_int  *tlist   = arg_int0(NULL, "tlist", "N",             "Max packets queued for TX (default 8)");
+    struct arg_str  *rpolicy = arg_str0(NULL, "rpolicy", "policy",      "RX overflow: \"oldest\", \"newest\", \"block\", \"priority\" (default)");
+    struct arg_str  *tpolicy = arg_str0(NULL, "tpolicy", "policy",      "TX overflow: \"oldest\" (default), \"newest\", \"block\", \"priority\"");
+    struct arg_int  *parsethr= arg_int0(NULL, "parsethreads", "N",      "Threads formatting RX packets, sharded by device (default 1)");
     //struct arg_str  *parsers = arg_str1("p", "parsers", "<msg:parser>", "parser call string with comma-separated msg:parser pairs");
     //struct arg_str  *fparse  = arg_str1("P", "parsefile", "<file>",     "file containing comma-separated msg:parser pairs");
     // Generic
@@ -269,7 +345,7 @@ int main(int argc, char* argv[]) {
     struct arg_lit  *version = arg_lit0(NULL,"version",                 "Print version information and exit");
     struct arg_end  *end     = arg_end(20);
     
-    void* argtable[] = { ttyfile, brate, ttyenc, iobus, fmt, intf, socket, initfile, xpath, logfile, config, verbose, debug, quiet, help, version, end };
+    void* argtable[] = { ttyfile, brate, txgap, window, flow, dtr, rts, lowlat, busypoll, ttyenc, iobus, fmt, intf, socket, initfile, xpath, logfile, rlist, tlist, rpolicy, tpolicy, parsethr, config, verbose, debug, quiet, help, version, end };
     const char* progname = OTTER_PARAM(NAME);
     int nerrors;
     bool bailout        = true;
@@ -287,6 +363,11 @@ int main(int argc, char* argv[]) {
     char* logfile_val   = NULL;
     bool quiet_val      = false;
     bool verbose_val    = false;
+    int rlist_val       = OTTER_PARAM_RLISTSIZE;
+    int tlist_val       = OTTER_PARAM_TLISTSIZE;
+    int rpolicy_val     = PKTLIST_PRIORITY;
+    int tpolicy_val     = PKTLIST_DROPOLDEST;
+    int parsers_val     = OTTER_PARAM_PARSETHREADS;
 
     if (arg_nullcheck(argtable) != 0) {
         /// NULL entries were detected, some allocations must have failed 
@@ -399,7 +480,12 @@ int main(int argc, char* argv[]) {
                                 &initfile_val,
                                 &xpath_val,
                                 &logfile_val,
-                                &verbose_val
+                                &verbose_val,
+                                &rlist_val,
+                                &tlist_val,
+                                &rpolicy_val,
+                                &tpolicy_val,
+                                &parsers_val
                             );
             io_val   = tmp_io;
             fmt_val  = tmp_fmt;
@@ -424,6 +510,15 @@ int main(int argc, char* argv[]) {
         ttylist[0].enc_bits     = 8;
         ttylist[0].enc_parity   = (int)'N';
         ttylist[0].enc_stopbits = 1;
+        ttylist[0].txgap        = txgap->count ? txgap->ival[0] : OTTER_PARAM_TXGAP;
+        ttylist[0].window       = window->count ? window->ival[0] : OTTER_PARAM_TXWINDOW;
+        ttylist[0].txtimeout    = OTTER_PARAM_TXTIMEOUT;
+        ttylist[0].txretries    = OTTER_PARAM_TXRETRIES;
+        ttylist[0].flowctl      = flow->count ? sub_flow_cmp(flow->sval[0]) : MPIPE_FLOW_NONE;
+        ttylist[0].dtr          = dtr->count ? sub_line_cmp(dtr->sval[0]) : MPIPE_LINE_KEEP;
+        ttylist[0].rts          = rts->count ? sub_line_cmp(rts->sval[0]) : MPIPE_LINE_KEEP;
+        ttylist[0].lowlatency   = (lowlat->count != 0);
+        ttylist[0].busypoll     = busypoll->count ? busypoll->ival[0] : OTTER_PARAM_BUSYPOLL;
         
         if (ttyenc->count != 0) {
             int str_sz = (int)strlen(ttyenc->sval[0]);
@@ -437,6 +532,18 @@ int main(int argc, char* argv[]) {
         printf("Try '%s --help' for more information.\n", progname);
         bailout = true;
     }
+    for (int i=0; (ttylist != NULL) && (i<num_tty); i++) {
+        if (ttylist[i].flowctl < 0) {
+            printf("Input error: flow must be \"none\" or \"rtscts\"\n");
+            exitcode = 1;
+            goto main_FINISH;
+        }
+        if ((ttylist[i].dtr < 0) || (ttylist[i].rts < 0)) {
+            printf("Input error: %s must be \"on\" or \"off\"\n", (ttylist[i].dtr < 0) ? "dtr" : "rts");
+            exitcode = 1;
+            goto main_FINISH;
+        }
+    }
     
     if (iobus->count != 0) {
         io_val = sub_io_cmp(iobus->sval[0]);
@@ -465,6 +572,37 @@ int main(int argc, char* argv[]) {
     if (verbose->count != 0) {
         verbose_val = true;
     }
+    if (rlist->count != 0) {
+        rlist_val = rlist->ival[0];
+    }
+    if (tlist->count != 0) {
+        tlist_val = tlist->ival[0];
+    }
+    if (rpolicy->count != 0) {
+        rpolicy_val = sub_policy_cmp(rpolicy->sval[0]);
+    }
+    if (tpolicy->count != 0) {
+        tpolicy_val = sub_policy_cmp(tpolicy->sval[0]);
+    }
+    if (parsethr->count != 0) {
+        parsers_val = parsethr->ival[0];
+    }
+    if ((rlist_val <= 0) || (tlist_val <= 0)) {
+        printf("Input error: rlist and tlist sizes must be positive\n");
+        exitcode = 1;
+        goto main_FINISH;
+    }
+    if (parsers_val <= 0) {
+        printf("Input error: parsethreads must be positive\n");
+        exitcode = 1;
+        goto main_FINISH;
+    }
+    if ((rpolicy_val < 0) || (tpolicy_val < 0)) {
+        printf("Input error: %s must be \"oldest\", \"newest\", \"block\" or \"priority\"\n",
+                (rpolicy_val < 0) ? "rpolicy" : "tpolicy");
+        exitcode = 1;
+        goto main_FINISH;
+    }
 
     // override interface value if socket address is provided
     if (socket_val != NULL) {
@@ -479,6 +617,11 @@ int main(int argc, char* argv[]) {
     cliopts.verbose_on  = verbose_val;
     cliopts.debug_on    = (debug->count != 0) ? true : false;
     cliopts.quiet_on    = quiet_val;
+    cliopts.rlist_size  = (size_t)rlist_val;
+    cliopts.tlist_size  = (size_t)tlist_val;
+    cliopts.rlist_policy = rpolicy_val;
+    cliopts.tlist_policy = tpolicy_val;
+    cliopts.parse_threads = parsers_val;
     cliopt_init(&cliopts);
 
     /// All configuration is done.
@@ -605,30 +748,12 @@ int otter_main( ttyspec_t* ttylist,
         cli.exitcode = 4;
         goto otter_main_EXIT;
     }
-    appdata.pktrx_mutex = calloc(1, sizeof(pthread_mutex_t));
-    if (appdata.pktrx_mutex == NULL) {
-        cli.exitcode = 5;
-        goto otter_main_EXIT;
-    }
-    appdata.pktrx_cond = calloc(1, sizeof(pthread_cond_t));
-    if (appdata.pktrx_cond == NULL) {
-        cli.exitcode = 6;
-        goto otter_main_EXIT;
-    }
     if (pthread_mutex_init(appdata.tlist_cond_mutex, NULL) != 0) {
-        cli.exitcode = 7;
-        goto otter_main_EXIT;
-    }
-    if (pthread_mutex_init(appdata.pktrx_mutex, NULL) != 0) {
-        cli.exitcode = 8;
+        cli.exitcode = 5;
         goto otter_main_EXIT;
     }
     if (pthread_cond_init(appdata.tlist_cond, NULL) != 0) {
-        cli.exitcode = 9;
-        goto otter_main_EXIT;
-    }
-    if (pthread_cond_init(appdata.pktrx_cond, NULL) != 0) {
-        cli.exitcode = 10;
+        cli.exitcode = 6;
         goto otter_main_EXIT;
     }
     
@@ -721,14 +846,15 @@ int otter_main( ttyspec_t* ttylist,
     DEBUG_PRINTF("--> done\n");
 
     /// Initialize packet lists for transmitted packets and received packets
-    ///@todo cliopt for max list size
     DEBUG_PRINTF("Initializing Packet Lists ...\n");
-    if ((pktlist_init(&appdata.rlist, 32) != 0)
-    ||  (pktlist_init(&appdata.tlist, 8) != 0)) {
+    if ((pktlist_init(&appdata.rlist, cliopt_getrlistsize()) != 0)
+    ||  (pktlist_init(&appdata.tlist, cliopt_gettlistsize()) != 0)) {
         fprintf(stderr, "Pktlist Initialization Failure (%i)\n", -1);
         cli.exitcode = 18;
         goto otter_main_EXIT;
     }
+    pktlist_policy_set(appdata.rlist, cliopt_getrlistpolicy(), OTTER_PARAM_PKTBLOCKMS);
+    pktlist_policy_set(appdata.tlist, cliopt_gettlistpolicy(), OTTER_PARAM_PKTBLOCKMS);
     DEBUG_PRINTF("--> done\n");
 
     /// Initialize mpipe memory
@@ -761,20 +887,38 @@ int otter_main( ttyspec_t* ttylist,
     /// Open the mpipe TTY & Setup MPipe threads
     /// The MPipe Filename (e.g. /dev/ttyACMx) is sent as the first argument
     DEBUG_PRINTF("Opening MPipe Interfaces ...\n");
+    /// A ttyfile with a socket scheme (tcp:, udp:, unix:) connects to a socket
+    /// instead, and the peer stands in for the device.
     for (int i=0; i<num_tty; i++) {
         int open_rc;
-        open_rc = mpipe_opentty(appdata.mpipe, i,
+        if (mpipe_issock(ttylist[i].ttyfile)) {
+            open_rc = mpipe_opensock(appdata.mpipe, i, ttylist[i].ttyfile);
+        }
+        else {
+            open_rc = mpipe_opentty(appdata.mpipe, i,
                                 ttylist[i].ttyfile,
                                 ttylist[i].baudrate,
                                 ttylist[i].enc_bits,
                                 ttylist[i].enc_parity,
                                 ttylist[i].enc_stopbits,
-                                0, 0, 0);
+                                ttylist[i].flowctl,
+                                ttylist[i].dtr,
+                                ttylist[i].rts);
+        }
         if (open_rc < 0) {
             fprintf(stderr, "Could not open TTY on %s (error %i)\n", ttylist[i].ttyfile, open_rc);
             cli.exitcode = 20;
             goto otter_main_EXIT;
         }
+        mpipe_txgap_set(appdata.mpipe, i, ttylist[i].txgap);
+        mpipe_txwindow_set(appdata.mpipe, i, ttylist[i].window, ttylist[i].txtimeout, ttylist[i].txretries);
+        open_rc = mpipe_lowlatency_set(appdata.mpipe, i, ttylist[i].lowlatency, ttylist[i].busypoll);
+        if (open_rc > 0) {
+            VERBOSE_PRINTF("Driver on %s has no low latency mode\n", ttylist[i].ttyfile);
+        }
+        else if (open_rc < 0) {
+            fprintf(stderr, "Busy-poll on %s is disabled (error %i)\n", ttylist[i].ttyfile, open_rc);
+        }
     }
     DEBUG_PRINTF("--> done\n");
     
@@ -895,6 +1039,18 @@ int otter_main( ttyspec_t* ttylist,
                 dterm_close(appdata.dterm_parent);
        
        case 20: // Failure on mpipe_opentty()
+                for (int i=0; i<(int)mpipe_numintf_get(appdata.mpipe); i++) {
+                    long overruns = mpipe_overruns_get(appdata.mpipe, i);
+                    mpipe_txstats_t txstats;
+                    if (overruns >= 0) {
+                        VERBOSE_PRINTF("RX overruns on %s: %ld\n", mpipe_file_get(appdata.mpipe, i), overruns);
+                    }
+                    if (mpipe_txstats_get(appdata.mpipe, i, &txstats) == 0) {
+                        VERBOSE_PRINTF("TX on %s: matched=%zu unmatched=%zu completed=%zu retransmits=%zu timeouts=%zu dropped=%zu\n",
+                                mpipe_file_get(appdata.mpipe, i), txstats.matched, txstats.unmatched,
+                                txstats.completed, txstats.retransmits, txstats.timeouts, txstats.dropped);
+                    }
+                }
                 DEBUG_PRINTF("Deinitializing MPipe\n");
                 mpipe_deinit(appdata.mpipe);
 #               if OTTER_FEATURE(MODBUS)
@@ -905,6 +1061,14 @@ int otter_main( ttyspec_t* ttylist,
 
        case 19: // Failure on mpipe_init()
                 DEBUG_PRINTF("Deinitializing Packet Lists\n");
+                VERBOSE_PRINTF("RX list drops: oldest=%zu newest=%zu lowprio=%zu (block timeouts=%zu, fallback allocs=%zu)\n",
+                        appdata.rlist->drop_oldest, appdata.rlist->drop_newest,
+                        appdata.rlist->drop_lowprio, appdata.rlist->block_timeouts,
+                        appdata.rlist->alloc_fallback);
+                VERBOSE_PRINTF("TX list drops: oldest=%zu newest=%zu lowprio=%zu (block timeouts=%zu, fallback allocs=%zu)\n",
+                        appdata.tlist->drop_oldest, appdata.tlist->drop_newest,
+                        appdata.tlist->drop_lowprio, appdata.tlist->block_timeouts,
+                        appdata.tlist->alloc_fallback);
                 pktlist_free(appdata.rlist);
                 pktlist_free(appdata.tlist);
             
@@ -936,26 +1100,13 @@ int otter_main( ttyspec_t* ttylist,
                 dterm_deinit(&dterm_handle);
 
        case 11: // Failure on dterm_init()
-                DEBUG_PRINTF("Destroying pktrx_cond\n");
-                pthread_cond_destroy(appdata.pktrx_cond);
-            
-       case 10: DEBUG_PRINTF("Destroying tlist_cond\n");
+                DEBUG_PRINTF("Destroying tlist_cond\n");
                 pthread_cond_destroy(appdata.tlist_cond);
        
-        case 9: DEBUG_PRINTF("Destroying pktrx_mutex\n");
-                pthread_mutex_unlock(appdata.pktrx_mutex);
-                pthread_mutex_destroy(appdata.pktrx_mutex);
-
-        case 8: DEBUG_PRINTF("Destroying tlist_mutex\n");
+        case 6: DEBUG_PRINTF("Destroying tlist_mutex\n");
                 pthread_mutex_unlock(appdata.tlist_cond_mutex);
                 pthread_mutex_destroy(appdata.tlist_cond_mutex);
 
-        case 7: DEBUG_PRINTF("Freeing pktrx_cond\n");
-                free(appdata.pktrx_cond);
-            
-        case 6: DEBUG_PRINTF("Freeing pktrx_mutex\n");
-                free(appdata.pktrx_mutex);
-
         case 5: DEBUG_PRINTF("Freeing tlist_cond\n");
                 free(appdata.tlist_cond);
             
@@ -993,7 +1144,12 @@ void otter_json_loadargs(cJSON* json,
                        char** initfile,
                        char** xpath,
                        char** logfile_path,
-                       bool* verbose_val ) {
+                       bool* verbose_val,
+                       int* rlist_val,
+                       int* tlist_val,
+                       int* rpolicy_val,
+                       int* tpolicy_val,
+                       int* parsers_val ) {
     
 #   define GET_STRINGENUM_ARG(DST, FUNC, NAME) do { \
         arg = cJSON_GetObjectItem(json, NAME);  \
@@ -1079,6 +1235,37 @@ void otter_json_loadargs(cJSON* json,
                     
                     arg = cJSON_GetObjectItem(obj, "stopbits");
                     ttys[i].enc_stopbits = cJSON_IsNumber(arg) ? (int)arg->valueint : 1;
+                    
+                    arg = cJSON_GetObjectItem(obj, "txgap");
+                    ttys[i].txgap = cJSON_IsNumber(arg) ? (int)arg->valueint : OTTER_PARAM_TXGAP;
+                    
+                    arg = cJSON_GetObjectItem(obj, "window");
+                    ttys[i].window = cJSON_IsNumber(arg) ? (int)arg->valueint : OTTER_PARAM_TXWINDOW;
+                    
+                    arg = cJSON_GetObjectItem(obj, "txtimeout");
+                    ttys[i].txtimeout = cJSON_IsNumber(arg) ? (int)arg->valueint : OTTER_PARAM_TXTIMEOUT;
+                    
+                    arg = cJSON_GetObjectItem(obj, "txretries");
+                    ttys[i].txretries = cJSON_IsNumber(arg) ? (int)arg->valueint : OTTER_PARAM_TXRETRIES;
+                    
+                    arg = cJSON_GetObjectItem(obj, "flow");
+                    ttys[i].flowctl = cJSON_IsString(arg) ? sub_flow_cmp(arg->valuestring) : MPIPE_FLOW_NONE;
+                    
+                    // "dtr" and "rts" can be true/false or "on"/"off"
+                    arg = cJSON_GetObjectItem(obj, "dtr");
+                    ttys[i].dtr = cJSON_IsString(arg) ? sub_line_cmp(arg->valuestring) : \
+                                  cJSON_IsBool(arg) ? (cJSON_IsTrue(arg) ? MPIPE_LINE_ON : MPIPE_LINE_OFF) : MPIPE_LINE_KEEP;
+                    
+                    arg = cJSON_GetObjectItem(obj, "rts");
+                    ttys[i].rts = cJSON_IsString(arg) ? sub_line_cmp(arg->valuestring) : \
+                                  cJSON_IsBool(arg) ? (cJSON_IsTrue(arg) ? MPIPE_LINE_ON : MPIPE_LINE_OFF) : MPIPE_LINE_KEEP;
+                    
+                    arg = cJSON_GetObjectItem(obj, "lowlatency");
+                    ttys[i].lowlatency = cJSON_IsBool(arg) ? (cJSON_IsTrue(arg) != 0) : \
+                                         cJSON_IsNumber(arg) ? (arg->valueint != 0) : false;
+                    
+                    arg = cJSON_GetObjectItem(obj, "busypoll");
+                    ttys[i].busypoll = cJSON_IsNumber(arg) ? (int)arg->valueint : OTTER_PARAM_BUSYPOLL;
                 }
             }
         }
@@ -1095,6 +1282,11 @@ void otter_json_loadargs(cJSON* json,
     GET_STRING_ARG(*xpath, "xpath");
     GET_STRING_ARG(*logfile_path, "logfile");
     GET_BOOL_ARG(verbose_val, "verbose");
+    GET_INT_ARG(rlist_val, "rlist");
+    GET_INT_ARG(tlist_val, "tlist");
+    GET_STRINGENUM_ARG(rpolicy_val, sub_policy_cmp, "rpolicy");
+    GET_STRINGENUM_ARG(tpolicy_val, sub_policy_cmp, "tpolicy");
+    GET_INT_ARG(parsers_val, "parsethreads");
 }
 
 
@@ -24,6 +24,7 @@
 #include "mpipe.h"
 #include "modbus.h"
 #include "formatters.h"
+#include "parsepool.h"
 
 // OT Filesystem modular library
 #include <otfs.h>
@@ -67,7 +68,7 @@ void* modbus_reader(void* args) {
 /// Thread that:
 /// <LI> Listens to modbus TTY via read(). </LI>
 /// <LI> Assembles the packet from TTY data. </LI>
-/// <LI> Adds packet into mpipe.rlist, sends cond-sig to modbus_parser. </LI>
+/// <LI> Adds packet into mpipe.rlist, which wakes modbus_parser. </LI>
     otter_app_t* appdata    = args;
     struct pollfd* fds      = NULL;
     mpipe_handle_t mph      = NULL;
@@ -95,7 +96,7 @@ void* modbus_reader(void* args) {
     //fnctl(dt->fd_in, F_SETFL, 0);  
     
     /// Setup for usage of the poll function to flush buffer on read timeouts.
-    num_fds = mpipe_pollfd_alloc(mph, &fds, (POLLIN | POLLNVAL | POLLHUP));
+    num_fds = mpipe_pollfd_alloc(mph, &fds, (POLLIN | POLLERR | POLLNVAL | POLLHUP));
     if (num_fds <= 0) {
         ERR_PRINTF("Modbus polling could not be started (error %i): quitting\n", num_fds);
         goto modbus_reader_TERM;
@@ -131,7 +132,7 @@ void* modbus_reader(void* args) {
                     num_dc  += connfail;
                     if (connfail == 0) {
                         fds[i].fd = ((mpipe_tab_t*)mph)->intf[i].fd.in;
-                        fds[i].events = (POLLIN | POLLNVAL | POLLHUP);
+                        fds[i].events = (POLLIN | POLLERR | POLLNVAL | POLLHUP);
                     }
                 }
             }
@@ -156,7 +157,7 @@ void* modbus_reader(void* args) {
         for (int i=0; i<num_fds; i++) {
             // Handle Errors
             ///@todo change 100ms fixed wait on hangup to a configurable amount
-            if (fds[i].revents & (POLLNVAL|POLLHUP)) {
+            if (fds[i].revents & (POLLERR|POLLNVAL|POLLHUP)) {
                 usleep(100 * 1000);
                 if (mpipe_reopen(mph, i) == 0) {
                     mpipe_flush(mph, i, 0, MPIFLUSH);
@@ -218,7 +219,7 @@ void* modbus_reader(void* args) {
 
             //HEX_DUMP(rbuf, frame_length, "Reading %d Bytes on tty\n", frame_length);
 
-            /// Copy the packet to the rlist and signal modbus_parser()
+            /// Copy the packet to the rlist, which wakes modbus_parser()
             if (pktlist_add_rx(&appdata->endpoint, mpipe_intf_get(mph, i), appdata->rlist, rbuf, (size_t)frame_length) == NULL) {
                 errcode = 3;
             }
@@ -228,11 +229,6 @@ void* modbus_reader(void* args) {
             modbus_reader_ERR:
             switch (errcode) {
                 case 0: TTY_RX_PRINTF("Packet Received Successfully (%d bytes).\n", frame_length);
-                        if (pthread_mutex_trylock(appdata->pktrx_mutex) == 0) {
-                            appdata->pktrx_cond_inactive = false;
-                            pthread_cond_signal(appdata->pktrx_cond);
-                            pthread_mutex_unlock(appdata->pktrx_mutex);
-                        }
                         break;
                 
                 case 2: TTY_RX_PRINTF("Modbus Packet Payload Length (%d bytes) is out of bounds.\n", frame_length);
@@ -364,22 +360,89 @@ void* modbus_writer(void* args) {
 
 
 
+static void sub_modbus_parsepkt(void* ctx, char* putsbuf, pkt_t* rpkt, uint64_t rxaddr) {
+/// Processes one packet from the rlist and publishes it, then deletes it.
+/// This runs on the parser thread, or on a parser pool worker, and never
+/// takes the dterm iso_mutex.
+    otter_app_t* appdata = ctx;
+    dterm_handle_t* dth  = appdata->dterm_parent;
+    uint16_t    smut_outbytes;
+    uint16_t    smut_msgbytes;
+    int         proc_result;
+    int         msgtype;
+    uint8_t*    msg;
+    int         msgbytes;
+    
+    /// If CRC is bad, discard packet now, and rxstat an error
+    /// CRC is good, so send packet to Modbus processor.
+    if (rpkt->crcqual != 0) {
+        ///@todo add rx address of input packet (set to 0)
+        dterm_publish_rxstat(dth, DFMT_Binary, rpkt->buffer, rpkt->size, true, 0, rpkt->sequence, rpkt->tstamp, rpkt->crcqual);
+    }
+    else {
+        proc_result     = smut_resp_proc(putsbuf, rpkt->buffer, &smut_outbytes, rpkt->size, true);
+        msg             = rpkt->buffer;
+        smut_msgbytes   = rpkt->size;
+        msgtype         = smut_extract_payload((void**)&msg, (void*)msg, &smut_msgbytes, smut_msgbytes, true);
+        msgbytes        = smut_msgbytes;
+
+        while (msgbytes > 0) {
+            DFMT_Type rxstat_fmt;
+            int subsig;
+            size_t putsbytes = 0;
+            uint8_t* lastmsg = msg;
+            
+            if ((proc_result == 0) && (msgtype == 0)) {
+                /// ALP message:
+                /// proc_result now takes the value from the protocol formatter.
+                /// The formatter will give negative values on framing errors
+                /// and also for protocol errors (i.e. NACKs).
+                proc_result = fmt_fprintalp((uint8_t*)putsbuf, &putsbytes, &msg, msgbytes);
+                rxstat_fmt  = DFMT_Native;
+
+                /// Successful formatted output gets propagated to any
+                /// subscribers of this ALP ID.
+                subsig = (proc_result >= 0) ? SUBSCR_SIG_OK : SUBSCR_SIG_ERR;
+                subscriber_post(appdata->subscribers, proc_result, subsig, NULL, 0);
+            }
+            else {
+                // Raw or Unidentified Message received
+                proc_result = fmt_printhex((uint8_t*)putsbuf, &putsbytes, &msg, msgbytes, 16);
+                rxstat_fmt  = DFMT_Text;
+            }
+
+            dterm_publish_rxstat(dth, rxstat_fmt, putsbuf, putsbytes, false, rxaddr, rpkt->sequence, rpkt->tstamp, rpkt->crcqual);
+
+            // Recalculate message size following the treatment of the last segment
+            msgbytes -= (msg - lastmsg);
+        }
+    }
+    
+    // Remove the packet that was just received
+    pktlist_del(rpkt);
+}
+
+
+
 void* modbus_parser(void* args) {
 ///@todo wait for modbus_writer() to complete before killing any tlist data.
 ///      A mutex could work here.
 ///@todo amputate tlist if it gets too big
 
 /// Thread that:
-/// <LI> Waits for cond-sig from modbus_reader() when new packet(s) exist. </LI>
+/// <LI> Waits on the rlist for modbus_reader() to add new packet(s). </LI>
 /// <LI> Makes sure the packet is valid. </LI>
-/// <LI> If the packet is encrypted, decrypt it. </LI>
-/// <LI> If the packet is raw, print it out using Hex formatting. </LI>
-/// <LI> If the packet is ALP formatted, do some inspection and attempt to
-///          print it out in a human-readable way. </LI>
+/// <LI> Resolves the slave address and learns the device route. </LI>
+/// <LI> Processes and publishes it, or hands it to a parser pool worker that
+///          does, when there is more than one parser thread. </LI>
+///
+/// Processing is described in sub_modbus_parsepkt().
 ///
     static char putsbuf[2048];
     otter_app_t* appdata = args;
     dterm_handle_t* dth;
+    parsepool_t pool;
+    int num_parsers;
 
     if (appdata == NULL) {
         goto modbus_parser_TERM;
@@ -391,18 +454,28 @@ void* modbus_parser(void* args) {
         goto modbus_parser_TERM;
     }
     
+    /// With one parser thread, packets are processed here, as they always
+    /// have been.
+    pool.worker = NULL;
+    pool.count  = 0;
+    num_parsers = cliopt_getparsethreads();
+    if (num_parsers > 1) {
+        if (parsepool_start(&pool, num_parsers, appdata->rlist->ring_size, &sub_modbus_parsepkt, appdata, sizeof(putsbuf)) != 0) {
+            ERR_PRINTF("Modbus parser workers could not be started: quitting\n");
+            parsepool_stop(&pool);
+            goto modbus_parser_TERM;
+        }
+    }
+    
+    pthread_cleanup_push(&parsepool_stop, &pool);
+    
     while (1) {
         int pkt_condition;  // tracks some error conditions
         pkt_t* rpkt;
         
-        pthread_mutex_lock(appdata->pktrx_mutex);
-        appdata->pktrx_cond_inactive = true;
-        while (appdata->pktrx_cond_inactive) {
-            pthread_cond_wait(appdata->pktrx_cond, appdata->pktrx_mutex);
-        }
-        pthread_mutex_unlock(appdata->pktrx_mutex);
-        
-        pthread_mutex_lock(dth->iso_mutex);
+        /// pktlist_add_rx() wakes this thread.  Wakeups are coalesced, so the
+        /// rlist must be parsed until it is empty before waiting again.
+        pktlist_wait(appdata->rlist);
         
         // This looks like an infinite loop, but is not.  The pkt_condition
         // variable will break the loop if the rlist has no new packets.
@@ -416,13 +489,6 @@ void* modbus_parser(void* args) {
         /// - It returns a positive error code if there is some packet error
         /// - rlist->cursor points to the working packet
         while (1) {
-            uint16_t    smut_outbytes;
-            uint16_t    smut_msgbytes;
-            int         proc_result;
-            int         msgtype;
-            uint8_t*    msg;
-            int         msgbytes;
-            bool        rpkt_is_resp;
             uint64_t    rxaddr;
 
             rpkt = pktlist_parse(&pkt_condition, appdata->rlist);
@@ -439,70 +505,40 @@ void* modbus_parser(void* args) {
                 ///@todo some sort of error code
                 ERR_PRINTF("A malformed packet was sent for parsing\n");
                 pktlist_del(rpkt);
-                break;
+                continue;
             }
             
             /// For a Modbus master (like this), all received packets are 
             /// responses.  In some type of peer-peer modbus system, this would
             /// need to be intelligently managed.
-            rpkt_is_resp    = true;
-            rxaddr          = devtab_lookup_uid(appdata->endpoint.devtab, rpkt->buffer[2]);
+            rxaddr = devtab_lookup_uid(appdata->endpoint.devtab, rpkt->buffer[2]);
+            
+            /// The slave address is the device VID, so a good response shows
+            /// which interface that device is on.
+            if (rpkt->crcqual == 0) {
+                devtab_route_set(appdata->endpoint.devtab, devtab_select_vid(appdata->endpoint.devtab, rpkt->buffer[2]), rpkt->intf);
+            }
             
-            /// If CRC is bad, discard packet now, and rxstat an error
-            /// CRC is good, so send packet to Modbus processor.
-            if (rpkt->crcqual != 0) {
-                ///@todo add rx address of input packet (set to 0)
-                dterm_publish_rxstat(dth, DFMT_Binary, rpkt->buffer, rpkt->size, true, 0, rpkt->sequence, rpkt->tstamp, rpkt->crcqual);
+            /// The packet leaves the rlist when it goes to a pool worker, so
+            /// it can't be dropped on overflow while the worker has it.  It is
+            /// sharded by slave address, which every frame has, even when the
+            /// device isn't in the devtab yet.
+            if (pool.count > 0) {
+                pktlist_detach(rpkt);
+                parsepool_dispatch(&pool, rpkt, rxaddr, rpkt->buffer[2]);
             }
             else {
-                proc_result     = smut_resp_proc(putsbuf, rpkt->buffer, &smut_outbytes, rpkt->size, true);
-                msg             = rpkt->buffer;
-                smut_msgbytes   = rpkt->size;
-                msgtype         = smut_extract_payload((void**)&msg, (void*)msg, &smut_msgbytes, smut_msgbytes, true);
-                msgbytes        = smut_msgbytes;
-
-                while (msgbytes > 0) {
-                    DFMT_Type rxstat_fmt;
-                    int subsig;
-                    size_t putsbytes = 0;
-                    uint8_t* lastmsg = msg;
-                    
-                    if ((proc_result == 0) && (msgtype == 0)) {
-                        /// ALP message:
-                        /// proc_result now takes the value from the protocol formatter.
-                        /// The formatter will give negative values on framing errors
-                        /// and also for protocol errors (i.e. NACKs).
-                        proc_result = fmt_fprintalp((uint8_t*)putsbuf, &putsbytes, &msg, msgbytes);
-                        rxstat_fmt  = DFMT_Native;
-
-                        /// Successful formatted output gets propagated to any
-                        /// subscribers of this ALP ID.
-                        subsig = (proc_result >= 0) ? SUBSCR_SIG_OK : SUBSCR_SIG_ERR;
-                        subscriber_post(appdata->subscribers, proc_result, subsig, NULL, 0);
-                    }
-                    else {
-                        // Raw or Unidentified Message received
-                        proc_result = fmt_printhex((uint8_t*)putsbuf, &putsbytes, &msg, msgbytes, 16);
-                        rxstat_fmt  = DFMT_Text;
-                    }
-
-                    dterm_publish_rxstat(dth, rxstat_fmt, putsbuf, putsbytes, false, rxaddr, rpkt->sequence, rpkt->tstamp, rpkt->crcqual);
-
-                    // Recalculate message size following the treatment of the last segment
-                    msgbytes -= (msg - lastmsg);
-                }
+                sub_modbus_parsepkt(appdata, putsbuf, rpkt, rxaddr);
             }
-            
-            // Remove the packet that was just received
-            pktlist_del(rpkt);
         }
-        pthread_mutex_unlock(dth->iso_mutex);
         
         ///@todo Can check for major error in pkt_condition
         ///      Major errors are integers less than -1
         
     } // END OF WHILE()
     
+    pthread_cleanup_pop(1);
+    
     modbus_parser_TERM:
     
     /// This code should never occur, given the while(1) loop.
@@ -18,12 +18,14 @@
 //#include "crc_calc_block.h"
 #include "debug.h"
 #include "mpipe.h"
+#include "mpipe_tty.h"
 
 // Local Libraries/Includes
 #include <bintex.h>
 //#include <m2def.h>
 
 // Standard C & POSIX libraries
+#include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
 #include <signal.h>
@@ -36,18 +38,37 @@
 #include <time.h>
 #include <unistd.h>
 #include <poll.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#if defined(__linux__)
+#   include <sys/eventfd.h>
+#endif
 
 
 
 
 static int sub_intf_bitsperbyte(mpipe_intf_t* intf) {
+/// Bits on the wire per byte, including start, parity, and stop bits.  The
+/// tty parameters are stored as termios flags.
     int bitsperbyte = 8;
 
     if (intf->params != NULL) {
         switch (intf->type) {
             case MPINTF_tty: {
                 mpipe_tty_t* ttyinfo = (mpipe_tty_t*)intf->params;
-                bitsperbyte = ttyinfo->data_bits + ttyinfo->parity + ttyinfo->stop_bits;
+                switch (ttyinfo->data_bits) {
+                    case CS5:   bitsperbyte = 5; break;
+                    case CS6:   bitsperbyte = 6; break;
+                    case CS7:   bitsperbyte = 7; break;
+                    default:    bitsperbyte = 8; break;
+                }
+                bitsperbyte += 1;
+                bitsperbyte += (ttyinfo->parity != 0);
+                bitsperbyte += (ttyinfo->stop_bits != 0) ? 2 : 1;
             } break;
                 
             default: break;
@@ -66,7 +87,7 @@ static int sub_intf_baudrate(mpipe_intf_t* intf) {
         switch (intf->type) {
             case MPINTF_tty: {
                 mpipe_tty_t* ttyinfo = (mpipe_tty_t*)intf->params;
-                baudrate = ttyinfo->baud;
+                baudrate = ttyinfo->bps;
             } break;
                 
             default: break;
@@ -111,6 +132,11 @@ static int sub_ttybaudrate(int native_baud) {
 }
 
 
+static bool sub_intf_issock(mpipe_intf_t* intf) {
+    return ((intf->type == MPINTF_tcp) || (intf->type == MPINTF_udp) || (intf->type == MPINTF_unix));
+}
+
+
 static void sub_freeparams(mpipe_intf_t* mpintf) {
     if (mpintf != NULL) {
         if (mpintf->params != NULL) {
@@ -120,6 +146,18 @@ static void sub_freeparams(mpipe_intf_t* mpintf) {
                     free(((mpipe_tty_t*)mpintf->params)->path);
                 }
                 break;
+            
+            case MPINTF_tcp:
+            case MPINTF_udp:
+            case MPINTF_unix: {
+                mpipe_sock_t* sockparams = (mpipe_sock_t*)mpintf->params;
+                free(sockparams->path);
+                free(sockparams->host);
+                free(sockparams->port);
+                if (sockparams->addrs != NULL) {
+                    freeaddrinfo(sockparams->addrs);
+                }
+            } break;
                 
             default: break;
             }
@@ -156,6 +194,51 @@ static int sub_check_handle(mpipe_handle_t handle, int id) {
 
 
 
+static int sub_wake_open(mpipe_intf_t* intf) {
+/// Non-blocking, so a wakeup that is already pending never stalls the writer.
+#if defined(__linux__)
+    intf->busy_wake[0] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    intf->busy_wake[1] = intf->busy_wake[0];
+    return (intf->busy_wake[0] < 0) ? -1 : 0;
+#else
+    if (pipe(intf->busy_wake) != 0) {
+        intf->busy_wake[0] = -1;
+        intf->busy_wake[1] = -1;
+        return -1;
+    }
+    for (int i=0; i<2; i++) {
+        fcntl(intf->busy_wake[i], F_SETFD, FD_CLOEXEC);
+        fcntl(intf->busy_wake[i], F_SETFL, O_NONBLOCK);
+    }
+    return 0;
+#endif
+}
+
+static void sub_wake_close(mpipe_intf_t* intf) {
+    if (intf->busy_wake[0] >= 0) {
+        close(intf->busy_wake[0]);
+    }
+    if ((intf->busy_wake[1] >= 0) && (intf->busy_wake[1] != intf->busy_wake[0])) {
+        close(intf->busy_wake[1]);
+    }
+    intf->busy_wake[0] = -1;
+    intf->busy_wake[1] = -1;
+}
+
+static void sub_wake_ring(mpipe_intf_t* intf) {
+/// Only the first wakeup after the reader clears busy_pending goes to the
+/// kernel, so back-to-back frames cost one write.
+    if ((intf->busy_wake[1] >= 0) && (__atomic_exchange_n(&intf->busy_pending, 1, __ATOMIC_ACQ_REL) == 0)) {
+        uint64_t one = 1;
+        ssize_t rc;
+        do {
+            rc = write(intf->busy_wake[1], &one, (intf->busy_wake[0] == intf->busy_wake[1]) ? 8 : 1);
+        } while ((rc < 0) && (errno == EINTR));
+    }
+}
+
+
+
 int mpipe_init(mpipe_handle_t* handle, size_t num_intf) {
 /// Initialize the interface table based on the num_intf parameter.  If it's
 /// zero then it is considered to be 1.
@@ -182,6 +265,36 @@ int mpipe_init(mpipe_handle_t* handle, size_t num_intf) {
         table->intf[i].params   = NULL;
         table->intf[i].fd.in    = -1;
         table->intf[i].fd.out   = -1;
+        table->intf[i].tx_gap_us        = OTTER_PARAM_TXGAP;
+        table->intf[i].tx_idle.tv_sec   = 0;
+        table->intf[i].tx_idle.tv_nsec  = 0;
+        table->intf[i].tx_window        = OTTER_PARAM_TXWINDOW;
+        table->intf[i].tx_timeout_ms    = OTTER_PARAM_TXTIMEOUT;
+        table->intf[i].tx_retries       = OTTER_PARAM_TXRETRIES;
+        table->intf[i].tx               = NULL;
+        memset(&table->intf[i].txstats, 0, sizeof(mpipe_txstats_t));
+        table->intf[i].exthdr           = 0;
+        table->intf[i].busypoll_us      = OTTER_PARAM_BUSYPOLL;
+        table->intf[i].busy_until       = 0;
+        table->intf[i].busy_wake[0]     = -1;
+        table->intf[i].busy_wake[1]     = -1;
+        table->intf[i].busy_pending     = 0;
+        
+        // The RX decoder is only used by MPipe IO
+#       if (OTTER_FEATURE_MPIPE == ENABLED)
+        table->intf[i].rx       = malloc(sizeof(mpipe_rx_t));
+        if (table->intf[i].rx == NULL) {
+            while (--i >= 0) {
+                free(table->intf[i].rx);
+            }
+            free(table->intf);
+            free(table);
+            return -4;
+        }
+        mpipe_rx_init(table->intf[i].rx, OTTER_PARAM_MPRXTIMEOUT);
+#       else
+        table->intf[i].rx       = NULL;
+#       endif
     }
 
     *handle = (mpipe_handle_t)table;
@@ -201,6 +314,8 @@ void mpipe_deinit(mpipe_handle_t handle) {
                 table->size--;
                 mpipe_close(handle, (int)table->size);
                 sub_freeparams(&table->intf[table->size]);
+                sub_wake_close(&table->intf[table->size]);
+                free(table->intf[table->size].rx);
             }
             free(table->intf);
         }
@@ -297,10 +412,14 @@ void* mpipe_intf_fromfile(mpipe_handle_t handle, const char* file) {
             switch (table->intf[i].type) {
                 case MPINTF_tty: stored_file = ((mpipe_tty_t*)table->intf[i].params)->path;
                     break;
+                case MPINTF_tcp:
+                case MPINTF_udp:
+                case MPINTF_unix: stored_file = ((mpipe_sock_t*)table->intf[i].params)->path;
+                    break;
                 default: stored_file = NULL;
                     break;
             }
-            if (strcmp(stored_file, file) == 0) {
+            if ((stored_file != NULL) && (strcmp(stored_file, file) == 0)) {
                 intf = (void*)&table->intf[i];
                 break;
             }
@@ -328,6 +447,10 @@ const char* mpipe_file_resolve(void* intfp) {
         switch (intf->type) {
         case MPINTF_tty: output = ((mpipe_tty_t*)intf->params)->path;
             break;
+        case MPINTF_tcp:
+        case MPINTF_udp:
+        case MPINTF_unix: output = ((mpipe_sock_t*)intf->params)->path;
+            break;
         default:
             break;
         }
@@ -355,7 +478,56 @@ int mpipe_id_resolve(mpipe_handle_t handle, void* intfp) {
 
 
 
+static void sub_timespec_addns(struct timespec* ts, int64_t ns) {
+    ns         += ts->tv_nsec;
+    ts->tv_sec += (time_t)(ns / 1000000000);
+    ts->tv_nsec = (long)(ns % 1000000000);
+}
+
+static int64_t sub_timespec_diffns(const struct timespec* start, const struct timespec* end) {
+    return ((int64_t)(end->tv_sec - start->tv_sec) * 1000000000) + (end->tv_nsec - start->tv_nsec);
+}
+
+static int64_t sub_intf_wirens(mpipe_intf_t* intf, int bytes) {
+/// Time it takes to put bytes on the wire, in nanoseconds
+    return ((int64_t)bytes * sub_intf_bitsperbyte(intf) * 1000000000) / sub_intf_baudrate(intf);
+}
+
+
+static void sub_txpace(mpipe_intf_t* intf) {
+/// Waits until the previous frame has left the wire, plus the gap.  The
+/// estimate of when the line goes idle comes from the frames written, and it
+/// is replaced by what's left in the output queue when the driver reports it.
+    struct timespec now;
+    struct timespec ready;
+    int64_t wait_ns;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+#   if defined(TIOCOUTQ)
+    {   int outq;
+        if (ioctl(intf->fd.out, TIOCOUTQ, &outq) == 0) {
+            intf->tx_idle = now;
+            sub_timespec_addns(&intf->tx_idle, sub_intf_wirens(intf, outq));
+        }
+    }
+#   endif
+    
+    ready = intf->tx_idle;
+    sub_timespec_addns(&ready, (int64_t)intf->tx_gap_us * 1000);
+    wait_ns = sub_timespec_diffns(&now, &ready);
+    if (wait_ns > 0) {
+        struct timespec req;
+        req.tv_sec  = (time_t)(wait_ns / 1000000000);
+        req.tv_nsec = (long)(wait_ns % 1000000000);
+        while (nanosleep(&req, &req) != 0);
+    }
+}
+
+
 void mpipe_writeto_intf(void* intf, uint8_t* data, int data_bytes) {
+    mpipe_intf_t* mpintf = intf;
+    struct timespec now;
     int sent_bytes;
     mpipe_fd_t* ifds;
     
@@ -364,13 +536,169 @@ void mpipe_writeto_intf(void* intf, uint8_t* data, int data_bytes) {
         if (ifds != NULL) {
             HEX_DUMP(data, data_bytes, "Writing %d bytes to %s\n", data_bytes, mpipe_file_resolve(intf));
             
+            if (mpintf->tx_gap_us > 0) {
+                sub_txpace(mpintf);
+            }
+            
+            // Frame goes out when everything queued before it is done
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (sub_timespec_diffns(&mpintf->tx_idle, &now) > 0) {
+                mpintf->tx_idle = now;
+            }
+            sub_timespec_addns(&mpintf->tx_idle, sub_intf_wirens(mpintf, data_bytes));
+            
             while (data_bytes > 0) {
+#               if defined(MSG_NOSIGNAL)
+                // A socket peer that went away must not SIGPIPE the process.
+                // The reader sees the hangup and reconnects.
+                if (sub_intf_issock(mpintf)) {
+                    sent_bytes = (int)send(ifds->out, data, data_bytes, MSG_NOSIGNAL);
+                }
+                else
+#               endif
                 sent_bytes  = (int)write(ifds->out, data, data_bytes);
+                if (sent_bytes < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    break;
+                }
                 data       += sent_bytes;
                 data_bytes -= sent_bytes;
             }
+            
+            // The response can't come before the frame is out, so the busy
+            // poll window is measured from when the line goes idle.
+            if (mpintf->busypoll_us > 0) {
+                int64_t busy_until;
+                busy_until  = (int64_t)mpintf->tx_idle.tv_sec * 1000000000 + mpintf->tx_idle.tv_nsec;
+                busy_until += (int64_t)mpintf->busypoll_us * 1000;
+                __atomic_store_n(&mpintf->busy_until, busy_until, __ATOMIC_RELEASE);
+                sub_wake_ring(mpintf);
+            }
+        }
+    }
+}
+
+
+int mpipe_txgap_set(mpipe_handle_t handle, int id, int gap_us) {
+    if (sub_check_handle(handle, id) < 0) {
+        return -1;
+    }
+    ((mpipe_tab_t*)handle)->intf[id].tx_gap_us = (gap_us > 0) ? gap_us : 0;
+    return 0;
+}
+
+
+int mpipe_txwindow_set(mpipe_handle_t handle, int id, int window, int timeout_ms, int retries) {
+    mpipe_intf_t* intf;
+    
+    if (sub_check_handle(handle, id) < 0) {
+        return -1;
+    }
+    intf = &((mpipe_tab_t*)handle)->intf[id];
+    
+    if (window < 0)     window = 0;
+    if (window > 128)   window = 128;
+    intf->tx_window     = window;
+    intf->tx_timeout_ms = (timeout_ms > 0) ? timeout_ms : OTTER_PARAM_TXTIMEOUT;
+    intf->tx_retries    = (retries > 0) ? retries : 0;
+    return 0;
+}
+
+
+int mpipe_txstats_get(mpipe_handle_t handle, int id, mpipe_txstats_t* stats) {
+    mpipe_txstats_t* txstats;
+    
+    if ((sub_check_handle(handle, id) < 0) || (stats == NULL)) {
+        return -1;
+    }
+    txstats = &((mpipe_tab_t*)handle)->intf[id].txstats;
+    
+    stats->matched      = __atomic_load_n(&txstats->matched, __ATOMIC_RELAXED);
+    stats->completed    = __atomic_load_n(&txstats->completed, __ATOMIC_RELAXED);
+    stats->retransmits  = __atomic_load_n(&txstats->retransmits, __ATOMIC_RELAXED);
+    stats->timeouts     = __atomic_load_n(&txstats->timeouts, __ATOMIC_RELAXED);
+    stats->unmatched    = __atomic_load_n(&txstats->unmatched, __ATOMIC_RELAXED);
+    stats->dropped      = __atomic_load_n(&txstats->dropped, __ATOMIC_RELAXED);
+    return 0;
+}
+
+
+int mpipe_lowlatency_set(mpipe_handle_t handle, int id, bool enable, int busypoll_us) {
+    mpipe_intf_t* intf;
+    int rc = 0;
+    
+    if (sub_check_handle(handle, id) < 0) {
+        return -1;
+    }
+    intf = &((mpipe_tab_t*)handle)->intf[id];
+    
+    intf->busypoll_us = (busypoll_us > 0) ? busypoll_us : 0;
+    if ((intf->busypoll_us > 0) && (intf->busy_wake[0] < 0) && (sub_wake_open(intf) != 0)) {
+        intf->busypoll_us = 0;
+        return -2;
+    }
+    
+    if (intf->type == MPINTF_tty) {
+        mpipe_tty_t* ttyparams = intf->params;
+        ttyparams->lowlatency = enable;
+        if ((intf->fd.in >= 0) && (mpipe_tty_lowlatency(intf->fd.in, enable) != 0)) {
+            rc = 1;
         }
     }
+    else if (enable) {
+        rc = 1;
+    }
+    
+    return rc;
+}
+
+
+bool mpipe_busypoll_get(void* intf, int64_t now_ns) {
+    mpipe_intf_t* mpintf = intf;
+    
+    if ((mpintf == NULL) || (mpintf->busypoll_us <= 0)) {
+        return false;
+    }
+    return (__atomic_load_n(&mpintf->busy_until, __ATOMIC_ACQUIRE) > now_ns);
+}
+
+
+int mpipe_busypoll_fd(void* intf) {
+    mpipe_intf_t* mpintf = intf;
+    
+    if ((mpintf == NULL) || (mpintf->busypoll_us <= 0)) {
+        return -1;
+    }
+    return mpintf->busy_wake[0];
+}
+
+
+void mpipe_busypoll_clear(void* intf) {
+    mpipe_intf_t* mpintf = intf;
+    uint64_t count;
+    
+    if ((mpintf != NULL) && (mpintf->busy_wake[0] >= 0)) {
+        // Cleared before the drain, so a TX after this point rings again
+        __atomic_store_n(&mpintf->busy_pending, 0, __ATOMIC_RELEASE);
+        while (read(mpintf->busy_wake[0], &count, sizeof(uint64_t)) > 0);
+    }
+}
+
+
+bool mpipe_exthdr_get(void* intf) {
+    if (intf == NULL) {
+        return false;
+    }
+    return (__atomic_load_n(&((mpipe_intf_t*)intf)->exthdr, __ATOMIC_RELAXED) != 0);
+}
+
+
+void mpipe_exthdr_set(void* intf) {
+    if (intf != NULL) {
+        __atomic_store_n(&((mpipe_intf_t*)intf)->exthdr, 1, __ATOMIC_RELAXED);
+    }
 }
 
 
@@ -408,6 +736,9 @@ static int sub_opentty(mpipe_intf_t* ttyintf) {
     struct termios tio;
     int i_par;
     int rc = 0;
+    
+    // A new open may have a different peer, so the header is negotiated again
+    __atomic_store_n(&ttyintf->exthdr, 0, __ATOMIC_RELAXED);
 
     // first open with O_NONBLOCK
     ttyintf->fd.in = open(ttyparams->path, O_RDWR | /*O_NDELAY*/ O_NONBLOCK | O_EXCL);
@@ -441,13 +772,19 @@ static int sub_opentty(mpipe_intf_t* ttyintf) {
     tio.c_oflag     = CR0 | TAB0 | BS0 | VT0 | FF0;
     tio.c_lflag     = 0;
     
+    ///@note VMIN stays 1, also in low latency mode.  With VTIME 0, poll() on
+    /// a TTY waits for VMIN bytes, so a larger VMIN would hold back the tail of
+    /// a frame.  Reads are frame-sized anyway: mpipe_rx_fill() takes all that
+    /// the driver has in one read.
     tio.c_cc[VMIN]  = 1;        // smallest read is one character
     tio.c_cc[VTIME] = 0;        // Inter-character timeout (after VMIN) is 0.1sec
     
     tcflush( ttyintf->fd.in, TCIOFLUSH );
     
-    cfsetospeed(&tio, ttyparams->baud);
-    cfsetispeed(&tio, ttyparams->baud);
+    // Baudrates that have no Bxxxx constant are set after tcsetattr(), with
+    // a standard rate as placeholder until then.
+    cfsetospeed(&tio, (ttyparams->baud >= 0) ? ttyparams->baud : B38400);
+    cfsetispeed(&tio, (ttyparams->baud >= 0) ? ttyparams->baud : B38400);
     
     // Using TCSANOW will do [something]
     if (tcsetattr(ttyintf->fd.in, TCSANOW, &tio) != 0)  {
@@ -455,15 +792,43 @@ static int sub_opentty(mpipe_intf_t* ttyintf) {
         goto sub_opentty_ERR;
     }
     
-    // RTS/CTS are not available at this moment (may never be)
-    //if( flowctrl != FLOW_HW )  {
-    //    if (rts)    tiocmbis(table->intf[id].fd.in,TIOCM_RTS);
-    //    else        tiocmbic(table->intf[id].fd.in,TIOCM_RTS);
-    //}
+    // The driver may not hit an arbitrary rate exactly.  Pacing and drain
+    // estimates use bps, so it gets the rate the driver actually set.
+    if (ttyparams->baud < 0) {
+        int actual_bps = mpipe_tty_setbps(ttyintf->fd.in, ttyparams->bps);
+        if (actual_bps <= 0) {
+            rc = -4;
+            goto sub_opentty_ERR;
+        }
+        ttyparams->bps = actual_bps;
+    }
+    
+    // Modem lines.  RTS is driven by the driver when RTS/CTS flow control is
+    // on.  Not every TTY has modem lines (e.g. a pty), so failure is ignored.
+    {   int mbits_set = 0;
+        int mbits_clr = 0;
+        
+        mbits_set |= (ttyparams->dtr == MPIPE_LINE_ON) ? TIOCM_DTR : 0;
+        mbits_clr |= (ttyparams->dtr == MPIPE_LINE_OFF) ? TIOCM_DTR : 0;
+        if (ttyparams->flowctl == 0) {
+            mbits_set |= (ttyparams->rts == MPIPE_LINE_ON) ? TIOCM_RTS : 0;
+            mbits_clr |= (ttyparams->rts == MPIPE_LINE_OFF) ? TIOCM_RTS : 0;
+        }
+        if (mbits_set != 0) {
+            ioctl(ttyintf->fd.in, TIOCMBIS, &mbits_set);
+        }
+        if (mbits_clr != 0) {
+            ioctl(ttyintf->fd.in, TIOCMBIC, &mbits_clr);
+        }
+    }
+    
+    // Low latency mode is kept across reopens
+    if (ttyparams->lowlatency) {
+        mpipe_tty_lowlatency(ttyintf->fd.in, 1);
+    }
     
-    // DTR is not available at this moment (may never be)
-    //if (dtr)    tiocmbis(table->intf[id].fd.in,TIOCM_DTR);
-    //else        tiocmbic(table->intf[id].fd.in,TIOCM_DTR);
+    // Overruns are counted from here
+    ttyparams->icount_base = mpipe_tty_overruns(ttyintf->fd.in);
     
     sub_opentty_EXIT:
     return rc;
@@ -518,8 +883,9 @@ int mpipe_opentty( mpipe_handle_t handle, int id,
 
     strcpy(ttyparams->path, dev);
 
+    ttyparams->bps  = baud;
     ttyparams->baud = sub_ttybaudrate(baud);
-    if (ttyparams->baud < 0) {
+    if ((ttyparams->baud < 0) && ((MPIPE_TTY_ANYBAUD == 0) || (baud <= 0))) {
         fprintf(stderr, "Error: baudrate %d is not permitted.  Default baudrate is 115200\n", baud);
         rc = -4;
         goto mpipe_opentty_EXIT;
@@ -538,23 +904,27 @@ int mpipe_opentty( mpipe_handle_t handle, int id,
     ttyparams->parity       = (parity == (int)'N') ? 0 : PARENB;
     ttyparams->stop_bits    = (stop_bits == 2) ? CSTOPB : 0;
     
-    ///@todo flowctl, dtr, rts settings not yet supported
-    ttyparams->flowctl      = flowctrl;
     ttyparams->dtr          = dtr;
     ttyparams->rts          = rts;
-
-    // Make sure all flow control is compatible with MPipe spec (i.e. disabled)
-    if ((ttyparams->flowctl != 0) || (ttyparams->dtr != 0) || (ttyparams->rts != 0)) {
-        fprintf(stderr, "In current MPipe implementation there is no flow control.  You specifed:\n");
-        if (ttyparams->flowctl != 0) {
-            fprintf(stderr, " - Flowctrl = %d\n", ttyparams->flowctl);
-        }
-        if (ttyparams->dtr != 0) {
-            fprintf(stderr, " - DTR enabled\n");
-        }
-        if (ttyparams->rts != 0) {
-            fprintf(stderr, " - RTS/CTS enabled\n");
-        }
+    ttyparams->overruns     = 0;
+    ttyparams->icount_base  = -1;
+    ttyparams->lowlatency   = 0;
+    
+    // Software flow control (XON/XOFF) can't be used, because MPipe frames
+    // are binary.  Hardware flow control is RTS/CTS.
+    switch (flowctrl) {
+        case MPIPE_FLOW_NONE:   ttyparams->flowctl = 0;
+            break;
+#       if defined(CRTSCTS)
+        case MPIPE_FLOW_RTSCTS: ttyparams->flowctl = CRTSCTS;
+            break;
+#       endif
+        default: fprintf(stderr, "Error: flow control %d is not supported.\n", flowctrl);
+            rc = -6;
+            goto mpipe_opentty_EXIT;
+    }
+    if ((dtr < MPIPE_LINE_KEEP) || (dtr > MPIPE_LINE_OFF) || (rts < MPIPE_LINE_KEEP) || (rts > MPIPE_LINE_OFF)) {
+        fprintf(stderr, "Error: DTR/RTS setting is not valid.\n");
         rc = -6;
         goto mpipe_opentty_EXIT;
     }
@@ -568,6 +938,8 @@ int mpipe_opentty( mpipe_handle_t handle, int id,
                 break;
             case -3: fprintf(stderr, "Can't set mode of serial line %s\n", ttyname(table->intf[id].fd.in));
                 break;
+            case -4: fprintf(stderr, "Error: Cannot set %d baud on %s\n", ttyparams->bps, ttyparams->path);
+                break;
             default: break;
         }
         rc = -7;
@@ -590,17 +962,317 @@ int mpipe_opentty( mpipe_handle_t handle, int id,
 }
 
 
+static char* sub_strndup(const char* src, size_t len) {
+    char* dst = calloc(len+1, sizeof(char));
+    if (dst != NULL) {
+        memcpy(dst, src, len);
+    }
+    return dst;
+}
+
+
+static mpipe_intf_enum sub_sockscheme(const char* spec, const char** addr) {
+/// Socket specs are "scheme:address", and "scheme://address" is also taken.
+    static const struct {
+        const char*     scheme;
+        mpipe_intf_enum type;
+    } schemes[] = {
+        { "tcp:",   MPINTF_tcp },
+        { "udp:",   MPINTF_udp },
+        { "unix:",  MPINTF_unix },
+    };
+    
+    if (spec != NULL) {
+        for (int i=0; i<(sizeof(schemes)/sizeof(schemes[0])); i++) {
+            size_t len = strlen(schemes[i].scheme);
+            if (strncmp(spec, schemes[i].scheme, len) == 0) {
+                spec += len;
+                if (strncmp(spec, "//", 2) == 0) {
+                    spec += 2;
+                }
+                if (addr != NULL) {
+                    *addr = spec;
+                }
+                return schemes[i].type;
+            }
+        }
+    }
+    return MPINTF_null;
+}
+
+
+static int sub_sockresolve(mpipe_intf_t* sockintf) {
+/// Resolves the host and port of a TCP/UDP interface into its address list.
+    mpipe_sock_t* sockparams = (mpipe_sock_t*)sockintf->params;
+    struct addrinfo hints;
+    
+    bzero(&hints, sizeof(struct addrinfo));
+    hints.ai_family     = AF_UNSPEC;
+    hints.ai_socktype   = (sockintf->type == MPINTF_tcp) ? SOCK_STREAM : SOCK_DGRAM;
+    
+    // An empty host is the loopback address
+    if (getaddrinfo((sockparams->host[0] != 0) ? sockparams->host : NULL, sockparams->port, &hints, &sockparams->addrs) != 0) {
+        sockparams->addrs = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+
+static int sub_sockconnect(int fd, const struct sockaddr* addr, socklen_t addrlen) {
+/// connect() that gives up after OTTER_PARAM_SOCKCONNECTMS.  Reopens are run
+/// from the reader, so a peer that never answers must not hold it up.
+    struct pollfd pfd;
+    int flags;
+    int err;
+    socklen_t errlen = sizeof(int);
+    
+    flags = fcntl(fd, F_GETFL, 0);
+    if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)) {
+        return -1;
+    }
+    
+    if (connect(fd, addr, addrlen) != 0) {
+        if ((errno != EINPROGRESS) && (errno != EAGAIN)) {
+            return -1;
+        }
+        pfd.fd      = fd;
+        pfd.events  = POLLOUT;
+        do {
+            err = poll(&pfd, 1, OTTER_PARAM_SOCKCONNECTMS);
+        } while ((err < 0) && (errno == EINTR));
+        if (err <= 0) {
+            return -1;
+        }
+        if ((getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen) != 0) || (err != 0)) {
+            return -1;
+        }
+    }
+    
+    // I/O on the interface is blocking, as with the tty
+    return (fcntl(fd, F_SETFL, flags) < 0) ? -1 : 0;
+}
+
+
+static int sub_opensock(mpipe_intf_t* sockintf) {
+    mpipe_sock_t* sockparams = (mpipe_sock_t*)sockintf->params;
+    int fd  = -1;
+    int rc  = 0;
+    
+    // A new connection may have a different peer, so the header is
+    // negotiated again
+    __atomic_store_n(&sockintf->exthdr, 0, __ATOMIC_RELAXED);
+    
+    if (sockintf->type == MPINTF_unix) {
+        struct sockaddr_un addr;
+        
+        if (strlen(sockparams->host) >= sizeof(addr.sun_path)) {
+            rc = -1;
+            goto sub_opensock_EXIT;
+        }
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            rc = -2;
+            goto sub_opensock_EXIT;
+        }
+        bzero(&addr, sizeof(struct sockaddr_un));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, sockparams->host);
+        if (sub_sockconnect(fd, (struct sockaddr*)&addr, sizeof(struct sockaddr_un)) != 0) {
+            rc = -3;
+            goto sub_opensock_ERR;
+        }
+    }
+    else {
+        struct addrinfo* ai;
+        
+        if (sockparams->addrs == NULL) {
+            rc = -1;
+            goto sub_opensock_EXIT;
+        }
+        
+        // UDP is connected too, so the peer is the only source we read from
+        rc = -3;
+        for (ai=sockparams->addrs; ai!=NULL; ai=ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) {
+                rc = -2;
+                continue;
+            }
+            if (sub_sockconnect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                rc = 0;
+                break;
+            }
+            close(fd);
+            fd = -1;
+            rc = -3;
+        }
+        if (rc != 0) {
+            goto sub_opensock_EXIT;
+        }
+        
+        // Frames are written whole, so Nagle would only hold them back
+        if (sockintf->type == MPINTF_tcp) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(int));
+        }
+    }
+    
+#   if defined(SO_NOSIGPIPE)
+    {   int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(int));
+    }
+#   endif
+    
+    // Socket has output and input on the same file descriptor
+    sockintf->fd.in     = fd;
+    sockintf->fd.out    = fd;
+    
+    sub_opensock_EXIT:
+    return rc;
+    
+    sub_opensock_ERR:
+    close(fd);
+    return rc;
+}
+
+
+bool mpipe_issock(const char* path) {
+    return (sub_sockscheme(path, NULL) != MPINTF_null);
+}
+
+
+int mpipe_opensock(mpipe_handle_t handle, int id, const char* spec) {
+    mpipe_tab_t* table;
+    mpipe_sock_t* sockparams;
+    mpipe_intf_enum type;
+    const char* addr;
+    const char* host;
+    const char* port;
+    size_t host_len;
+    int rc = 0;
+    
+    // Input Check: null values
+    if (sub_check_handle(handle, id) < 0) {
+        return -1;
+    }
+    
+    table = (mpipe_tab_t*)handle;
+    
+    // Input Check: spec has a known scheme, and tcp/udp have a port.
+    // IPv6 addresses go in brackets, e.g. tcp://[::1]:2323
+    type = sub_sockscheme(spec, &addr);
+    if (type == MPINTF_null) {
+        fprintf(stderr, "%s is not a suitable socket spec\n", (spec != NULL) ? spec : "(null)");
+        return -1;
+    }
+    if (type == MPINTF_unix) {
+        host        = addr;
+        host_len    = strlen(addr);
+        port        = NULL;
+    }
+    else if (addr[0] == '[') {
+        const char* close_bracket = strchr(addr, ']');
+        if ((close_bracket == NULL) || (close_bracket[1] != ':')) {
+            port = NULL;
+        }
+        else {
+            port = &close_bracket[2];
+        }
+        host        = &addr[1];
+        host_len    = (port == NULL) ? 0 : (size_t)(close_bracket - host);
+    }
+    else {
+        port        = strrchr(addr, ':');
+        host        = addr;
+        host_len    = 0;
+        if (port != NULL) {
+            host_len = (size_t)(port - addr);
+            port++;
+        }
+    }
+    if ((type == MPINTF_unix) ? (host_len == 0) : ((port == NULL) || (port[0] == 0))) {
+        fprintf(stderr, "Socket spec %s has no %s\n", spec, (type == MPINTF_unix) ? "path" : "port");
+        return -1;
+    }
+    
+    /// Free parameters for old interface.  New ones will be allocated for
+    /// the socket.
+    sub_freeparams(&table->intf[id]);
+
+    table->intf[id].params = calloc(1, sizeof(mpipe_sock_t));
+    if (table->intf[id].params == NULL) {
+        rc = -2;
+        goto mpipe_opensock_EXIT;
+    }
+    
+    table->intf[id].type    = type;
+    sockparams              = table->intf[id].params;
+    sockparams->path        = sub_strndup(spec, strlen(spec));
+    sockparams->host        = sub_strndup(host, host_len);
+    sockparams->port        = (port == NULL) ? NULL : sub_strndup(port, strlen(port));
+    if ((sockparams->path == NULL) || (sockparams->host == NULL) || ((port != NULL) && (sockparams->port == NULL))) {
+        rc = -3;
+        goto mpipe_opensock_EXIT;
+    }
+    if ((type != MPINTF_unix) && (sub_sockresolve(&table->intf[id]) != 0)) {
+        fprintf(stderr, "Error: Cannot resolve address of %s\n", spec);
+        rc = -7;
+        goto mpipe_opensock_EXIT;
+    }
+    
+    rc = sub_opensock(&table->intf[id]);
+    if (rc < 0) {
+        switch (rc) {
+            case -1: fprintf(stderr, "Error: Cannot resolve address of %s\n", spec);
+                break;
+            case -2: fprintf(stderr, "Error: Cannot create socket for %s\n", spec);
+                break;
+            case -3: fprintf(stderr, "Error: Cannot connect to %s\n", spec);
+                break;
+            default: break;
+        }
+        rc = -7;
+    }
+    
+    mpipe_opensock_EXIT:
+    switch (rc) {
+        case 0: rc = table->intf[id].fd.in;
+                break;
+        
+        case -7:
+        case -3: sub_freeparams(&table->intf[id]);
+        default: break;
+    }
+    
+    return rc;
+}
+
+
 ///@todo there may be freeze during this function
 int mpipe_reopen(mpipe_handle_t handle, int id) {
     mpipe_tab_t* table = (mpipe_tab_t*)handle;
     int rc = -1;
     
     if (sub_check_handle(handle, id) >= 0) {
+        // Overruns from this open are kept across the reopen
+        if (table->intf[id].type == MPINTF_tty) {
+            long overruns = mpipe_overruns_get(handle, id);
+            if (overruns >= 0) {
+                ((mpipe_tty_t*)table->intf[id].params)->overruns = overruns;
+            }
+        }
+        
         mpipe_close(handle, id);
+        __atomic_store_n(&table->intf[id].exthdr, 0, __ATOMIC_RELAXED);
         
         switch (table->intf[id].type) {
             case MPINTF_tty: rc = sub_opentty(&table->intf[id]);
                 break;
+            case MPINTF_tcp:
+            case MPINTF_udp:
+            case MPINTF_unix: rc = sub_opensock(&table->intf[id]);
+                break;
             default:
                 break;
         }
@@ -611,6 +1283,32 @@ int mpipe_reopen(mpipe_handle_t handle, int id) {
 
 
 
+long mpipe_overruns_get(mpipe_handle_t handle, int id) {
+    mpipe_tab_t* table = (mpipe_tab_t*)handle;
+    mpipe_tty_t* ttyparams;
+    long icount;
+    
+    if (sub_check_handle(handle, id) < 0) {
+        return -1;
+    }
+    if ((table->intf[id].type != MPINTF_tty) || (table->intf[id].params == NULL)) {
+        return -1;
+    }
+    
+    ttyparams = table->intf[id].params;
+    if (ttyparams->icount_base < 0) {
+        return (ttyparams->overruns > 0) ? ttyparams->overruns : -1;
+    }
+    
+    icount = (table->intf[id].fd.in >= 0) ? mpipe_tty_overruns(table->intf[id].fd.in) : -1;
+    if (icount < ttyparams->icount_base) {
+        return ttyparams->overruns;
+    }
+    return ttyparams->overruns + (icount - ttyparams->icount_base);
+}
+
+
+
 int mpipe_close(mpipe_handle_t handle, int id) {
     mpipe_fd_t* fds;
     int rc=0, rci=0, rco=0;
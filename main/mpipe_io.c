@@ -14,12 +14,17 @@
   *
   */
 
+#include "otter_cfg.h"
+#if (OTTER_FEATURE_MPIPE == ENABLED)
+
 // Application Includes
-//#include "crc_calc_block.h"
+#include "crc_calc_block.h"
 #include "debug.h"
 #include "mpipe.h"
+#include "mpipe_rx.h"
 #include "otter_app.h"
 #include "otter_cfg.h"
+#include "parsepool.h"
 
 // Local Libraries/Includes
 #include <dterm.h>
@@ -76,40 +81,128 @@ static int64_t timespec_diffms(struct timespec start, struct timespec end) {
   * ========================================================================<BR>
   * <LI> mpipe_reader() : manages TTY RX, pushes to rlist.  Depends on no other
   *          thread. </LI>
-  * <LI> mpipe_writer() : manages TTY TX, gets packets from tlist.  Depends on
-  *          dterm_parser() to prepare packet and also waits for mpipe_reader()
-  *          to be idle. </LI>
+  * <LI> mpipe_writer() : manages TTY TX, gets packets from tlist and hands
+  *          them to a writer worker for each interface.  Depends on
+  *          dterm_parser() to prepare packet. </LI>
   * <LI> mpipe_parser() : gets packets from rlist, parses the internal 
   *          protocols, writes output to terminal screen, and manages both rlist
   *          and tlist.  Depends on mpipe_reader(), mpipe_writer(), and also
   *          dterm_parser(). </LI>
   */
-#define _PKTPOLL_MS  50
 
-void* mpipe_reader(void* args) {
-/// Thread that:
-/// <LI> Listens to mpipe TTY via read(). </LI>
-/// <LI> Assembles the packet from TTY data. </LI>
-/// <LI> Adds packet into mpipe.rlist, sends cond-sig to mpipe_parser. </LI>
-///
-    otter_app_t* appdata    = args;
-    struct pollfd* fds      = NULL;
+typedef struct {
+    otter_app_t*    appdata;
+    int             id_base;
+    int             num_ids;
+} sub_rxslice_t;
+
+
+#if (OTTER_FEATURE_NOPOLL != ENABLED)
+static uint8_t* sub_rxlease(void* ctx, size_t size, void** lease) {
+    pkt_t* pkt = pktlist_lease((pktlist_t*)ctx, size);
+    *lease = pkt;
+    return (pkt != NULL) ? pkt->buffer : NULL;
+}
+
+static void sub_rxrelease(void* lease) {
+    pktlist_release((pkt_t*)lease);
+}
+
+
+static int64_t sub_monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+
+static int sub_reconnect(mpipe_handle_t mph, sub_rxslice_t* slice, struct pollfd* fds) {
+/// Tries to reopen every interface in the slice that is queued for reconnect
+/// (fd < 0), and returns how many are still down.
+    int num_dc = 0;
+    int id;
+    
+    for (int i=0; i<slice->num_ids; i++) {
+        if (fds[i].fd < 0) {
+            id = slice->id_base + i;
+            VERBOSE_PRINTF("Attempting to reconnect on %s\n", mpipe_file_get(mph, id));
+            if (mpipe_reopen(mph, id) != 0) {
+                num_dc++;
+            }
+            else {
+                mpipe_flush(mph, id, 0, MPIFLUSH);
+                fds[i].fd = ((mpipe_tab_t*)mph)->intf[id].fd.in;
+            }
+        }
+    }
+    return num_dc;
+}
+
+
+static bool sub_busypoll(mpipe_handle_t mph, sub_rxslice_t* slice) {
+/// True while any interface in the slice is inside its post-TX busy-poll
+/// window (see mpipe_lowlatency_set()).
+    struct timespec now;
+    int64_t now_ns;
+    int i;
+    
+    for (i=0; i<slice->num_ids; i++) {
+        if (((mpipe_tab_t*)mph)->intf[slice->id_base+i].busypoll_us > 0) {
+            break;
+        }
+    }
+    if (i == slice->num_ids) {
+        return false;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    now_ns = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    for (i=0; i<slice->num_ids; i++) {
+        if (mpipe_busypoll_get(mpipe_intf_get(mph, slice->id_base+i), now_ns)) {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+
+static void* sub_mpipe_rxloop(sub_rxslice_t* slice) {
+/// Reader loop for a slice of the interface table.  The slice is the whole
+/// table in the single-thread mode, or one interface in the per-interface
+/// thread mode.  Each interface has its own decoder context in mpipe_intf_t,
+/// so a frame in progress on one interface never holds up the others.
+    otter_app_t* appdata    = slice->appdata;
+    struct pollfd* allfds   = NULL;
+    struct pollfd* fds;
     mpipe_handle_t mph      = NULL;
+    pktinbox_t* inbox       = NULL;
     int num_fds;
-    int pollcode;
-    int polltimeout;
-    int ready_fds;
     
+    uint8_t* frame;
+    size_t frame_length;
+    void* lease         = NULL;
+    int errcode;
+    int new_bytes;
+    int id;
+    int i = 0;
+    
+#   if (OTTER_FEATURE_NOPOLL == ENABLED)
     uint8_t rbuf[1024];
     uint8_t* rbuf_cursor;
     int header_length;
     int payload_length;
     int payload_left;
-    int errcode;
-    int new_bytes;
     uint8_t syncinput;
-    int frame_length;
-    int i = 0;
+#   else
+    mpipe_rx_t* rxdec       = NULL;
+    struct pollfd* pollset  = NULL;
+    bool busy;
+    int ready_fds;
+    int polltimeout;
+    int64_t reconnect_at    = 0;
+    int reconnect_wait      = 0;
+#   endif
     
     if (appdata == NULL) {
         goto mpipe_reader_TERM;
@@ -122,17 +215,49 @@ void* mpipe_reader(void* args) {
     //fnctl(dt->fd_in, F_SETFL, 0);  
     
     /// Setup for usage of the poll function to flush buffer on read timeouts.
-    num_fds = mpipe_pollfd_alloc(mph, &fds, (POLLIN | POLLNVAL | POLLHUP));
+    /// The pollfd array is indexed relative to the start of the slice.
+    num_fds = mpipe_pollfd_alloc(mph, &allfds, (POLLIN | POLLERR | POLLNVAL | POLLHUP));
     if (num_fds <= 0) {
         ERR_PRINTF("MPipe polling could not be started (error %i): quitting\n", num_fds);
         goto mpipe_reader_TERM;
     }
+    if ((slice->id_base + slice->num_ids) > num_fds) {
+        ERR_PRINTF("MPipe reader slice is out of range: quitting\n");
+        goto mpipe_reader_TERM;
+    }
+    fds     = &allfds[slice->id_base];
+    num_fds = slice->num_ids;
     
-    // polltimeout starts as -1, and it is assigned ever longer timeouts until
-    // all devices are reconnected
-    polltimeout = -1;
+#   if (OTTER_FEATURE_NOPOLL != ENABLED)
+    /// The busy-poll wakeups of the interfaces follow them in the poll set.
+    /// poll() skips the entries of interfaces that don't have one (fd < 0).
+    pollset = calloc(2*num_fds, sizeof(struct pollfd));
+    if (pollset == NULL) {
+        ERR_PRINTF("MPipe poll set could not be allocated: quitting\n");
+        goto mpipe_reader_TERM;
+    }
+    for (i=0; i<num_fds; i++) {
+        pollset[i]                  = fds[i];
+        pollset[num_fds+i].fd       = mpipe_busypoll_fd(mpipe_intf_get(mph, slice->id_base+i));
+        pollset[num_fds+i].events   = POLLIN;
+    }
+    fds = pollset;
+#   endif
     
-    mpipe_flush(mph, -1, 0, MPIFLUSH);
+    /// Each reader thread is the single producer for its own rlist inbox, so
+    /// queuing a frame for mpipe_parser() doesn't need the rlist mutex.
+    inbox = pktlist_inbox_open(appdata->rlist);
+    if (inbox == NULL) {
+        ERR_PRINTF("MPipe reader could not open rlist inbox: quitting\n");
+        goto mpipe_reader_TERM;
+    }
+    
+    for (i=0; i<num_fds; i++) {
+        mpipe_flush(mph, slice->id_base+i, 0, MPIFLUSH);
+#       if (OTTER_FEATURE_NOPOLL != ENABLED)
+        mpipe_rx_setlease(((mpipe_tab_t*)mph)->intf[slice->id_base+i].rx, &sub_rxlease, &sub_rxrelease, appdata->rlist);
+#       endif
+    }
     
     /// Beginning of read loop
     while (1) {
@@ -144,6 +269,7 @@ void* mpipe_reader(void* args) {
             struct timespec test;
             
             mpipe_reader_INIT:
+            id              = slice->id_base;
             rbuf_cursor     = rbuf;
             unused_bytes    = 0;
             payload_left    = 1;
@@ -232,7 +358,13 @@ void* mpipe_reader(void* args) {
                 
                 // Payload (N bytes)
                 case 3: if (payload_left <= 0) {
-                            errcode = 0;
+                            errcode         = 0;
+                            frame           = rbuf;
+                            frame_length    = (size_t)(header_length + payload_length);
+                            if (crc_calc_block(&rbuf[2], frame_length-2) != ((rbuf[0] << 8) | rbuf[1])) {
+                                errcode = 3;
+                                goto mpipe_reader_ERR;
+                            }
                             goto mpipe_reader_READDONE;
                         }
                         break;
@@ -254,159 +386,97 @@ void* mpipe_reader(void* args) {
             }
 
 #       else // NORMAL MODE
-        // Handle timeout (return 0).
         // Timeouts only occur when there is a job to reconnect to some lost
-        // connections.
-        ready_fds = poll(fds, num_fds, polltimeout);
-        if (ready_fds == 0) {
-            int num_dc = 0;
-            int connfail;
-            
-            for (i=0; i<num_fds; i++) {
-                if (fds[i].fd < 0) {
-                    VERBOSE_PRINTF("Attempting to reconnect on %s\n", mpipe_file_get(mph, i));
-                    connfail = (mpipe_reopen(mph, i) != 0);
-                    num_dc  += connfail;
-                    if (connfail == 0) {
-                        fds[i].fd = ((mpipe_tab_t*)mph)->intf[i].fd.in;
-                        fds[i].events = (POLLIN | POLLNVAL | POLLHUP);
-                    }
-                }
+        // connections.  Lost interfaces are left out of the poll (fd < 0), and
+        // they are reconnected when the deadline passes, whether or not the
+        // other interfaces are busy.
+        polltimeout = -1;
+        if (reconnect_at != 0) {
+            int64_t wait_ms = reconnect_at - sub_monotonic_ms();
+            polltimeout = (wait_ms > 0) ? (int)wait_ms : 0;
+        }
+        
+        // In a busy-poll window after TX, poll without sleeping, so the
+        // response is picked up without waiting for a thread wakeup.
+        // A window opened by TX while the reader sleeps wakes it through the
+        // interface's busy-poll fd.
+        busy = sub_busypoll(mph, slice);
+        ready_fds = poll(fds, 2*num_fds, busy ? 0 : polltimeout);
+        
+        // Handle fatal errors
+        if (ready_fds < 0) {
+            if (errno == EINTR) {
+                continue;
             }
-            if (num_dc == 0) {
-                polltimeout = -1;
+            ERR_PRINTF("Polling failure in %s, line %i\n", __FUNCTION__, __LINE__);
+            goto mpipe_reader_TERM;
+        }
+        
+        // Busy-poll wakeups: sub_busypoll() picks up the window on the next pass
+        for (i=num_fds; i<(2*num_fds); i++) {
+            if (fds[i].revents & POLLIN) {
+                mpipe_busypoll_clear(mpipe_intf_get(mph, slice->id_base + (i-num_fds)));
+                ready_fds--;
             }
-            else if (polltimeout >= 30000) {
-                polltimeout = 60000;
+        }
+        
+        ///@todo initial reconnect backoff should be an environment variable
+        if ((reconnect_at != 0) && (sub_monotonic_ms() >= reconnect_at)) {
+            if (sub_reconnect(mph, slice, fds) == 0) {
+                reconnect_at    = 0;
+                reconnect_wait  = 0;
             }
             else {
-                polltimeout *= 2;
+                reconnect_wait  = (reconnect_wait < 4000) ? 4000 : 2*reconnect_wait;
+                reconnect_wait  = (reconnect_wait > 60000) ? 60000 : reconnect_wait;
+                reconnect_at    = sub_monotonic_ms() + reconnect_wait;
             }
-            continue;
         }
         
-        // Handle fatal errors
-        if (ready_fds < 0) {
-            ERR_PRINTF("Polling failure in %s, line %i\n", __FUNCTION__, __LINE__);
-            goto mpipe_reader_TERM;
+        if (ready_fds == 0) {
+            continue;
         }
         
         for (i=0; i<num_fds; i++) {
-            // Handle Errors
-            ///@todo change 100ms fixed wait on hangup to a configurable amount
-            if (fds[i].revents & (POLLNVAL|POLLHUP)) {
-                usleep(100 * 1000);
+            id      = slice->id_base + i;
+            rxdec   = ((mpipe_tab_t*)mph)->intf[id].rx;
+            
+            // Handle Errors.  POLLERR stays set until the socket error is
+            // read (e.g. ICMP refusal on a connected UDP peer), so it is
+            // handled like a hangup rather than polled again.
+            if (fds[i].revents & (POLLERR|POLLNVAL|POLLHUP)) {
                 errcode = 5;
                 goto mpipe_reader_ERR;
             }
         
-            // Verify that POLLIN is high.  This should be implicit, but we check explicitly here
+            // Nothing for this interface.  It is left alone: the decoder may
+            // be holding part of a frame whose next bytes are on the way.
             if ((fds[i].revents & POLLIN) == 0) {
-                mpipe_flush(mph, i, 0, MPIFLUSH);
                 continue;
             }
 
-            // Find FF, the first sync byte
-            mpipe_reader_SYNC0:
-            new_bytes = (int)read(fds[i].fd, &syncinput, 1);
-            if (new_bytes < 1) {
-                errcode = 1;        // flushable
+            /// Pull everything the driver has for this interface into its
+            /// decoder with one read().  The decoder keeps partial frames, and
+            /// it deals with inter-byte timeouts by timestamp.
+            new_bytes = mpipe_rx_fill(rxdec, fds[i].fd);
+            if (new_bytes <= 0) {
+                errcode = (new_bytes == 0) ? 5 : 1;
                 goto mpipe_reader_ERR;
             }
-            if (syncinput != 0xFF) {
-                goto mpipe_reader_SYNC0;
-            }
-            TTY_PRINTF("Sync FF Received\n");
             
-            // Now wait for a 55, ignoring FFs
-            mpipe_reader_SYNC1:
-            pollcode = poll(&fds[i], 1, _PKTPOLL_MS);
-            if (pollcode <= 0) {
-                errcode = 4;        // flushable
-                goto mpipe_reader_ERR;
-            }
-            else if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
-                errcode = 5;        // flushable
-                goto mpipe_reader_ERR;
-            }
-            new_bytes = (int)read(fds[i].fd, &syncinput, 1);
-            if (new_bytes < 1) {
-                errcode = 1;        // flushable
-                goto mpipe_reader_ERR;
-            }
-            if (syncinput == 0xFF) {
-                goto mpipe_reader_SYNC1;
-            }
-            if (syncinput != 0x55) {
-                goto mpipe_reader_SYNC0;
-            }
-            TTY_PRINTF("Sync 55 Received\n");
-            
-            // At this point, FF55 was detected.  We get the next 6 bytes of the
-            // header, which is the rest of the header.
-            /// @todo Make header length dynamic based on control field (last byte).
-            ///           However, control field is not yet defined.
-            new_bytes       = 0;
-            payload_left    = 6;
-            rbuf_cursor     = rbuf;
-            while (payload_left > 0) {
-                pollcode = poll(&fds[i], 1, _PKTPOLL_MS);
-                if (pollcode <= 0) {
-                    errcode = 4;
-                    goto mpipe_reader_ERR;
-                }
-                else if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
-                    errcode = 5;
-                    goto mpipe_reader_ERR;
-                }
-            
-                new_bytes       = (int)read(fds[i].fd, rbuf_cursor, payload_left);
-                rbuf_cursor    += new_bytes;
-                payload_left   -= new_bytes;
-                TTY_PRINTF("header new_bytes = %d\n", new_bytes);
+            /// Extract every complete frame now sitting in the decoder.  Each
+            /// one goes through the same queuing and error handling as before.
+            /// The decoder assembles frames directly into packets leased from
+            /// the rlist, so a good frame is queued without a copy.
+            mpipe_reader_NEXTFRAME:
+            errcode = mpipe_rx_getframe(rxdec, &frame, &frame_length, &lease);
+            if (errcode < 0) {
+                continue;
             }
-
-            // Bytes 0:1 are the CRC16 checksum.  The controlling app can decide what
-            // to do about those.  They are in the buffer.
-            // Bytes 2:3 are the Length of the Payload, in big endian.  It can be up
-            // to 65535 bytes, but CRC16 won't be great help for more than 250 bytes.
-            payload_length  = rbuf[2] * 256;
-            payload_length += rbuf[3];
-            
-            // Byte 4 is a sequence number, which the controlling app can decide what
-            // to do with.  Byte 5 is RFU, but in the future it can be used to
-            // expand the header.  That logic would go below (currently trivial).
-            header_length = 6 + 0;
-            
-            // Now do some checks to prevent malformed packets.
-            if (((unsigned int)payload_length == 0) \
-            || ((unsigned int)payload_length > (1024-header_length))) {
-                errcode = 2;
+            if (errcode != 0) {
                 goto mpipe_reader_ERR;
             }
 
-            // Receive the remaining payload bytes
-            payload_left    = payload_length;
-            rbuf_cursor     = &rbuf[6];
-            while (payload_left > 0) {
-                pollcode = poll(&fds[i], 1, _PKTPOLL_MS);
-                if (pollcode <= 0) {
-                    errcode = 4;
-                    goto mpipe_reader_ERR;
-                }
-                else if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
-                    errcode = 5;
-                    goto mpipe_reader_ERR;
-                }
-                new_bytes       = (int)read(fds[i].fd, rbuf_cursor, payload_left);
-                // Debugging output
-                TTY_PRINTF("payload new_bytes = %d\n", new_bytes);
-                HEX_DUMP(rbuf_cursor, new_bytes, "read(): ");
-                
-                rbuf_cursor    += new_bytes;
-                payload_left   -= new_bytes;
-            }
-
 #       endif
 
             mpipe_reader_READDONE:
@@ -414,61 +484,104 @@ void* mpipe_reader(void* args) {
             // Debugging output
             //HEX_DUMP(&rbuf[6], payload_length, "pkt   : ");
 
-            // Copy the packet to the rlist and signal mpipe_parser()
-            if (pktlist_add_rx(&appdata->endpoint, mpipe_intf_get(mph, i), appdata->rlist, rbuf, (size_t)(header_length + payload_length)) == NULL) {
+            // Post (or copy) the packet to the rlist.  Either way, the rlist
+            // wakes mpipe_parser() itself.
+            if (lease != NULL) {
+                if (pktlist_post_rx(inbox, mpipe_intf_get(mph, id), lease, frame_length) == NULL) {
+                    errcode = 3;
+                }
+                lease = NULL;
+            }
+#           if (OTTER_FEATURE_NOPOLL != ENABLED)
+            /// With no lease, the rlist refused the frame by its overflow
+            /// policy, and the drop has already been counted there.
+            else {
                 errcode = 3;
             }
+#           else
+            else if (pktlist_add_rx(&appdata->endpoint, mpipe_intf_get(mph, id), appdata->rlist, frame, frame_length) == NULL) {
+                errcode = 3;
+            }
+#           endif
             
             // Error Handler: wait a few milliseconds, then handle the error.
             /// @todo supply estimated bytes remaining into mpipe_flush()
             mpipe_reader_ERR:
 
             switch (errcode) {
-            case 0: TTY_RX_PRINTF("Packet Received Successfully (%d bytes).\n", frame_length);
-                    if (pthread_mutex_trylock(appdata->pktrx_mutex) == 0) {
-                        appdata->pktrx_cond_inactive = false;
-                        pthread_cond_signal(appdata->pktrx_cond);
-                        pthread_mutex_unlock(appdata->pktrx_mutex);
-                    }
+            case 0: TTY_RX_PRINTF("Packet Received Successfully (%zu bytes).\n", frame_length);
                     break;
             
             case 1: TTY_RX_PRINTF("MPipe Packet Sync could not be retrieved.\n");
+#                   if (OTTER_FEATURE_NOPOLL != ENABLED)
+                    mpipe_rx_reset(rxdec);
+#                   endif
                     goto mpipe_reader_ERRFLUSH;
             
-            case 2: TTY_RX_PRINTF("Mpipe Packet Payload Length (%d bytes) is out of bounds.\n", frame_length);
-                    goto mpipe_reader_ERRFLUSH;
+            case 2: TTY_RX_PRINTF("Mpipe Packet Payload Length is out of bounds.\n");
+                    goto mpipe_reader_ERRRESYNC;
             
             case 3: TTY_RX_PRINTF("Mpipe Packet frame has invalid data (bad crypto or CRC).\n");
-                    goto mpipe_reader_ERRFLUSH;
+                    goto mpipe_reader_ERRRESYNC;
             
             case 4: TTY_RX_PRINTF("Mpipe Packet RX timed-out\n");
+            mpipe_reader_ERRRESYNC:
+#                   if (OTTER_FEATURE_NOPOLL != ENABLED)
+                    ///@note The decoder has already dropped the bad frame and
+                    /// resynchronized.  Flushing the driver queue here would
+                    /// only throw away good frames that follow it.
+                    break;
+#                   endif
             mpipe_reader_ERRFLUSH:
-                    mpipe_flush(mph, i, 0, MPIFLUSH);
+                    mpipe_flush(mph, id, 0, MPIFLUSH);
                     break;
                 
             case 5: TTY_RX_PRINTF("Mpipe TTY lost connection: reopening\n");
-                    if (mpipe_reopen(mph, i) == 0) {
-                        mpipe_flush(mph, i, 0, MPIFLUSH);
+#                   if (OTTER_FEATURE_NOPOLL != ENABLED)
+                    ///@note The reopen isn't done here, so a device that keeps
+                    /// hanging up can't stall or spin the other interfaces.
+                    /// It waits OTTER_PARAM_RECONNECTMS, in the poll.
+                    mpipe_rx_reset(rxdec);
+                    fds[i].fd = -1;
+                    {   int64_t at = sub_monotonic_ms() + OTTER_PARAM_RECONNECTMS;
+                        if ((reconnect_at == 0) || (at < reconnect_at)) {
+                            reconnect_at = at;
+                        }
+                    }
+                    break;
+#                   endif
+                    if (mpipe_reopen(mph, id) == 0) {
+                        mpipe_flush(mph, id, 0, MPIFLUSH);
+                        fds[i].fd = ((mpipe_tab_t*)mph)->intf[id].fd.in;
                     }
                     else {
-                        VERBOSE_PRINTF("Connection dropped on %s: queuing for reconnect\n", mpipe_file_get(mph, i));
+                        VERBOSE_PRINTF("Connection dropped on %s: queuing for reconnect\n", mpipe_file_get(mph, id));
                         ///@todo initial polltimeout should be an environment variable
-                        polltimeout = 4000;
+                        fds[i].fd = -1;
                     }
                     break;
                 
             default: ERR_PRINTF("Fatal error in %s: Quitting\n", __FUNCTION__);
                     goto mpipe_reader_TERM;
             }
+            
+#           if (OTTER_FEATURE_NOPOLL != ENABLED)
+            // Loop until the decoder needs more data
+            goto mpipe_reader_NEXTFRAME;
+#           endif
         }
     }
     
     mpipe_reader_TERM:
-    mpipe_flush(mph, -1, 0, MPIOFLUSH);
-    
-    if (fds != NULL) {
-        free(fds);
+    if (allfds != NULL) {
+        for (i=0; i<slice->num_ids; i++) {
+            mpipe_flush(mph, slice->id_base+i, 0, MPIOFLUSH);
+        }
+        free(allfds);
     }
+#   if (OTTER_FEATURE_NOPOLL != ENABLED)
+    free(pollset);
+#   endif
     
     /// This occurs on uncorrected errors, such as case 4 from above, or other 
     /// unknown errors.
@@ -478,23 +591,479 @@ void* mpipe_reader(void* args) {
 
 
 
+#if ((OTTER_FEATURE_MPRXTHREADS == ENABLED) && (OTTER_FEATURE_NOPOLL != ENABLED))
+typedef struct {
+    pthread_t*      thread;
+    sub_rxslice_t*  slice;
+    int             count;
+} sub_rxworkers_t;
+
+
+static void* sub_mpipe_rxworker(void* args) {
+    return sub_mpipe_rxloop((sub_rxslice_t*)args);
+}
+
+
+static void sub_mpipe_rxworkers_stop(void* args) {
+/// Cleanup handler for mpipe_reader(): the workers are not known to main(),
+/// so when it cancels the reader they have to be cancelled from here.
+    sub_rxworkers_t* workers = args;
+
+    for (int i=0; i<workers->count; i++) {
+        pthread_cancel(workers->thread[i]);
+    }
+    for (int i=0; i<workers->count; i++) {
+        pthread_join(workers->thread[i], NULL);
+    }
+    free(workers->thread);
+    free(workers->slice);
+}
+#endif
+
+
+
+void* mpipe_reader(void* args) {
+/// Thread that:
+/// <LI> Listens to mpipe TTY via read(). </LI>
+/// <LI> Assembles the packet from TTY data. </LI>
+/// <LI> Posts packet into mpipe.rlist, which wakes mpipe_parser. </LI>
+///
+/// With OTTER_FEATURE_MPRXTHREADS, each interface gets its own worker thread
+/// and this thread just supervises them.  Otherwise, all interfaces are
+/// multiplexed in this thread via poll().  In both cases, every interface has
+/// its own decoder and all of them feed the same rlist.
+    otter_app_t* appdata = args;
+    sub_rxslice_t slice;
+    
+    if (appdata == NULL) {
+        raise(SIGTERM);
+        return NULL;
+    }
+    
+    slice.appdata   = appdata;
+    slice.id_base   = 0;
+    slice.num_ids   = (int)mpipe_numintf_get(appdata->mpipe);
+    
+#   if ((OTTER_FEATURE_MPRXTHREADS == ENABLED) && (OTTER_FEATURE_NOPOLL != ENABLED))
+    if (slice.num_ids > 1) {
+        sub_rxworkers_t workers;
+        
+        workers.count   = 0;
+        workers.thread  = calloc(slice.num_ids, sizeof(pthread_t));
+        workers.slice   = calloc(slice.num_ids, sizeof(sub_rxslice_t));
+        if ((workers.thread == NULL) || (workers.slice == NULL)) {
+            ERR_PRINTF("MPipe reader workers could not be allocated: quitting\n");
+            free(workers.thread);
+            free(workers.slice);
+            raise(SIGTERM);
+            return NULL;
+        }
+        
+        pthread_cleanup_push(&sub_mpipe_rxworkers_stop, &workers);
+        
+        for (int i=0; i<slice.num_ids; i++) {
+            workers.slice[i].appdata    = appdata;
+            workers.slice[i].id_base    = i;
+            workers.slice[i].num_ids    = 1;
+            if (pthread_create(&workers.thread[i], NULL, &sub_mpipe_rxworker, &workers.slice[i]) != 0) {
+                ERR_PRINTF("MPipe reader worker %d could not be started: quitting\n", i);
+                raise(SIGTERM);
+                break;
+            }
+            workers.count++;
+        }
+        
+        // Workers only return on fatal errors, and they raise SIGTERM when
+        // they do.  This thread waits here until main() cancels it.
+        for (int i=0; i<workers.count; i++) {
+            pthread_join(workers.thread[i], NULL);
+        }
+        
+        pthread_cleanup_pop(1);
+        return NULL;
+    }
+#   endif
+    
+    return sub_mpipe_rxloop(&slice);
+}
+
+
+
+
+/** MPipe TX Workers <BR>
+  * ========================================================================<BR>
+  * Each interface has its own writer worker and queue, so a slow or stalled
+  * link only holds up its own traffic.  mpipe_writer() takes packets off the
+  * tlist and dispatches them by reference: a broadcast packet is queued to
+  * every worker with one reference each, and whichever worker writes it last
+  * deletes it.
+  *
+  * Each request the worker writes is recorded in a table of 256 slots,
+  * indexed by its 8-bit MPipe sequence number.  mpipe_parser() looks up each
+  * response in the table of the interface it came in on, which is a direct
+  * slot lookup, and counts it as matched or unmatched.  Unmatched responses
+  * show sequence drift, so this is done with or without a TX window.
+  *
+  * If the interface has a TX window (mpipe_txwindow_set()), the request
+  * itself is also held in its slot, and the response completes it.  A
+  * request with no response by its deadline is retransmitted, and dropped
+  * once its retries are used up.
+  * While the window is full the worker stops taking new packets off its
+  * queue, so the device is never sent more than window requests at once.
+  * Broadcast packets are never held.
+  */
+#define SUB_TXSLOTS     256
+
+typedef struct {
+    pkt_t*          pkt;        // held request, only with a window
+    struct timespec deadline;
+    int             tries;
+    uint32_t        sequence;   // last request written with this slot
+    bool            expected;   // its response hasn't come back yet
+} sub_txslot_t;
+
+typedef struct {
+    pthread_t       thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    void*           intf;
+    pkt_t**         queue;
+    size_t          mask;
+    size_t          head;
+    size_t          tail;
+    mpipe_txstats_t* stats;     // in the interface, so it can be read live
+    
+    // Outstanding-request table
+    int             window;
+    int             timeout_ms;
+    int             retries;
+    int             inflight;
+    sub_txslot_t    slot[SUB_TXSLOTS];
+} sub_txworker_t;
+
+typedef struct {
+    sub_txworker_t* worker;
+    int             count;
+} sub_txworkers_t;
+
+
+static void sub_txpkt_unref(pkt_t* txpkt) {
+    if (__atomic_sub_fetch(&txpkt->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        pktlist_del(txpkt);
+    }
+}
+
+
+static size_t sub_txstat_inc(size_t* counter) {
+/// Counters are only changed by the worker, with its lock held, but they are
+/// read from other threads.
+    return __atomic_add_fetch(counter, 1, __ATOMIC_RELAXED);
+}
+
+
+static void sub_txqueue_unlock(void* args) {
+    pthread_mutex_unlock(&((sub_txworker_t*)args)->mutex);
+}
+
+
+static void sub_txdeadline(struct timespec* deadline, struct timespec* now, int timeout_ms) {
+    deadline->tv_sec    = now->tv_sec + (timeout_ms / 1000);
+    deadline->tv_nsec   = now->tv_nsec + ((long)(timeout_ms % 1000) * 1000000L);
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+
+static bool sub_txwindow_open(sub_txworker_t* worker) {
+    return (worker->window == 0) || (worker->inflight < worker->window);
+}
+
+
+static void sub_txwindow_hold(sub_txworker_t* worker, pkt_t* txpkt, struct timespec* now) {
+/// Must be called with the worker locked, before the request is written, so
+/// the response cannot beat the request into the table.  Every request is
+/// recorded, and with a window, it's also held.
+    sub_txslot_t* slot;
+    
+    slot            = &worker->slot[txpkt->sequence & (SUB_TXSLOTS-1)];
+    slot->sequence  = txpkt->sequence;
+    slot->expected  = true;
+    
+    if ((worker->window == 0) || (txpkt->intf == NULL)) {
+        return;
+    }
+    if (slot->pkt != NULL) {
+        ///@note The sequence number has wrapped onto a request that is still
+        /// outstanding.  It can no longer be matched, so it is dropped.
+        sub_txstat_inc(&worker->stats->timeouts);
+        worker->inflight--;
+        sub_txpkt_unref(slot->pkt);
+    }
+    
+    __atomic_add_fetch(&txpkt->refs, 1, __ATOMIC_RELAXED);
+    slot->pkt   = txpkt;
+    slot->tries = 1;
+    sub_txdeadline(&slot->deadline, now, worker->timeout_ms);
+    worker->inflight++;
+}
+
+
+static pkt_t* sub_txwindow_due(sub_txworker_t* worker, struct timespec* now, struct timespec* wake) {
+/// Must be called with the worker locked.  Drops requests that are out of
+/// retries and returns the first request due for retransmission, with a
+/// reference taken for the write.  Otherwise returns NULL, and wake is set to
+/// the earliest deadline in the table.
+    bool pending = false;
+    
+    for (int i=0; (i<SUB_TXSLOTS) && (worker->inflight > 0); i++) {
+        sub_txslot_t* slot = &worker->slot[i];
+        
+        if (slot->pkt == NULL) {
+            continue;
+        }
+        if ((slot->deadline.tv_sec > now->tv_sec)
+        || ((slot->deadline.tv_sec == now->tv_sec) && (slot->deadline.tv_nsec > now->tv_nsec))) {
+            if ((pending == false)
+            ||  (slot->deadline.tv_sec < wake->tv_sec)
+            || ((slot->deadline.tv_sec == wake->tv_sec) && (slot->deadline.tv_nsec < wake->tv_nsec))) {
+                *wake   = slot->deadline;
+                pending = true;
+            }
+            continue;
+        }
+        
+        if (slot->tries > worker->retries) {
+            ERR_PRINTF("TX request %u on %s got no response: dropped\n",
+                        slot->pkt->sequence & (SUB_TXSLOTS-1), mpipe_file_resolve(worker->intf));
+            sub_txstat_inc(&worker->stats->timeouts);
+            worker->inflight--;
+            sub_txpkt_unref(slot->pkt);
+            slot->pkt = NULL;
+            continue;
+        }
+        
+        slot->tries++;
+        sub_txdeadline(&slot->deadline, now, worker->timeout_ms);
+        sub_txstat_inc(&worker->stats->retransmits);
+        __atomic_add_fetch(&slot->pkt->refs, 1, __ATOMIC_RELAXED);
+        return slot->pkt;
+    }
+    
+    return NULL;
+}
+
+
+static void sub_txwindow_match(void* intf, uint32_t sequence, uint32_t seqmask) {
+/// Called by mpipe_parser() for each response received on intf.  seqmask
+/// has the sequence bits the response carries: 8 with the legacy header, 32
+/// with the extended header.
+    sub_txworker_t* worker;
+    sub_txslot_t* slot;
+    pkt_t* txpkt = NULL;
+    size_t unmatched = 0;
+    
+    if (intf == NULL) {
+        return;
+    }
+    worker = __atomic_load_n((sub_txworker_t**)&((mpipe_intf_t*)intf)->tx, __ATOMIC_ACQUIRE);
+    if (worker == NULL) {
+        return;
+    }
+    
+    pthread_mutex_lock(&worker->mutex);
+    slot = &worker->slot[sequence & (SUB_TXSLOTS-1)];
+    if (slot->expected && (((slot->sequence ^ sequence) & seqmask) == 0)) {
+        slot->expected = false;
+        sub_txstat_inc(&worker->stats->matched);
+        if (slot->pkt != NULL) {
+            txpkt       = slot->pkt;
+            slot->pkt   = NULL;
+            worker->inflight--;
+            sub_txstat_inc(&worker->stats->completed);
+            pthread_cond_signal(&worker->cond);
+        }
+    }
+    else {
+        unmatched = sub_txstat_inc(&worker->stats->unmatched);
+    }
+    pthread_mutex_unlock(&worker->mutex);
+    
+    if (txpkt != NULL) {
+        sub_txpkt_unref(txpkt);
+    }
+    else if (unmatched != 0) {
+        VERBOSE_PRINTF("Response %u on %s matches no request (%zu unmatched)\n",
+                        sequence & seqmask, mpipe_file_resolve(intf), unmatched);
+    }
+}
+
+
+static void* sub_mpipe_txworker(void* args) {
+    sub_txworker_t* worker = args;
+    struct timespec now;
+    struct timespec wake;
+    pkt_t* txpkt;
+    
+    while (1) {
+        pthread_mutex_lock(&worker->mutex);
+        pthread_cleanup_push(&sub_txqueue_unlock, worker);
+        while (1) {
+            clock_gettime(CLOCK_REALTIME, &now);
+            txpkt = sub_txwindow_due(worker, &now, &wake);
+            if (txpkt != NULL) {
+                break;
+            }
+            if ((worker->head != worker->tail) && sub_txwindow_open(worker)) {
+                txpkt = worker->queue[worker->tail & worker->mask];
+                worker->tail++;
+                sub_txwindow_hold(worker, txpkt, &now);
+                break;
+            }
+            if (worker->inflight > 0) {
+                pthread_cond_timedwait(&worker->cond, &worker->mutex, &wake);
+            }
+            else {
+                pthread_cond_wait(&worker->cond, &worker->mutex);
+            }
+        }
+        pthread_cleanup_pop(1);
+        
+        mpipe_writeto_intf(worker->intf, txpkt->buffer, (int)txpkt->size);
+        
+        //dterm_publish_txstat(dth, DFMT_Native, txpkt->buffer, txpkt->size, 0, txpkt->sequence, txpkt->tstamp);
+        ///@note There is no drain or fixed sleep after the write.
+        /// mpipe_writeto_intf() paces frames from the baudrate, so
+        /// back-to-back frames go out at line rate.  Platforms that need
+        /// idle time between frames should set an inter-frame gap.
+        
+        /// The reference for this write is dropped.  A request held in the
+        /// TX window has its own reference until its response comes back.
+        sub_txpkt_unref(txpkt);
+    }
+    
+    return NULL;
+}
+
+
+static void sub_txworker_push(sub_txworker_t* worker, pkt_t* txpkt) {
+/// The reference for this worker must already be counted in txpkt->refs
+    bool full;
+    
+    pthread_mutex_lock(&worker->mutex);
+    full = ((worker->head - worker->tail) > worker->mask);
+    if (full == false) {
+        worker->queue[worker->head & worker->mask] = txpkt;
+        worker->head++;
+        pthread_cond_signal(&worker->cond);
+    }
+    else {
+        sub_txstat_inc(&worker->stats->dropped);
+    }
+    pthread_mutex_unlock(&worker->mutex);
+    
+    if (full) {
+        ERR_PRINTF("TX queue for %s is full: packet dropped\n", mpipe_file_resolve(worker->intf));
+        sub_txpkt_unref(txpkt);
+    }
+}
+
+
+static void sub_mpipe_txworkers_stop(void* args) {
+/// Cleanup handler for mpipe_writer(): main() only knows the writer thread.
+/// Whatever is still queued is freed along with the tlist.
+    sub_txworkers_t* workers = args;
+
+    for (int i=0; i<workers->count; i++) {
+        __atomic_store_n(&((mpipe_intf_t*)workers->worker[i].intf)->tx, NULL, __ATOMIC_RELEASE);
+        pthread_cancel(workers->worker[i].thread);
+    }
+    for (int i=0; i<workers->count; i++) {
+        pthread_join(workers->worker[i].thread, NULL);
+        pthread_cond_destroy(&workers->worker[i].cond);
+        pthread_mutex_destroy(&workers->worker[i].mutex);
+        free(workers->worker[i].queue);
+    }
+    free(workers->worker);
+}
+
+
+static int sub_mpipe_txworkers_start(sub_txworkers_t* workers, otter_app_t* appdata) {
+    mpipe_handle_t mph = appdata->mpipe;
+    int num_intf = (int)mpipe_numintf_get(mph);
+    size_t depth;
+    
+    // Each queue can hold every packet the tlist can allocate from its ring
+    for (depth=1; depth<appdata->tlist->ring_size; depth<<=1);
+    
+    workers->count  = 0;
+    workers->worker = calloc(num_intf, sizeof(sub_txworker_t));
+    if (workers->worker == NULL) {
+        return -1;
+    }
+    
+    for (int i=0; i<num_intf; i++) {
+        sub_txworker_t* worker = &workers->worker[i];
+        
+        worker->intf    = mpipe_intf_get(mph, i);
+        worker->stats   = &((mpipe_intf_t*)worker->intf)->txstats;
+        worker->mask    = depth - 1;
+        worker->window      = ((mpipe_intf_t*)worker->intf)->tx_window;
+        worker->timeout_ms  = ((mpipe_intf_t*)worker->intf)->tx_timeout_ms;
+        worker->retries     = ((mpipe_intf_t*)worker->intf)->tx_retries;
+        worker->queue   = calloc(depth, sizeof(pkt_t*));
+        if (worker->queue == NULL) {
+            return -2;
+        }
+        if ((pthread_mutex_init(&worker->mutex, NULL) != 0)
+        ||  (pthread_cond_init(&worker->cond, NULL) != 0)) {
+            free(worker->queue);
+            return -3;
+        }
+        if (pthread_create(&worker->thread, NULL, &sub_mpipe_txworker, worker) != 0) {
+            pthread_cond_destroy(&worker->cond);
+            pthread_mutex_destroy(&worker->mutex);
+            free(worker->queue);
+            return -4;
+        }
+        __atomic_store_n(&((mpipe_intf_t*)worker->intf)->tx, (void*)worker, __ATOMIC_RELEASE);
+        workers->count++;
+    }
+    
+    return 0;
+}
+
+
 
 void* mpipe_writer(void* args) {
 /// Thread that:
 /// <LI> Listens for cond-signal from dterm_prompter() indicating that data has
 ///          been added to mpipe.tlist, via a cond-signal. </LI>
-/// <LI> Sends the packet over the TTY. </LI>
+/// <LI> Dispatches the packet to the TX worker of its interface, or to all
+///          of them if it has no interface (broadcast). </LI>
 ///
     otter_app_t* appdata = args;
+    sub_txworkers_t workers;
     pkt_t* txpkt;
     mpipe_handle_t mph;
+    int num_intf;
     int id_i;
     
     if (appdata == NULL) {
         goto mpipe_writer_TERM;
     }
 
-    mph = appdata->mpipe;
+    mph         = appdata->mpipe;
+    num_intf    = (int)mpipe_numintf_get(mph);
+    
+    if (sub_mpipe_txworkers_start(&workers, appdata) != 0) {
+        ERR_PRINTF("MPipe writer workers could not be started: quitting\n");
+        sub_mpipe_txworkers_stop(&workers);
+        goto mpipe_writer_TERM;
+    }
+    
+    pthread_cleanup_push(&sub_mpipe_txworkers_stop, &workers);
 
     while (1) {
         pthread_mutex_lock(appdata->tlist_cond_mutex);
@@ -504,41 +1073,32 @@ void* mpipe_writer(void* args) {
         }
 
         while (1) {
-            txpkt = pktlist_get(appdata->tlist);
+            txpkt = pktlist_take(appdata->tlist);
             if (txpkt == NULL) {
                 break;
             }
 
             if (txpkt->intf == NULL) {
-                id_i = (int)mpipe_numintf_get(mph);
-                while (--id_i >= 0) {
-                    mpipe_writeto_intf(mpipe_intf_get(mph, id_i), txpkt->buffer, (int)txpkt->size);
+                txpkt->refs = num_intf;
+                for (id_i=0; id_i<num_intf; id_i++) {
+                    sub_txworker_push(&workers.worker[id_i], txpkt);
                 }
             }
             else {
                 id_i = mpipe_id_resolve(mph, txpkt->intf);
-                mpipe_writeto_intf(txpkt->intf, txpkt->buffer, (int)txpkt->size);
+                if (id_i < 0) {
+                    pktlist_del(txpkt);
+                    continue;
+                }
+                txpkt->refs = 1;
+                sub_txworker_push(&workers.worker[id_i], txpkt);
             }
-
-            //dterm_publish_txstat(dth, DFMT_Native, txpkt->buffer, txpkt->size, 0, txpkt->sequence, txpkt->tstamp);
-            ///@todo It would be nice to remove this, but it seems necessary for some platforms.
-            usleep(10000);
-
-            ///@note This call to mpipe_flush will block until all the bytes
-            /// are transmitted.  In the special case of txpkt->intf == NULL,
-            /// it will block until all bytes on all interfaces are transmitted
-            /// as long as all interfaces have same baud rate
-            mpipe_flush(mph, id_i, (int)txpkt->size, MPODRAIN);
-
-            ///@todo this deletion should be replaced with punt & sequence 
-            ///      delete, but that is not always working properly.
-#           ifndef _PUNT_AND_PURGE
-            pktlist_del(txpkt);
-#           endif
         }
 
         pthread_mutex_unlock(appdata->tlist_cond_mutex);
     }
+    
+    pthread_cleanup_pop(1);
 
     mpipe_writer_TERM:
     
@@ -551,22 +1111,125 @@ void* mpipe_writer(void* args) {
 
 
 
+static void sub_mpipe_parsepkt(void* ctx, char* putsbuf, pkt_t* rpkt, uint64_t rxaddr) {
+/// Formats one valid packet from the rlist and publishes it, then deletes it.
+/// This runs on the parser thread, or on a parser pool worker, and never
+/// takes the dterm iso_mutex, so it isn't held up by a running command.
+/// subscriber_post() and dterm_publish_rxstat() do their own locking.
+    otter_app_t* appdata = ctx;
+    dterm_handle_t* dth  = appdata->dterm_parent;
+    uint8_t*    payload_front;
+    int         payload_bytes;
+    bool        rpkt_is_valid = false;
+    
+    // Get Payload Bytes, found in buffer[2:3]
+    // Then print-out the payload.
+    // If it is a M2DEF payload, the print-out can be formatted in different ways
+    payload_bytes   = rpkt->buffer[2] * 256;
+    payload_bytes  += rpkt->buffer[3];
+    payload_front   = &rpkt->buffer[6];
+    if (rpkt->session >= 0) {
+        payload_bytes  -= MPIPE_EXTHDR_SIZE;
+        payload_front  += MPIPE_EXTHDR_SIZE;
+    }
+    
+    // Inspect header to see if M2DEF
+    if ((rpkt->crcqual == 0) && ((rpkt->buffer[5] & (1<<7)) == 0)) {
+        rpkt_is_valid = true;
+
+        ///@todo consider any need to deal with fragmentation.  Maybe
+        /// via subscriber module, but a secondary buffer required.
+    }
+    
+    /// - If packet is valid and framing correct, process packet.
+    /// - Else, dump the hex
+    if (rpkt_is_valid && (payload_bytes <= rpkt->size)) {
+    
+        // -----------------------------------------------------------
+        ///@todo Here is where decryption might go, if not handled in pktlist
+        /// there should be an encryption header at payload_front,
+        /// followed by the payload, and then the real data payload.
+        /// The real data payload is followed by a 4 byte Message
+        /// Authentication Check (Crypto-MAC) value.  AES128 EAX is the
+        /// cryptography and cipher used.
+        if (rpkt->buffer[5] & (3<<5)) {
+            // Case with encryption: nothing is done with it yet
+        }
+        // -----------------------------------------------------------
+    
+        while (payload_bytes > 0) {
+            size_t putsbytes    = 0;
+            uint8_t* lastfront  = payload_front;
+            int subsig;
+            int proc_result;
+            bool broadcast;
+
+            /// ALP message:
+            /// proc_result now takes the value from the protocol formatter.
+            /// The formatter will give negative values on framing errors
+            /// and also for protocol errors (i.e. NACKs).
+            proc_result = fmt_fprintalp((uint8_t*)putsbuf, &putsbytes, &payload_front, payload_bytes);
+          
+            /// If processing is bad, we can't rely on framing for this packet
+            if (proc_result < 0) {
+                break;
+            }
+            
+            /// Log data is broadcasted. 
+            ///@todo there should be a better output from fmt_printalp()
+            /// to say if the ALP is broadcast-worthy or not.
+            broadcast = (proc_result == 4);
+
+            /// Successful formatted output gets propagated to any
+            /// subscribers of this ALP ID.
+            subsig = (proc_result >= 0) ? SUBSCR_SIG_OK : SUBSCR_SIG_ERR;
+            subscriber_post(appdata->subscribers, proc_result, subsig, NULL, 0);
+           
+            // Send RXstat message back to control interface.
+            dterm_publish_rxstat(dth, DFMT_Native, putsbuf, putsbytes, broadcast, rxaddr, rpkt->sequence, rpkt->tstamp, rpkt->crcqual);
+            
+            // Recalculate message size following the treatment of the last segment
+            ///@note payload_front should be always greater than lastfront, but it might 
+            ///be mangled if fmt_fprintalp() is buggy
+            if (payload_front < lastfront) {
+                break;
+            }
+            payload_bytes -= (payload_front - lastfront);
+        }
+    }
+    else {
+        size_t putsbytes = 0;
+        payload_front = rpkt->buffer;
+        ///@todo better way to send an error via dterm_publish_rxstat()
+        fmt_printhex((uint8_t*)putsbuf, &putsbytes, &payload_front, rpkt->size, 16);
+        dterm_publish_rxstat(dth, DFMT_Text, putsbuf, putsbytes, false, rxaddr, rpkt->sequence, rpkt->tstamp, rpkt->crcqual);
+    }
+    
+    // Clear the rpkt
+    pktlist_del(rpkt);
+}
+
+
+
 void* mpipe_parser(void* args) {
 ///@todo wait for mpipe_writer() to complete before killing any tlist data.  
 ///      A mutex could work here.
 ///@todo amputate tlist if it gets too big
 
 /// Thread that:
-/// <LI> Waits for cond-sig from mpipe_reader() when new packet(s) exist. </LI>
+/// <LI> Waits on the rlist for mpipe_reader() to post new packet(s). </LI>
 /// <LI> Makes sure the packet is valid. </LI>
-/// <LI> If the packet is encrypted, decrypt it. </LI>
-/// <LI> If the packet is raw, print it out using Hex formatting. </LI>
-/// <LI> If the packet is ALP formatted, do some inspection and attempt to
-///          print it out in a human-readable way. </LI>
+/// <LI> Matches it to its request and learns the device route. </LI>
+/// <LI> Formats and publishes it, or hands it to a parser pool worker that
+///          does, when there is more than one parser thread. </LI>
+///
+/// Formatting is described in sub_mpipe_parsepkt().
 ///
     static char putsbuf[2048];
     otter_app_t* appdata = args;
     dterm_handle_t* dth;
+    parsepool_t pool;
+    int num_parsers;
     
     if (appdata == NULL) {
         goto mpipe_parser_TERM;
@@ -577,6 +1240,22 @@ void* mpipe_parser(void* args) {
         ERR_PRINTF("Error: dterm handle is not linked to dterm_parent in application data.\n");
         goto mpipe_parser_TERM;
     }
+    
+    /// With one parser thread, packets are formatted here, as they always
+    /// have been.  A pool queue can hold every packet the rlist can allocate
+    /// from its ring, the same as the TX worker queues.
+    pool.worker = NULL;
+    pool.count  = 0;
+    num_parsers = cliopt_getparsethreads();
+    if (num_parsers > 1) {
+        if (parsepool_start(&pool, num_parsers, appdata->rlist->ring_size, &sub_mpipe_parsepkt, appdata, sizeof(putsbuf)) != 0) {
+            ERR_PRINTF("MPipe parser workers could not be started: quitting\n");
+            parsepool_stop(&pool);
+            goto mpipe_parser_TERM;
+        }
+    }
+    
+    pthread_cleanup_push(&parsepool_stop, &pool);
 
     // This looks like an infinite loop, but is not.  The pkt_condition
     // variable will break the loop if the rlist has no new packets.
@@ -586,13 +1265,9 @@ void* mpipe_parser(void* args) {
         int pkt_condition;  // tracks some error conditions
         pkt_t*  rpkt;
     
-        pthread_mutex_lock(appdata->pktrx_mutex);
-        appdata->pktrx_cond_inactive = true;
-        while (appdata->pktrx_cond_inactive) {
-            pthread_cond_wait(appdata->pktrx_cond, appdata->pktrx_mutex);
-        }
-        pthread_mutex_lock(dth->iso_mutex);
-        pthread_mutex_unlock(appdata->pktrx_mutex);
+        /// Wakeups are coalesced, so one wakeup may stand for many packets:
+        /// everything in the rlist must be parsed before waiting again.
+        pktlist_wait(appdata->rlist);
         
         /// pktlist_parse will validate the packet with CRC:
         /// - It returns 0 if all is well
@@ -600,10 +1275,9 @@ void* mpipe_parser(void* args) {
         /// - It returns a positive error code if there is some packet error
         /// - rlist->cursor points to the working packet
         while (1) {
-            uint8_t*    payload_front;
-            int         payload_bytes;
             uint64_t    rxaddr;
-            bool        rpkt_is_valid   = false;
+            uint32_t    seqmask;
+            devtab_node_t rxnode;
             
             rpkt = pktlist_parse(&pkt_condition, appdata->rlist);
             if (pkt_condition < 0) {
@@ -619,125 +1293,58 @@ void* mpipe_parser(void* args) {
                 dterm_publish_rxstat(dth, DFMT_Binary, rpkt->buffer, rpkt->size, true, 0, rpkt->sequence, rpkt->tstamp, rpkt->crcqual);
                 
                 pktlist_del(rpkt);
-                
-                ///@todo this packet punting model isn't yet functioning for
-                ///      mpipe.  Currently, TX packet is simply deleted after
-                ///      it is sent. 
-#               ifdef _PUNT_AND_PURGE
-                if (appdata->tlist->front != appdata->tlist->cursor) {
-                    pktlist_punt(appdata->tlist->front);
-                }
-#               endif
-                break;
+                continue;
             }
 
-            ///@todo packet punt and delete on sequence match is not working
-            ///      properly yet.
-            /// Response Packets should match to a sequence number of the last Request.
-            /// If there is no match, then nothing in tlist is deleted.
-            ///      it is sent. 
-#           ifdef _PUNT_AND_PURGE
-            pktlist_del_sequence(appdata->tlist, rpkt->sequence);
-#           endif
-            
-            /// For Mpipe, the address is implicit based on the interface vid
-            ///@todo devtab_get_uid seems to access errant memory when used on NULL intf
-            //rxaddr = devtab_get_uid(appdata->endpoint.devtab, rpkt->intf);
-            rxaddr = 0;
-            
-            // Get Payload Bytes, found in buffer[2:3]
-            // Then print-out the payload.
-            // If it is a M2DEF payload, the print-out can be formatted in different ways
-            payload_bytes   = rpkt->buffer[2] * 256;
-            payload_bytes  += rpkt->buffer[3];
-            
-            // Inspect header to see if M2DEF
-            if ((rpkt->crcqual == 0) && ((rpkt->buffer[5] & (1<<7)) == 0)) {
-                rpkt_is_valid = true;
-
-                ///@todo consider any need to deal with fragmentation.  Maybe
-                /// via subscriber module, but a secondary buffer required.
+            /// A response completes the outstanding request with the same
+            /// sequence number on its interface, if the interface has a TX
+            /// window.  If there is no match, nothing is completed.  Extended
+            /// header responses match on the full 32 bit sequence, and only
+            /// if they are in this instance's session.
+            ///
+            /// For MPipe, the address is implicit: the response says which
+            /// device it is from by the sequence of the request.  This also
+            /// teaches the devtab which interface the device is on.
+            ///
+            /// Logger output isn't a response, and its sequence number is
+            /// the device's own, so it's left out of both.
+            if (rpkt->lowprio || ((rpkt->session >= 0) && (rpkt->session != pktlist_session()))) {
+                seqmask = 0;
             }
-            
-            /// - If packet is valid and framing correct, process packet.
-            /// - Else, dump the hex
-            if (rpkt_is_valid && (payload_bytes <= rpkt->size)) {
-            
-                // -----------------------------------------------------------
-                ///@todo Here is where decryption might go, if not handled in pktlist
-                /// there should be an encryption header at this offset (6),
-                /// followed by the payload, and then the real data payload.
-                /// The real data payload is followed by a 4 byte Message
-                /// Authentication Check (Crypto-MAC) value.  AES128 EAX is the
-                /// cryptography and cipher used.
-                if (rpkt->buffer[5] & (3<<5)) {
-                    // Case with encryption
-                    payload_front = &rpkt->buffer[6];
-                }
-                else {
-                    payload_front = &rpkt->buffer[6];
-                }
-                // -----------------------------------------------------------
-            
-                while (payload_bytes > 0) {
-                    size_t putsbytes    = 0;
-                    uint8_t* lastfront  = payload_front;
-                    int subsig;
-                    int proc_result;
-                    bool broadcast;
-
-                    /// ALP message:
-                    /// proc_result now takes the value from the protocol formatter.
-                    /// The formatter will give negative values on framing errors
-                    /// and also for protocol errors (i.e. NACKs).
-                    proc_result = fmt_fprintalp((uint8_t*)putsbuf, &putsbytes, &payload_front, payload_bytes);
-                  
-                    /// If processing is bad, we can't rely on framing for this packet
-                    if (proc_result < 0) {
-                        break;
-                    }
-                    
-                    /// Log data is broadcasted. 
-                    ///@todo there should be a better output from fmt_printalp()
-                    /// to say if the ALP is broadcast-worthy or not.
-                    broadcast = (proc_result == 4);
-
-                    /// Successful formatted output gets propagated to any
-                    /// subscribers of this ALP ID.
-                    subsig = (proc_result >= 0) ? SUBSCR_SIG_OK : SUBSCR_SIG_ERR;
-                    subscriber_post(appdata->subscribers, proc_result, subsig, NULL, 0);
-                   
-                    // Send RXstat message back to control interface.
-                    dterm_publish_rxstat(dth, DFMT_Native, putsbuf, putsbytes, broadcast, rxaddr, rpkt->sequence, rpkt->tstamp, rpkt->crcqual);
-                    
-                    // Recalculate message size following the treatment of the last segment
-                    ///@note payload_front should be always greater than lastfront, but it might 
-                    ///be mangled if fmt_fprintalp() is buggy
-                    if (payload_front < lastfront) {
-                        break;
-                    }
-                    payload_bytes -= (payload_front - lastfront);
-                }
+            else if (rpkt->session < 0) {
+                seqmask = 0xFF;
             }
             else {
-                size_t putsbytes = 0;
-                payload_front = rpkt->buffer;
-                ///@todo better way to send an error via dterm_publish_rxstat()
-                fmt_printhex((uint8_t*)putsbuf, &putsbytes, &payload_front, rpkt->size, 16);
-                dterm_publish_rxstat(dth, DFMT_Text, putsbuf, putsbytes, false, rxaddr, rpkt->sequence, rpkt->tstamp, rpkt->crcqual);
+                seqmask = 0xFFFFFFFF;
+            }
+            rxnode = NULL;
+            if (seqmask != 0) {
+                sub_txwindow_match(rpkt->intf, rpkt->sequence, seqmask);
+                rxnode = devtab_route_learn(appdata->endpoint.devtab, rpkt->intf, rpkt->sequence, seqmask);
             }
+            rxaddr = devtab_get_uid(appdata->endpoint.devtab, rxnode);
             
-            // Clear the rpkt
-            pktlist_del(rpkt);
+            /// The packet leaves the rlist when it goes to a pool worker, so
+            /// it can't be dropped on overflow while the worker has it.
+            /// Workers are picked by interface only: rxaddr is unknown for
+            /// anything but matched responses, so keying on it would split
+            /// one device's frames across workers and reorder them.
+            if (pool.count > 0) {
+                pktlist_detach(rpkt);
+                parsepool_dispatch(&pool, rpkt, rxaddr, 0);
+            }
+            else {
+                sub_mpipe_parsepkt(appdata, putsbuf, rpkt, rxaddr);
+            }
         } 
         
-        pthread_mutex_unlock(dth->iso_mutex);
-        
         ///@todo Can check for major error in pkt_condition
         ///      Major errors are integers less than -1
         
     } // END OF WHILE()
     
+    pthread_cleanup_pop(1);
+    
     mpipe_parser_TERM:
     
     /// This code should never occur, given the while(1) loop.
@@ -747,3 +1354,7 @@ void* mpipe_parser(void* args) {
     return NULL;
 }
 
+
+
+
+#endif  // OTTER_FEATURE_MPIPE
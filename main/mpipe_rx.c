@@ -0,0 +1,392 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+#include "otter_cfg.h"
+#if (OTTER_FEATURE_MPIPE == ENABLED)
+
+// Application Includes
+#include "crc_calc_block.h"
+#include "debug.h"
+#include "mpipe_rx.h"
+#include "otter_cfg.h"
+
+// Standard C & POSIX libraries
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#   define _SYNC_X86
+#   include <immintrin.h>
+#endif
+
+
+#define _RINGMASK   (OTTER_PARAM_MPRXRING - 1)
+
+
+
+static int64_t sub_diffms(struct timespec* start, struct timespec* end) {
+    int64_t result;
+
+    result  = ((int64_t)(end->tv_sec - start->tv_sec)) * 1000;
+    result += ((int64_t)(end->tv_nsec - start->tv_nsec)) / 1000000;
+
+    return result;
+}
+
+
+/** FF55 Sync Scanners <BR>
+  * ========================================================================<BR>
+  * All scanners return the offset of the first FF that is followed by 55, or
+  * the length of the buffer if there is no such pair.  The vector versions
+  * compare the buffer against itself shifted by one byte, so each iteration
+  * tests 16 or 32 candidate pairs.  They hand off the tail to the scalar one.
+  */
+static size_t sub_findsync_scalar(const uint8_t* buf, size_t len) {
+    const uint8_t* cursor   = buf;
+    const uint8_t* end      = buf + len;
+
+    while ((cursor = memchr(cursor, 0xFF, (size_t)(end - cursor))) != NULL) {
+        if ((cursor + 1) >= end) {
+            break;
+        }
+        if (cursor[1] == 0x55) {
+            return (size_t)(cursor - buf);
+        }
+        cursor++;
+    }
+    return len;
+}
+
+#if defined(_SYNC_X86) && defined(__SSE2__)
+static size_t sub_findsync_sse2(const uint8_t* buf, size_t len) {
+    const __m128i sync0 = _mm_set1_epi8((char)0xFF);
+    const __m128i sync1 = _mm_set1_epi8(0x55);
+    size_t i = 0;
+
+    for (; (i+17) <= len; i+=16) {
+        __m128i a   = _mm_loadu_si128((const __m128i*)&buf[i]);
+        __m128i b   = _mm_loadu_si128((const __m128i*)&buf[i+1]);
+        int mask    = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, sync0), _mm_cmpeq_epi8(b, sync1)));
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz((unsigned int)mask);
+        }
+    }
+    return i + sub_findsync_scalar(&buf[i], len-i);
+}
+#endif
+
+#if defined(_SYNC_X86)
+__attribute__((target("avx2")))
+static size_t sub_findsync_avx2(const uint8_t* buf, size_t len) {
+    const __m256i sync0 = _mm256_set1_epi8((char)0xFF);
+    const __m256i sync1 = _mm256_set1_epi8(0x55);
+    size_t i = 0;
+
+    for (; (i+33) <= len; i+=32) {
+        __m256i a   = _mm256_loadu_si256((const __m256i*)&buf[i]);
+        __m256i b   = _mm256_loadu_si256((const __m256i*)&buf[i+1]);
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, sync0), _mm256_cmpeq_epi8(b, sync1)));
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return i + sub_findsync_scalar(&buf[i], len-i);
+}
+#endif
+
+
+static size_t sub_findsync_resolve(const uint8_t* buf, size_t len);
+static size_t (*sub_findsync)(const uint8_t*, size_t) = &sub_findsync_resolve;
+
+static size_t sub_findsync_resolve(const uint8_t* buf, size_t len) {
+/// Runs once, on first use, to pick the best scanner for this CPU.  The race
+/// between reader threads is harmless: each writes the same value.
+    size_t (*scanner)(const uint8_t*, size_t) = &sub_findsync_scalar;
+
+#   if defined(_SYNC_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scanner = &sub_findsync_avx2;
+    }
+#   if defined(__SSE2__)
+    else {
+        scanner = &sub_findsync_sse2;
+    }
+#   endif
+#   endif
+
+    sub_findsync = scanner;
+    return scanner(buf, len);
+}
+
+
+size_t mpipe_rx_findsync(const uint8_t* buf, size_t len) {
+    if ((buf == NULL) || (len < 2)) {
+        return len;
+    }
+    return sub_findsync(buf, len);
+}
+
+
+
+
+static size_t sub_contiguous(mpipe_rx_t* rx) {
+/// Returns the number of unread bytes that sit contiguously in the ring,
+/// starting at the tail.
+    size_t avail    = rx->head - rx->tail;
+    size_t to_end   = OTTER_PARAM_MPRXRING - (rx->tail & _RINGMASK);
+
+    return (avail < to_end) ? avail : to_end;
+}
+
+
+
+
+
+static void sub_droplease(mpipe_rx_t* rx) {
+    if (rx->lease != NULL) {
+        if (rx->release_fn != NULL) {
+            rx->release_fn(rx->lease);
+        }
+        rx->lease = NULL;
+    }
+    rx->frame = rx->spare;
+}
+
+
+
+
+void mpipe_rx_init(mpipe_rx_t* rx, int timeout_ms) {
+    if (rx != NULL) {
+        rx->timeout_ms  = timeout_ms;
+        rx->lease       = NULL;
+        rx->lease_ctx   = NULL;
+        rx->lease_fn    = NULL;
+        rx->release_fn  = NULL;
+        rx->frame       = rx->spare;
+        mpipe_rx_reset(rx);
+    }
+}
+
+
+void mpipe_rx_setlease(mpipe_rx_t* rx, mpipe_rx_leasefn_t lease_fn, mpipe_rx_releasefn_t release_fn, void* ctx) {
+    if (rx != NULL) {
+        sub_droplease(rx);
+        rx->lease_fn    = lease_fn;
+        rx->release_fn  = release_fn;
+        rx->lease_ctx   = ctx;
+    }
+}
+
+
+void mpipe_rx_reset(mpipe_rx_t* rx) {
+    if (rx != NULL) {
+        sub_droplease(rx);
+        rx->head            = 0;
+        rx->tail            = 0;
+        rx->state           = MPIPE_RX_SYNC0;
+        rx->expired         = false;
+        rx->frame_cursor    = 0;
+        rx->frame_left      = 0;
+        rx->lastrx.tv_sec   = 0;
+        rx->lastrx.tv_nsec  = 0;
+    }
+}
+
+
+int mpipe_rx_fill(mpipe_rx_t* rx, int fd) {
+    struct iovec iov[2];
+    struct timespec now;
+    size_t room;
+    size_t index;
+    int new_bytes;
+
+    // The ring should never be full, because the reader drains it after each
+    // fill.  If it somehow is, the unread contents are stale and get dumped.
+    room = OTTER_PARAM_MPRXRING - (rx->head - rx->tail);
+    if (room == 0) {
+        rx->tail    = rx->head;
+        rx->state   = MPIPE_RX_SYNC0;
+        room        = OTTER_PARAM_MPRXRING;
+    }
+
+    // Read into the free region of the ring, which may wrap-around.
+    index           = rx->head & _RINGMASK;
+    iov[0].iov_base = &rx->ring[index];
+    iov[0].iov_len  = OTTER_PARAM_MPRXRING - index;
+    if (iov[0].iov_len > room) {
+        iov[0].iov_len = room;
+    }
+    iov[1].iov_base = rx->ring;
+    iov[1].iov_len  = room - iov[0].iov_len;
+
+    new_bytes = (int)readv(fd, iov, (iov[1].iov_len != 0) ? 2 : 1);
+    if (new_bytes <= 0) {
+        return new_bytes;
+    }
+
+    // Inter-byte timeout is handled by timestamp: if a frame was in progress
+    // and the line went quiet for too long, the partial frame is junk.
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if ((rx->state != MPIPE_RX_SYNC0) && (sub_diffms(&rx->lastrx, &now) > rx->timeout_ms)) {
+        sub_droplease(rx);
+        rx->state   = MPIPE_RX_SYNC0;
+        rx->expired = true;
+    }
+    rx->lastrx  = now;
+    rx->head   += new_bytes;
+
+    HEX_DUMP(&rx->ring[index], (iov[0].iov_len < (size_t)new_bytes) ? (int)iov[0].iov_len : new_bytes, "read(%d): ", new_bytes);
+
+    return new_bytes;
+}
+
+
+int mpipe_rx_getframe(mpipe_rx_t* rx, uint8_t** frame, size_t* frame_size, void** lease) {
+    uint8_t* span;
+    size_t span_len;
+    size_t copy_len;
+    int payload_length;
+
+    if (rx->expired) {
+        rx->expired = false;
+        return 4;
+    }
+
+    while (rx->head != rx->tail) {
+        span        = &rx->ring[rx->tail & _RINGMASK];
+        span_len    = sub_contiguous(rx);
+
+        switch (rx->state) {
+            // Scan for FF55 across the whole span.  If the span ends with FF,
+            // the 55 may be at the front of the next span (or next read).
+            case MPIPE_RX_SYNC0: {
+                size_t offset = mpipe_rx_findsync(span, span_len);
+                if (offset < span_len) {
+                    TTY_PRINTF("Sync FF55 Received\n");
+                    rx->tail           += offset + 2;
+                    rx->state           = MPIPE_RX_HEADER;
+                    rx->frame_cursor    = 0;
+                    rx->frame_left      = MPIPE_RX_HDRSIZE;
+                }
+                else {
+                    rx->tail += span_len;
+                    if (span[span_len-1] == 0xFF) {
+                        rx->state = MPIPE_RX_SYNC1;
+                    }
+                }
+            } break;
+
+            // Now wait for a 55, ignoring FFs
+            case MPIPE_RX_SYNC1:
+                rx->tail++;
+                if (span[0] == 0x55) {
+                    TTY_PRINTF("Sync FF55 Received\n");
+                    rx->state           = MPIPE_RX_HEADER;
+                    rx->frame_cursor    = 0;
+                    rx->frame_left      = MPIPE_RX_HDRSIZE;
+                }
+                else if (span[0] != 0xFF) {
+                    rx->state = MPIPE_RX_SYNC0;
+                }
+                break;
+
+            // Header (6 bytes) and Payload (N bytes) are bulk copied
+            case MPIPE_RX_HEADER:
+            case MPIPE_RX_PAYLOAD:
+                copy_len = (span_len < rx->frame_left) ? span_len : rx->frame_left;
+                memcpy(&rx->frame[rx->frame_cursor], span, copy_len);
+                if (rx->state == MPIPE_RX_PAYLOAD) {
+                    rx->crc = crc_calc_partial(rx->crc, &rx->frame[rx->frame_cursor], copy_len);
+                }
+                rx->tail           += copy_len;
+                rx->frame_cursor   += copy_len;
+                rx->frame_left     -= copy_len;
+
+                if (rx->frame_left != 0) {
+                    break;
+                }
+
+                if (rx->state == MPIPE_RX_HEADER) {
+                    /// Bytes 2:3 are the Length of the Payload, in big endian.
+                    /// Malformed lengths send the decoder back to sync search.
+                    ///@todo Make header length dynamic based on control field
+                    payload_length  = rx->frame[2] * 256;
+                    payload_length += rx->frame[3];
+                    if ((payload_length == 0) \
+                    || (payload_length > (MPIPE_RX_FRAMEMAX-MPIPE_RX_HDRSIZE))) {
+                        rx->state = MPIPE_RX_SYNC0;
+                        return 2;
+                    }
+                    rx->state       = MPIPE_RX_PAYLOAD;
+                    rx->frame_left  = (size_t)payload_length;
+                    rx->crc         = crc_calc_partial(CRC_CALC_INIT, &rx->frame[2], MPIPE_RX_HDRSIZE-2);
+                    
+                    // Now that the frame size is known, lease a buffer for it
+                    // and carry the header over.  Payload goes directly in.
+                    if (rx->lease_fn != NULL) {
+                        uint8_t* buf = rx->lease_fn(rx->lease_ctx, MPIPE_RX_HDRSIZE+rx->frame_left, &rx->lease);
+                        if (buf != NULL) {
+                            memcpy(buf, rx->spare, MPIPE_RX_HDRSIZE);
+                            rx->frame = buf;
+                        }
+                        else {
+                            rx->lease = NULL;
+                        }
+                    }
+                    break;
+                }
+
+                // Frame is complete.  Bytes 0:1 are the CRC16, big endian.
+                // A bad frame is dropped here, so it never takes up space in
+                // the rlist.  The decoder is already back in sync search.
+                rx->state   = MPIPE_RX_SYNC0;
+                if (rx->crc != ((rx->frame[0] << 8) | rx->frame[1])) {
+                    TTY_PRINTF("CRC16 mismatch: frame=%04X computed=%04X\n", (rx->frame[0] << 8) | rx->frame[1], rx->crc);
+                    sub_droplease(rx);
+                    return 3;
+                }
+                
+                // If the frame went into the lease, the lease goes out with it.
+                *frame      = rx->frame;
+                *frame_size = rx->frame_cursor;
+                *lease      = rx->lease;
+                rx->lease   = NULL;
+                rx->frame   = rx->spare;
+                return 0;
+
+            default:
+                rx->state = MPIPE_RX_SYNC0;
+                break;
+        }
+    }
+
+    // Everything is consumed: rebase the counters so the ring reads are as
+    // large as possible on the next fill.
+    rx->head = 0;
+    rx->tail = 0;
+    return -1;
+}
+
+
+
+
+#endif  // OTTER_FEATURE_MPIPE
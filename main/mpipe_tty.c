@@ -0,0 +1,105 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+
+///@note This file must not include <termios.h>.  On Linux, the termios2
+/// interface comes from <asm/termbits.h>, which redefines struct termios
+/// and the termios flags, so it can't share a translation unit with libc's.
+
+// Application Includes
+#include "mpipe_tty.h"
+
+#if (MPIPE_TTY_ANYBAUD || MPIPE_TTY_ICOUNT || MPIPE_TTY_LOWLATENCY)
+#   include <asm/ioctls.h>
+#   include <asm/termbits.h>
+#   include <linux/serial.h>
+    // <sys/ioctl.h> pulls in libc termios definitions too
+    extern int ioctl(int fd, unsigned long request, ...);
+#endif
+
+
+
+int mpipe_tty_setbps(int fd, int bps) {
+#if (MPIPE_TTY_ANYBAUD)
+/// The driver picks the nearest rate its clock can make, which for USB-UART
+/// bridges can be a few percent off.  The rate read back is what it chose.
+    struct termios2 tio2;
+    
+    if (bps <= 0) {
+        return -1;
+    }
+    if (ioctl(fd, TCGETS2, &tio2) != 0) {
+        return -2;
+    }
+    
+    tio2.c_cflag   &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tio2.c_cflag   |= BOTHER | (BOTHER << IBSHIFT);
+    tio2.c_ispeed   = (speed_t)bps;
+    tio2.c_ospeed   = (speed_t)bps;
+    
+    if (ioctl(fd, TCSETS2, &tio2) != 0) {
+        return -3;
+    }
+    if (ioctl(fd, TCGETS2, &tio2) != 0) {
+        return -2;
+    }
+    
+    return (tio2.c_ospeed != 0) ? (int)tio2.c_ospeed : bps;
+
+#else
+    return -1;
+    
+#endif
+}
+
+
+long mpipe_tty_overruns(int fd) {
+#if (MPIPE_TTY_ICOUNT)
+    struct serial_icounter_struct icount;
+    
+    if (ioctl(fd, TIOCGICOUNT, &icount) != 0) {
+        return -1;
+    }
+    return (long)icount.overrun + (long)icount.buf_overrun;
+
+#else
+    return -1;
+    
+#endif
+}
+
+
+int mpipe_tty_lowlatency(int fd, int enable) {
+#if (MPIPE_TTY_LOWLATENCY)
+    struct serial_struct serinfo;
+    
+    if (ioctl(fd, TIOCGSERIAL, &serinfo) != 0) {
+        return -1;
+    }
+    if (enable) serinfo.flags |= ASYNC_LOW_LATENCY;
+    else        serinfo.flags &= ~ASYNC_LOW_LATENCY;
+    
+    if (ioctl(fd, TIOCSSERIAL, &serinfo) != 0) {
+        return -2;
+    }
+    return 0;
+    
+#else
+    return -1;
+    
+#endif
+}
+
@@ -0,0 +1,169 @@
+/* Copyright 2014, JP Norair
+  *
+  * Licensed under the OpenTag License, Version 1.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  * http://www.indigresso.com/wiki/doku.php?id=opentag:license_1_0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  */
+
+// Application Includes
+#include "parsepool.h"
+
+// Standard C & POSIX libraries
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+
+
+static void sub_queue_unlock(void* args) {
+    pthread_mutex_unlock(&((parsepool_worker_t*)args)->mutex);
+}
+
+
+static parsepool_worker_t* sub_shard(parsepool_t* pool, void* intf, uint64_t key) {
+/// Key 0 keeps all packets of the interface in order on one worker
+    uint64_t h;
+    h   = ((uint64_t)(uintptr_t)intf >> 4) ^ key;
+    h  *= 0x9E3779B97F4A7C15ULL;
+    return &pool->worker[(h >> 32) % (uint64_t)pool->count];
+}
+
+
+static void* sub_parsepool_worker(void* args) {
+    parsepool_worker_t* worker  = args;
+    parsepool_t* pool           = worker->pool;
+    parsepool_job_t job;
+    int cancelstate;
+    
+    while (1) {
+        pthread_mutex_lock(&worker->mutex);
+        pthread_cleanup_push(&sub_queue_unlock, worker);
+        while (worker->head == worker->tail) {
+            pthread_cond_wait(&worker->cond, &worker->mutex);
+        }
+        job = worker->queue[worker->tail & worker->mask];
+        worker->tail++;
+        pthread_cond_signal(&worker->space_cond);
+        pthread_cleanup_pop(1);
+        
+        /// A packet is always processed to the end, so the worker is never
+        /// cancelled while it holds a lock taken inside fn.
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancelstate);
+        pool->fn(pool->ctx, worker->putsbuf, job.pkt, job.rxaddr);
+        pthread_setcancelstate(cancelstate, NULL);
+    }
+    
+    return NULL;
+}
+
+
+
+int parsepool_start(parsepool_t* pool, int workers, size_t depth, parsepool_fn_t fn, void* ctx, size_t bufsize) {
+    size_t qsize;
+    
+    if ((pool == NULL) || (workers <= 0) || (fn == NULL)) {
+        return -1;
+    }
+    for (qsize=1; qsize<depth; qsize<<=1);
+    
+    pool->count     = 0;
+    pool->fn        = fn;
+    pool->ctx       = ctx;
+    pool->worker    = calloc(workers, sizeof(parsepool_worker_t));
+    if (pool->worker == NULL) {
+        return -2;
+    }
+    
+    for (int i=0; i<workers; i++) {
+        parsepool_worker_t* worker = &pool->worker[i];
+        
+        worker->pool    = pool;
+        worker->mask    = qsize - 1;
+        worker->queue   = calloc(qsize, sizeof(parsepool_job_t));
+        worker->putsbuf = malloc(bufsize);
+        if ((worker->queue == NULL) || (worker->putsbuf == NULL)) {
+            goto parsepool_start_ERR;
+        }
+        if (pthread_mutex_init(&worker->mutex, NULL) != 0) {
+            goto parsepool_start_ERR;
+        }
+        if ((pthread_cond_init(&worker->cond, NULL) != 0)
+        ||  (pthread_cond_init(&worker->space_cond, NULL) != 0)) {
+            pthread_cond_destroy(&worker->cond);
+            pthread_mutex_destroy(&worker->mutex);
+            goto parsepool_start_ERR;
+        }
+        if (pthread_create(&worker->thread, NULL, &sub_parsepool_worker, worker) != 0) {
+            pthread_cond_destroy(&worker->space_cond);
+            pthread_cond_destroy(&worker->cond);
+            pthread_mutex_destroy(&worker->mutex);
+            goto parsepool_start_ERR;
+        }
+        pool->count++;
+    }
+    
+    return 0;
+    
+    parsepool_start_ERR:
+    free(pool->worker[pool->count].putsbuf);
+    free(pool->worker[pool->count].queue);
+    return -3;
+}
+
+
+
+void parsepool_stop(void* args) {
+    parsepool_t* pool = args;
+    
+    if ((pool == NULL) || (pool->worker == NULL)) {
+        return;
+    }
+    for (int i=0; i<pool->count; i++) {
+        pthread_cancel(pool->worker[i].thread);
+    }
+    for (int i=0; i<pool->count; i++) {
+        parsepool_worker_t* worker = &pool->worker[i];
+        
+        pthread_join(worker->thread, NULL);
+        while (worker->tail != worker->head) {
+            pktlist_del(worker->queue[worker->tail & worker->mask].pkt);
+            worker->tail++;
+        }
+        pthread_cond_destroy(&worker->space_cond);
+        pthread_cond_destroy(&worker->cond);
+        pthread_mutex_destroy(&worker->mutex);
+        free(worker->putsbuf);
+        free(worker->queue);
+    }
+    free(pool->worker);
+    pool->worker    = NULL;
+    pool->count     = 0;
+}
+
+
+
+void parsepool_dispatch(parsepool_t* pool, pkt_t* rpkt, uint64_t rxaddr, uint64_t key) {
+    parsepool_worker_t* worker = sub_shard(pool, rpkt->intf, key);
+    
+    pthread_mutex_lock(&worker->mutex);
+    pthread_cleanup_push(&sub_queue_unlock, worker);
+    while ((worker->head - worker->tail) > worker->mask) {
+        pthread_cond_wait(&worker->space_cond, &worker->mutex);
+    }
+    worker->queue[worker->head & worker->mask].pkt      = rpkt;
+    worker->queue[worker->head & worker->mask].rxaddr   = rxaddr;
+    worker->head++;
+    pthread_cond_signal(&worker->cond);
+    pthread_cleanup_pop(1);
+}
@@ -7,22 +7,51 @@
 //
 
 #include "devtable.h"
+#include "mpipe.h"
 #include "pktlist.h"
 #include "cliopt.h"
 #include "debug.h"
 #include "user.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
+#include <unistd.h>
 #include <talloc.h>
 
+#if defined(__linux__)
+#   include <sys/eventfd.h>
+#endif
+
 #include "crc_calc_block.h"
 
 
-///@todo Make pktlist a circular array (possibly via talloc arrays) in order
-///      to reduce amount of allocations at runtime.
+/// pktlist storage is a fixed-capacity ring of packet slots, sized to the
+/// list depth plus OTTER_PARAM_PKTRESERVE, and buffer slabs in two size
+/// classes.  Everything is allocated in pktlist_init().  Slots are handed out
+/// in ring order, which is O(1) for the usual FIFO traffic.  The packets are
+/// still linked in list order, so deletion from the middle and punting work
+/// as they always have.  If the ring or slabs run dry, the packet or buffer
+/// is allocated individually, so nothing fails that didn't fail before.
+/// Those packets are counted in alloc_fallback, since steady-state traffic
+/// should never need them.
+///
+/// RX producers can post to their own inbox, a single-producer/single-
+/// consumer ring of packet pointers, instead of adding to the list.  Posting
+/// takes no mutex.  pktlist_parse() moves inbox packets into the list before
+/// it takes the next one, and that is where the overflow policy is applied
+/// to them, so max is the RX depth whichever way packets come in.
+///
+/// The ring holds max packets, plus one and OTTER_PARAM_PKTRESERVE for
+/// packets that are leased or being parsed.  If it runs out, the policy is
+/// applied then too, and only if nothing can be dropped does the packet get
+/// allocated outside the ring (alloc_fallback).
+
+/// Session number for MPipe extended headers, set by the first pktlist_init()
+static int sub_session = -1;
 
 
 
@@ -36,12 +65,106 @@ static void sub_pktlist_clear(pktlist_t* plist) {
     plist->size     = 0;
 }
 
+
+
+static int sub_pktlist_reclaim(pktlist_t* plist);
+
+static pkt_t* sub_slotalloc(pktlist_t* plist) {
+/// Finds the next free slot in the ring.  It's taken once its parent is set.
+    for (size_t n=0; n<plist->ring_size; n++) {
+        size_t i = plist->ring_next;
+        plist->ring_next = (i+1 == plist->ring_size) ? 0 : i+1;
+        if (plist->ring[i].parent == NULL) {
+            return &plist->ring[i];
+        }
+    }
+    return NULL;
+}
+
+static pkt_t* sub_pktalloc(pktlist_t* plist, size_t bufsize) {
+/// Must be called with the plist mutex held.  If the ring is exhausted, the
+/// list policy decides whether the packet is refused.
+    pkt_t* pkt;
+    bool fallback = false;
+    int c;
+
+    pkt = sub_slotalloc(plist);
+    if (pkt == NULL) {
+        if (sub_pktlist_reclaim(plist) != 0) {
+            return NULL;
+        }
+        pkt = sub_slotalloc(plist);
+    }
+    if (pkt == NULL) {
+        pkt = talloc_size(plist, sizeof(pkt_t));
+        if (pkt == NULL) {
+            return NULL;
+        }
+        pkt->slot = -1;
+        fallback  = true;
+    }
+
+    // Take a buffer from the smallest class that fits
+    for (c=0; c<PKTLIST_NUMCLASSES; c++) {
+        pktslab_t* slab = &plist->slab[c];
+        if ((bufsize <= slab->bufsize) && (slab->free_count != 0)) {
+            slab->free_count--;
+            pkt->buffer     = &slab->base[slab->free_stack[slab->free_count] * slab->bufsize];
+            pkt->bufsize    = slab->bufsize;
+            pkt->sizeclass  = c;
+            break;
+        }
+    }
+    if (c == PKTLIST_NUMCLASSES) {
+        pkt->buffer = talloc_size(plist, bufsize);
+        if (pkt->buffer == NULL) {
+            if (pkt->slot < 0) {
+                talloc_free(pkt);
+            }
+            return NULL;
+        }
+        pkt->bufsize    = bufsize;
+        pkt->sizeclass  = -1;
+        fallback        = true;
+    }
+
+    if (fallback) {
+        plist->alloc_fallback++;
+    }
+    pkt->parent = plist;
+    return pkt;
+}
+
+static void sub_pktfree(pktlist_t* plist, pkt_t* pkt) {
+/// Must be called with the plist mutex held
+    if (pkt->sizeclass >= 0) {
+        pktslab_t* slab = &plist->slab[pkt->sizeclass];
+        slab->free_stack[slab->free_count++] = (uint16_t)((pkt->buffer - slab->base) / slab->bufsize);
+    }
+    else {
+        talloc_free(pkt->buffer);
+    }
+    pkt->buffer = NULL;
+    pkt->parent = NULL;
+    
+    if (pkt->slot < 0) {
+        talloc_free(pkt);
+    }
+    
+    // Producers may be waiting for a slot, or for room in the list
+    if (plist->policy == PKTLIST_BLOCK) {
+        pthread_cond_broadcast(&plist->space_cond);
+    }
+}
+
+
+
 static void sub_pktlist_empty(pktlist_t* plist) {
     pkt_t* pkt = plist->front;
 
     while (pkt != NULL) {
         pkt_t* next_pkt = pkt->next;
-        talloc_free(pkt);
+        sub_pktfree(plist, pkt);
         pkt = next_pkt;
     }
 }
@@ -75,11 +198,30 @@ static void sub_unlinkpkt(pktlist_t* plist, pkt_t* pkt) {
 
 
 
+static void sub_detachpkt(pktlist_t* plist, pkt_t* pkt) {
+    sub_unlinkpkt(plist, pkt);
+    pkt->prev = NULL;
+    pkt->next = NULL;
+    if (--plist->size == 0) {
+        sub_pktlist_clear(plist);
+    }
+    if (plist->policy == PKTLIST_BLOCK) {
+        pthread_cond_broadcast(&plist->space_cond);
+    }
+}
+
+
+
 static void sub_delpkt(pktlist_t* plist, pkt_t* pkt) {
+    // Detached packets are not linked into the list anymore
+    if ((pkt->prev == NULL) && (plist->front != pkt)) {
+        sub_pktfree(plist, pkt);
+        return;
+    }
     if (plist->size > 0) {
         sub_unlinkpkt(plist, pkt);
-        talloc_free(pkt);
         plist->size--;
+        sub_pktfree(plist, pkt);
     }
     if (plist->size <= 0) {
         sub_pktlist_clear(plist);
@@ -88,11 +230,81 @@ static void sub_delpkt(pktlist_t* plist, pkt_t* pkt) {
 
 
 
-static void sub_frame_null(user_endpoint_t* endpoint, pkt_t* newpkt, uint8_t* data, size_t datalen) {
-    memcpy(&newpkt->buffer[0], data, datalen);
+static int sub_bell_open(pktlist_t* plist) {
+#if defined(__linux__)
+    plist->bell_fd[0] = eventfd(0, EFD_CLOEXEC);
+    plist->bell_fd[1] = plist->bell_fd[0];
+    return (plist->bell_fd[0] < 0) ? -1 : 0;
+#else
+    if (pipe(plist->bell_fd) != 0) {
+        plist->bell_fd[0] = -1;
+        plist->bell_fd[1] = -1;
+        return -1;
+    }
+    fcntl(plist->bell_fd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(plist->bell_fd[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+#endif
 }
 
+static void sub_bell_close(pktlist_t* plist) {
+    if (plist->bell_fd[0] >= 0) {
+        close(plist->bell_fd[0]);
+    }
+    if ((plist->bell_fd[1] >= 0) && (plist->bell_fd[1] != plist->bell_fd[0])) {
+        close(plist->bell_fd[1]);
+    }
+}
+
+static void sub_bell_ring(pktlist_t* plist) {
+/// Only the first ring after the consumer wakes up goes to the kernel.  The
+/// consumer clears bell_pending (with an exchange, so it synchronizes with
+/// this one) before it starts parsing, so anything posted before a skipped
+/// write is guaranteed to be seen by that parse.
+    if (__atomic_exchange_n(&plist->bell_pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        uint64_t one = 1;
+        ssize_t rc;
+        do {
+            rc = write(plist->bell_fd[1], &one, (plist->bell_fd[0] == plist->bell_fd[1]) ? 8 : 1);
+        } while ((rc < 0) && (errno == EINTR));
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 
+/** Framing Ops <BR>
+  * ========================================================================<BR>
+  * Each protocol supplies a table of framing ops.  The table is resolved
+  * once, in pktlist_init(), from the IO type.  When only one protocol is
+  * compiled in, SUB_FRAMING is the address of that protocol's constant table,
+  * so every call through it is a direct call, and the other protocol's code
+  * is not compiled at all.
+  */
+typedef struct {
+    size_t  tx_overhead;    // max bytes write_frame() + write_footer() add
+    void    (*write_frame)(user_endpoint_t*, pkt_t*, uint8_t*, size_t);
+    void    (*write_footer)(pkt_t*);
+    void    (*read_frame)(user_endpoint_t*, pkt_t*, uint8_t*, size_t);
+    void    (*qualify)(pkt_t*);
+    bool    (*lowprio)(pkt_t*);
+} sub_framing_t;
+
+
+#if (OTTER_FEATURE_MODBUS == ENABLED)
 static void sub_readframe_modbus(user_endpoint_t* endpoint, pkt_t* newpkt, uint8_t* data, size_t datalen) {
 /// Modbus read process will remove the encrypted data
     int         mbcmd       = (data[1] & 255);
@@ -237,23 +449,72 @@ static void sub_writeframe_modbus(user_endpoint_t* endpoint, pkt_t* newpkt, uint
 }
 
 
+static void sub_writefooter_modbus(pkt_t* newpkt) {
+/// Adds two bytes to packet
+    size_t crcpos               = newpkt->size;
+    uint16_t crcval             = mbcrc_calc_block(&newpkt->buffer[0], newpkt->size);
+    newpkt->size               += 2;
+    newpkt->buffer[crcpos]      = crcval & 0xff;
+    newpkt->buffer[crcpos+1]    = (crcval >> 8) & 0xff;
+}
+
+
+static void sub_qualify_modbus(pkt_t* pkt) {
+/// CRC and sequence are already handled by sub_readframe_modbus()
+}
+
+static bool sub_lowprio_modbus(pkt_t* pkt) {
+    return false;
+}
+
+
+static const sub_framing_t sub_framing_modbus = {
+    .tx_overhead    = 17,
+    .write_frame    = &sub_writeframe_modbus,
+    .write_footer   = &sub_writefooter_modbus,
+    .read_frame     = &sub_readframe_modbus,
+    .qualify        = &sub_qualify_modbus,
+    .lowprio        = &sub_lowprio_modbus
+};
+#endif
+
+
+#if (OTTER_FEATURE_MPIPE == ENABLED)
+static void sub_readframe_mpipe(user_endpoint_t* endpoint, pkt_t* newpkt, uint8_t* data, size_t datalen) {
+/// Frames are stored as they come in, without the FF55 sync
+    memcpy(&newpkt->buffer[0], data, datalen);
+}
+
+
 static void sub_writeframe_mpipe(user_endpoint_t* endpoint, pkt_t* newpkt, uint8_t* data, size_t datalen) {
-/// Adds 8 bytes to packet
+/// Adds 8 bytes to packet, or 12 if the interface has negotiated the extended
+/// header.  newpkt->intf must be resolved already.
+    size_t  hdr_size    = 8;
+    uint8_t control     = 0;    ///@todo Set rest of Control Field based on Cli
+    
+#   if (OTTER_FEATURE_MPEXTHDR == ENABLED)
+    control = MPIPE_CTL_EXTOK;
+    if (mpipe_exthdr_get(newpkt->intf)) {
+        control            |= MPIPE_CTL_EXTHDR;
+        newpkt->buffer[8]   = (uint8_t)sub_session;
+        newpkt->buffer[9]   = (newpkt->sequence >> 24) & 0xff;
+        newpkt->buffer[10]  = (newpkt->sequence >> 16) & 0xff;
+        newpkt->buffer[11]  = (newpkt->sequence >> 8) & 0xff;
+        hdr_size           += MPIPE_EXTHDR_SIZE;
+    }
+#   endif
+    
     newpkt->buffer[0] = 0xff;
     newpkt->buffer[1] = 0x55;
     newpkt->buffer[2] = 0;
     newpkt->buffer[3] = 0;
-    newpkt->buffer[4] = (datalen >> 8) & 0xff;
-    newpkt->buffer[5] = datalen & 0xff;
+    newpkt->buffer[4] = ((datalen + hdr_size - 8) >> 8) & 0xff;
+    newpkt->buffer[5] = (datalen + hdr_size - 8) & 0xff;
     newpkt->buffer[6] = 255 & newpkt->sequence;
-    newpkt->buffer[7] = 0;      ///@todo Set Control Field here based on Cli
-    newpkt->size     += 8;      // Header is 8 bytes, need to add this to size value.
+    newpkt->buffer[7] = control;
+    newpkt->size     += hdr_size;
     
-    memcpy(&newpkt->buffer[8], data, datalen);
-}
-
-
-static void sub_footer_null(pkt_t* newpkt) {
+    memcpy(&newpkt->buffer[hdr_size], data, datalen);
 }
 
 
@@ -267,121 +528,81 @@ static void sub_writefooter_mpipe(pkt_t* newpkt) {
 }
 
 
-static void sub_writefooter_modbus(pkt_t* newpkt) {
-/// Adds two bytes to packet
-    size_t crcpos               = newpkt->size;
-    uint16_t crcval             = mbcrc_calc_block(&newpkt->buffer[0], newpkt->size);
-    newpkt->size               += 2;
-    newpkt->buffer[crcpos]      = crcval & 0xff;
-    newpkt->buffer[crcpos+1]    = (crcval >> 8) & 0xff;
+static void sub_qualify_mpipe(pkt_t* pkt) {
+/// MPipe uses Sequence-ID for message matching.  The CRC has already been
+/// checked by the reader as the frame came in, and bad frames dropped.
+/// A frame with the extended header also carries the upper 24 bits of the
+/// sequence and the session, and it tells us the peer can take extended
+/// headers from now on.
+    pkt->sequence   = pkt->buffer[4];
+    pkt->session    = -1;
+    pkt->crcqual    = 0;
+    if ((pkt->buffer[5] & MPIPE_CTL_EXTHDR) && (pkt->size >= (6 + MPIPE_EXTHDR_SIZE))) {
+        pkt->session    = pkt->buffer[6];
+        pkt->sequence  |= ((uint32_t)pkt->buffer[7] << 24)
+                        | ((uint32_t)pkt->buffer[8] << 16)
+                        | ((uint32_t)pkt->buffer[9] << 8);
+        mpipe_exthdr_set(pkt->intf);
+    }
 }
 
 
-static pkt_t* sub_pktlist_add(user_endpoint_t* endpoint, void* intf, pktlist_t* plist, uint8_t* data, size_t size, bool iswrite) {
-    size_t padding;
-    void (*put_frame)(user_endpoint_t*, pkt_t*, uint8_t*, size_t);
-    void (*put_footer)(pkt_t*);
-    pkt_t* newpkt = NULL;
-    int errcode = 0;
+static bool sub_lowprio_mpipe(pkt_t* pkt) {
+/// Logger output (ALP ID 4) is the low-priority traffic.  The first ALP
+/// record header follows the frame header: [0] Flags, [1] Length, [2] ID,
+/// [3] Command.
+    size_t alp = 6;
     
-    if ((endpoint == NULL) || (plist == NULL)) {
-        errcode = -1;
-        goto sub_pktlist_add_ERR;
+    if (pkt->buffer[5] & MPIPE_CTL_EXTHDR) {
+        alp += MPIPE_EXTHDR_SIZE;
     }
-    
-    newpkt = talloc_size(plist, sizeof(pkt_t));
-    if (newpkt == NULL) {
-        errcode = -2;
-        goto sub_pktlist_add_ERR;
-    }
-    
-    // Offset is dependent if we are writing a header (8 bytes) or not.
-    ///@todo this code can be optimized quite a lot
-    if (iswrite) {
-        switch (cliopt_getio()) {
-            case IO_mpipe:
-                padding     = 8;
-                put_frame   = &sub_writeframe_mpipe;
-                put_footer  = &sub_writefooter_mpipe;
-                break;
-            
-            case IO_modbus:
-                padding     = 17;
-                put_frame   = &sub_writeframe_modbus;
-                put_footer  = &sub_writefooter_modbus;
-                break;
-            
-            default:
-                padding     = 0;
-                put_frame   = &sub_frame_null;
-                put_footer  = &sub_footer_null;
-                break;
-        }
-    }
-    else {
-        switch (cliopt_getio()) {
-            case IO_mpipe:
-                put_frame   = &sub_frame_null; ///@todo &sub_readframe_mpipe;
-                break;
-            
-            case IO_modbus:
-                put_frame   = &sub_readframe_modbus;
-                break;
-            
-            default:
-                put_frame   = &sub_frame_null;
-                break;
-        }
-        put_footer  = &sub_footer_null;
-        padding     = 0;
-    }
-    
-    pthread_mutex_lock(&plist->mutex);
-    
-    // Sequence is written first, using the incrementer.  Protocol functions
-    // may or may overwrite sequence with their own values.
-    newpkt->sequence = plist->txnonce++;
-    
-    // Setup list connections for the new packet
-    // Also allocate the buffer of the new packet
-    // The starting size is the payload size, and put_frame() will modify it.
+    return (pkt->size >= (alp + 4)) && (pkt->buffer[alp+2] == 4);
+}
+
+
+static const sub_framing_t sub_framing_mpipe = {
+    .tx_overhead    = 8 + MPIPE_EXTHDR_SIZE,
+    .write_frame    = &sub_writeframe_mpipe,
+    .write_footer   = &sub_writefooter_mpipe,
+    .read_frame     = &sub_readframe_mpipe,     ///@todo RX frame processing
+    .qualify        = &sub_qualify_mpipe,
+    .lowprio        = &sub_lowprio_mpipe
+};
+#endif
+
+
+#if (OTTER_FEATURE_MPIPE == ENABLED) && (OTTER_FEATURE_MODBUS == ENABLED)
+static const sub_framing_t* sub_framing = &sub_framing_mpipe;
+#   define SUB_FRAMING  sub_framing
+
+static void sub_framing_resolve(void) {
+    sub_framing = (cliopt_getio() == IO_modbus) ? &sub_framing_modbus : &sub_framing_mpipe;
+}
+
+#elif (OTTER_FEATURE_MPIPE == ENABLED)
+#   define SUB_FRAMING  (&sub_framing_mpipe)
+#   define sub_framing_resolve()    do { } while(0)
+
+#else
+#   define SUB_FRAMING  (&sub_framing_modbus)
+#   define sub_framing_resolve()    do { } while(0)
+#endif
+
+
+
+static void sub_pktlist_link(void* intf, pktlist_t* plist, pkt_t* newpkt) {
+/// Links a completed packet to the end of the list.  Must be called with the
+/// plist mutex held.  intf has already been resolved by the caller.
     newpkt->parent  = plist;
     newpkt->prev    = plist->last;
     newpkt->next    = NULL;
-    newpkt->size    = size;
-    padding         = ((padding + size + OTTER_PARAM_ENCALIGN-1) / OTTER_PARAM_ENCALIGN) * OTTER_PARAM_ENCALIGN;
-    newpkt->buffer  = talloc_size(newpkt, padding);
-    if (newpkt->buffer == NULL) {
-        errcode =  -3;
-        goto sub_pktlist_add_TERM;
-    }
-    
-    // put_frame() with either write the TX frame or process the RX frame.
-    // If there is no encryption, this doesn't do much, if anything, for RX.
-    // If there's an error, we scrub the packet and exit with error.
-    put_frame(endpoint, newpkt, data, size);
-    if (newpkt->size == 0) {
-        errcode = -4;
-        goto sub_pktlist_add_TERM;
-    }
-    
+
     // Packet Frame is created successfully.
     // Save timestamp: this may or may not get used, but it's saved anyway.
     // The default sequence (which is available to frame generation) is
     // from the rotating nonce of the plist.
-    newpkt->tstamp = time(NULL);
-
-    ///@note If no explicit interface, use the interface attached to dterm's
-    /// (dterm is the controlling terminal) active endpoint.  "Active endpoint"
-    /// stipulates a device on the network and its access level, typically
-    /// specified by mknode and/or chuser commands.  In normal usage, packets
-    /// for transmission are implicitly routed and packets that are received
-    /// are explicitly routed.
-    if (intf == NULL) {
-        devtab_endpoint_t* dev_ep = devtab_resolve_endpoint(endpoint->node);
-        intf = dev_ep->intf;
-    }
-    newpkt->intf = intf;
+    newpkt->tstamp  = time(NULL);
+    newpkt->intf    = intf;
     
     // List is empty, so start the list
     if (plist->last == NULL) {
@@ -401,22 +622,302 @@ static pkt_t* sub_pktlist_add(user_endpoint_t* endpoint, void* intf, pktlist_t*
         }
     }
     
-    put_footer(newpkt);
-    
     // Increment the list size to account for new packet.
-    // If the list is longer than max allowable size, delete oldest packet
+    // Room has already been made by sub_pktlist_overflow().
     plist->size++;
-    if (plist->size > plist->max) {
-        sub_delpkt(plist, plist->front);
+}
+
+
+
+
+static void sub_deadline(struct timespec* deadline, int ms) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec   += ms / 1000;
+    deadline->tv_nsec  += (long)(ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+
+static bool sub_pktlist_evict(pktlist_t* plist, bool lowprio_only) {
+/// Deletes the oldest packet that hasn't been parsed yet, or the oldest low-
+/// priority one.  Packets before the cursor may be getting parsed right now,
+/// so they are never dropped.
+    pkt_t* victim;
+    
+    for (victim=plist->cursor; victim!=NULL; victim=victim->next) {
+        if ((lowprio_only == false) || victim->lowprio) {
+            break;
+        }
+    }
+    if (victim == NULL) {
+        return false;
+    }
+    if (lowprio_only)   plist->drop_lowprio++;
+    else                plist->drop_oldest++;
+    sub_delpkt(plist, victim);
+    return true;
+}
+
+
+static int sub_pktlist_overflow(pktlist_t* plist, pkt_t* newpkt) {
+/// Must be called with the plist mutex held, before newpkt is linked.  Makes
+/// room for newpkt according to the list policy, and returns 0, or returns
+/// negative if newpkt should be refused.
+    struct timespec deadline;
+    
+    if (plist->size < plist->max) {
+        return 0;
+    }
+    
+    switch (plist->policy) {
+        default:
+        case PKTLIST_DROPOLDEST:
+            if (sub_pktlist_evict(plist, false)) {
+                return 0;
+            }
+            break;
+            
+        case PKTLIST_DROPNEWEST:
+            break;
+            
+        case PKTLIST_BLOCK:
+            sub_deadline(&deadline, plist->block_ms);
+            while (plist->size >= plist->max) {
+                if (pthread_cond_timedwait(&plist->space_cond, &plist->mutex, &deadline) != 0) {
+                    break;
+                }
+            }
+            if (plist->size < plist->max) {
+                return 0;
+            }
+            plist->block_timeouts++;
+            break;
+            
+        case PKTLIST_PRIORITY:
+            // Oldest low-priority packet goes first.  Otherwise a new low-
+            // priority packet is refused, and anything else evicts the oldest.
+            if (sub_pktlist_evict(plist, true)) {
+                return 0;
+            }
+            if (newpkt->lowprio) {
+                plist->drop_lowprio++;
+                return -1;
+            }
+            if (sub_pktlist_evict(plist, false)) {
+                return 0;
+            }
+            break;
+    }
+    
+    plist->drop_newest++;
+    return -1;
+}
+
+
+static pkt_t* sub_inbox_pop(pktinbox_t* inbox) {
+/// Consumer side.  Only the thread holding the plist mutex writes tail.
+    size_t tail = inbox->tail;
+    pkt_t* pkt;
+    
+    if (__atomic_load_n(&inbox->head, __ATOMIC_ACQUIRE) == tail) {
+        return NULL;
+    }
+    pkt = inbox->slot[tail & inbox->mask];
+    __atomic_store_n(&inbox->tail, tail+1, __ATOMIC_RELEASE);
+    return pkt;
+}
+
+static pkt_t* sub_inbox_next(pktlist_t* plist) {
+/// Round-robin across inboxes, so one busy producer can't starve the others.
+/// Inboxes are only ever appended, and the chain is published atomically.
+    pktinbox_t* start;
+    pktinbox_t* inbox;
+    pkt_t* pkt;
+    
+    start = plist->inbox_cursor;
+    if (start == NULL) {
+        start = __atomic_load_n(&plist->inbox, __ATOMIC_ACQUIRE);
+        if (start == NULL) {
+            return NULL;
+        }
+    }
+    inbox = start;
+    do {
+        pkt     = sub_inbox_pop(inbox);
+        inbox   = __atomic_load_n(&inbox->next, __ATOMIC_ACQUIRE);
+        if (inbox == NULL) {
+            inbox = __atomic_load_n(&plist->inbox, __ATOMIC_ACQUIRE);
+        }
+        if (pkt != NULL) {
+            break;
+        }
+    } while (inbox != start);
+    
+    plist->inbox_cursor = inbox;
+    return pkt;
+}
+
+static void sub_inbox_drain(pktlist_t* plist) {
+/// Must be called with the plist mutex held.  Moves posted packets into the
+/// list, applying the list policy to each.  With BLOCK, draining stops when
+/// the list is full, and the producer waits in pktlist_lease() once the ring
+/// runs out, because waiting here would be waiting on ourselves.
+    pkt_t* pkt;
+    
+    while ((plist->policy != PKTLIST_BLOCK) || (plist->size < plist->max)) {
+        pkt = sub_inbox_next(plist);
+        if (pkt == NULL) {
+            break;
+        }
+        if (sub_pktlist_overflow(plist, pkt) != 0) {
+            sub_pktfree(plist, pkt);
+            continue;
+        }
+        sub_pktlist_link(pkt->intf, plist, pkt);
+    }
+}
+
+
+static int sub_pktlist_reclaim(pktlist_t* plist) {
+/// Must be called with the plist mutex held, when the ring has no free slot.
+/// Frees a slot according to the list policy and returns 0, or returns
+/// negative if the new packet should be refused.  Slots held outside the
+/// list can't be reclaimed, so it may return 0 with the ring still full.
+    struct timespec deadline;
+    
+    sub_inbox_drain(plist);
+    if (sub_slotalloc(plist) != NULL) {
+        return 0;
+    }
+    
+    switch (plist->policy) {
+        default:
+        case PKTLIST_DROPOLDEST:
+            sub_pktlist_evict(plist, false);
+            return 0;
+            
+        case PKTLIST_DROPNEWEST:
+            plist->drop_newest++;
+            return -1;
+            
+        case PKTLIST_BLOCK:
+            sub_deadline(&deadline, plist->block_ms);
+            while (sub_slotalloc(plist) == NULL) {
+                if (pthread_cond_timedwait(&plist->space_cond, &plist->mutex, &deadline) != 0) {
+                    break;
+                }
+            }
+            if (sub_slotalloc(plist) != NULL) {
+                return 0;
+            }
+            plist->block_timeouts++;
+            plist->drop_newest++;
+            return -1;
+            
+        case PKTLIST_PRIORITY:
+            if (sub_pktlist_evict(plist, true) == false) {
+                sub_pktlist_evict(plist, false);
+            }
+            return 0;
+    }
+}
+
+
+static pkt_t* sub_pktlist_add(user_endpoint_t* endpoint, void* intf, pktlist_t* plist, uint8_t* data, size_t size, bool iswrite) {
+    user_endpoint_t active;
+    size_t padding;
+    pkt_t* newpkt = NULL;
+    int errcode = 0;
+    
+    if ((endpoint == NULL) || (plist == NULL)) {
+        errcode = -1;
+        goto sub_pktlist_add_ERR;
+    }
+    
+    // A command can change the endpoint at any time, so the whole packet is
+    // made with one copy of it.
+    user_endpoint_get(&active, endpoint);
+    endpoint = &active;
+    
+    // Room for the header and footer is only needed when writing a frame
+    padding = iswrite ? SUB_FRAMING->tx_overhead : 0;
+    
+    pthread_mutex_lock(&plist->mutex);
+    
+    // Allocate the new packet (with buffer) from the pool
+    padding = ((padding + size + OTTER_PARAM_ENCALIGN-1) / OTTER_PARAM_ENCALIGN) * OTTER_PARAM_ENCALIGN;
+    newpkt  = sub_pktalloc(plist, padding);
+    if (newpkt == NULL) {
+        errcode = -2;
+        goto sub_pktlist_add_TERM;
+    }
+    
+    // Sequence is written first, using the incrementer.  Protocol functions
+    // may or may overwrite sequence with their own values.
+    newpkt->sequence = plist->txnonce++;
+    newpkt->session  = -1;
+    
+    // The interface is resolved before framing, because the frame header can
+    // depend on what the interface has negotiated.  If there's no explicit
+    // interface, it's the one of dterm's active endpoint (the device set by
+    // mknode and/or chuser).  A device with no bound interface goes to the
+    // one it was last heard on, if that's known, and otherwise it's broadcast
+    // (NULL).  In normal usage, packets for transmission are implicitly
+    // routed and packets that are received are explicitly routed.
+    if (intf == NULL) {
+        intf = devtab_get_route(endpoint->devtab, endpoint->node);
+    }
+    newpkt->intf = intf;
+    
+    // The starting size is the payload size, and the frame op will modify it.
+    newpkt->size    = size;
+    newpkt->crcqual = 0;
+    
+    // Either write the TX frame or process the RX frame.  If there is no
+    // encryption, this doesn't do much, if anything, for RX.
+    // If there's an error, we scrub the packet and exit with error.
+    // Only received frames are ever low-priority.
+    if (iswrite) {
+        SUB_FRAMING->write_frame(endpoint, newpkt, data, size);
+        if (newpkt->size == 0) {
+            errcode = -4;
+            goto sub_pktlist_add_TERM;
+        }
+        SUB_FRAMING->write_footer(newpkt);
+        newpkt->lowprio = false;
+        
+        // The response to this packet will tell where its device is
+        devtab_route_expect(endpoint->devtab, endpoint->node, newpkt->sequence);
     }
+    else {
+        SUB_FRAMING->read_frame(endpoint, newpkt, data, size);
+        if (newpkt->size == 0) {
+            errcode = -4;
+            goto sub_pktlist_add_TERM;
+        }
+        newpkt->lowprio = SUB_FRAMING->lowprio(newpkt);
+    }
+    
+    if (sub_pktlist_overflow(plist, newpkt) != 0) {
+        errcode = -5;
+        goto sub_pktlist_add_TERM;
+    }
+    sub_pktlist_link(intf, plist, newpkt);
     
     sub_pktlist_add_TERM:
     if ((newpkt != NULL) && (errcode != 0)) {
-        talloc_free(newpkt);
+        sub_pktfree(plist, newpkt);
         newpkt = NULL;
     }
     
     pthread_mutex_unlock(&plist->mutex);
+    
+    if ((newpkt != NULL) && (iswrite == false)) {
+        sub_bell_ring(plist);
+    }
     return newpkt;
     
     sub_pktlist_add_ERR:
@@ -441,14 +942,74 @@ int pktlist_init(pktlist_t** plist, size_t max) {
         rc = -2;
         goto pktlist_init_ERR;
     }
-    if (pthread_mutex_init(&newlist->mutex, NULL) != 0) {
+    if ((pthread_mutex_init(&newlist->mutex, NULL) != 0)
+    ||  (pthread_cond_init(&newlist->space_cond, NULL) != 0)) {
         rc = -3;
         goto pktlist_init_ERR;
     }
     
     sub_pktlist_clear(newlist);
     newlist->txnonce  = 0;
+    sub_framing_resolve();
+    if (sub_session < 0) {
+        sub_session = (int)((getpid() ^ time(NULL)) & 255);
+    }
     newlist->max      = max;
+    newlist->inbox          = NULL;
+    newlist->inbox_cursor   = NULL;
+    newlist->bell_pending   = 0;
+    newlist->bell_fd[0]     = -1;
+    newlist->bell_fd[1]     = -1;
+    newlist->policy         = PKTLIST_DROPOLDEST;
+    newlist->block_ms       = OTTER_PARAM_PKTBLOCKMS;
+    newlist->drop_oldest    = 0;
+    newlist->drop_newest    = 0;
+    newlist->drop_lowprio   = 0;
+    newlist->block_timeouts = 0;
+    newlist->alloc_fallback = 0;
+    
+    // The ring has room for the list, one more for the packet that is added
+    // just before the oldest one gets dropped, and some reserve for packets
+    // that are leased-out by producers.
+    newlist->ring_size  = max + 1 + OTTER_PARAM_PKTRESERVE;
+    newlist->ring_next  = 0;
+    if (newlist->ring_size > 65535) {
+        rc = -4;
+        goto pktlist_init_ERR;
+    }
+    newlist->ring = talloc_zero_size(newlist, newlist->ring_size * sizeof(pkt_t));
+    if (newlist->ring == NULL) {
+        rc = -5;
+        goto pktlist_init_ERR;
+    }
+    for (size_t i=0; i<newlist->ring_size; i++) {
+        newlist->ring[i].slot   = (int)i;
+        newlist->ring[i].parent = NULL;
+    }
+    
+    // Each size class can cover the whole ring
+    newlist->slab[0].bufsize    = OTTER_PARAM_PKTSMALL;
+    newlist->slab[1].bufsize    = OTTER_PARAM_PKTBUFSIZE;
+    for (int c=0; c<PKTLIST_NUMCLASSES; c++) {
+        pktslab_t* slab     = &newlist->slab[c];
+        slab->count         = newlist->ring_size;
+        slab->free_count    = slab->count;
+        slab->base          = talloc_size(newlist, slab->count * slab->bufsize);
+        slab->free_stack    = talloc_size(newlist, slab->count * sizeof(uint16_t));
+        if ((slab->base == NULL) || (slab->free_stack == NULL)) {
+            rc = -6;
+            goto pktlist_init_ERR;
+        }
+        for (size_t i=0; i<slab->count; i++) {
+            slab->free_stack[i] = (uint16_t)(slab->count - 1 - i);
+        }
+    }
+    
+    if (sub_bell_open(newlist) != 0) {
+        rc = -7;
+        goto pktlist_init_ERR;
+    }
+    
     *plist = newlist;
     return 0;
     
@@ -460,6 +1021,8 @@ int pktlist_init(pktlist_t** plist, size_t max) {
 
 void pktlist_free(pktlist_t* plist) {
     if (plist != NULL) {
+        sub_bell_close(plist);
+        pthread_cond_destroy(&plist->space_cond);
         pthread_mutex_destroy(&plist->mutex);
         talloc_free(plist);
     }
@@ -467,8 +1030,14 @@ void pktlist_free(pktlist_t* plist) {
 
 
 void pktlist_empty(pktlist_t* plist) {
+/// Also drains the inboxes, so it must be called from the consumer side.
+    pkt_t* pkt;
+
     if (plist != NULL) {
         pthread_mutex_lock(&plist->mutex);
+        while ((pkt = sub_inbox_next(plist)) != NULL) {
+            sub_pktfree(plist, pkt);
+        }
         sub_pktlist_empty(plist);
         sub_pktlist_clear(plist);
         pthread_mutex_unlock(&plist->mutex);
@@ -495,6 +1064,142 @@ pkt_t* pktlist_add_rx(user_endpoint_t* endpoint, void* intf,  pktlist_t* plist,
 
 
 
+pkt_t* pktlist_lease(pktlist_t* plist, size_t size) {
+/// Leased packets are not in the list.  The caller writes the frame directly
+/// into pkt->buffer (up to pkt->bufsize bytes) and then commits it.
+    pkt_t* pkt = NULL;
+
+    if (plist != NULL) {
+        pthread_mutex_lock(&plist->mutex);
+        pkt = sub_pktalloc(plist, size);
+        pthread_mutex_unlock(&plist->mutex);
+        
+        if (pkt != NULL) {
+            pkt->parent = plist;
+            pkt->prev   = NULL;
+            pkt->next   = NULL;
+        }
+    }
+    
+    return pkt;
+}
+
+
+pktinbox_t* pktlist_inbox_open(pktlist_t* plist) {
+/// Opens an inbox for one producer thread.  It has room for every slot in the
+/// ring, and it lives as long as the pktlist does.
+    pktinbox_t* inbox;
+    size_t cap;
+    
+    if (plist == NULL) {
+        return NULL;
+    }
+    // Inbox depth doesn't limit the RX depth, which is set by max.  It only
+    // has to be big enough never to fill up, so it's rounded up to a power
+    // of two.
+    for (cap=1; cap<plist->ring_size; cap<<=1);
+    
+    pthread_mutex_lock(&plist->mutex);
+    inbox = talloc_zero_size(plist, sizeof(pktinbox_t));
+    if (inbox != NULL) {
+        inbox->slot = talloc_size(inbox, cap * sizeof(pkt_t*));
+        if (inbox->slot == NULL) {
+            talloc_free(inbox);
+            inbox = NULL;
+        }
+    }
+    if (inbox != NULL) {
+        pktinbox_t** link = &plist->inbox;
+        
+        inbox->mask     = cap - 1;
+        inbox->parent   = plist;
+        inbox->next     = NULL;
+        while (*link != NULL) {
+            link = &(*link)->next;
+        }
+        __atomic_store_n(link, inbox, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&plist->mutex);
+    
+    return inbox;
+}
+
+
+pkt_t* pktlist_post_rx(pktinbox_t* inbox, void* intf, pkt_t* pkt, size_t size) {
+/// Posts a leased packet to the inbox without copying or locking.  The buffer
+/// must already contain the frame as pktlist_add_rx() would store it, so this
+/// is only suitable for protocols that do no RX frame processing (i.e. MPipe).
+///
+/// The list policy is applied when the packet is moved into the list.  The
+/// inbox has room for every slot in the ring, so it can only fill up with
+/// packets allocated outside the ring, and then the packet is released.
+    pktlist_t* plist;
+    size_t head;
+    
+    if ((inbox == NULL) || (pkt == NULL)) {
+        return NULL;
+    }
+    if ((size == 0) || (size > pkt->bufsize)) {
+        pktlist_release(pkt);
+        return NULL;
+    }
+    
+    plist   = inbox->parent;
+    head    = inbox->head;
+    if ((head - __atomic_load_n(&inbox->tail, __ATOMIC_ACQUIRE)) > inbox->mask) {
+        __atomic_add_fetch(&plist->drop_newest, 1, __ATOMIC_RELAXED);
+        pktlist_release(pkt);
+        return NULL;
+    }
+    
+    pkt->size       = size;
+    pkt->lowprio    = SUB_FRAMING->lowprio(pkt);
+    pkt->intf       = intf;
+    pkt->crcqual    = 0;
+    pkt->sequence   = 0;
+    pkt->session    = -1;
+    pkt->tstamp     = time(NULL);
+    pkt->prev       = NULL;
+    pkt->next       = NULL;
+    
+    HEX_DUMP(pkt->buffer, pkt->size, "%zu Bytes Queued\n", pkt->size);
+    
+    inbox->slot[head & inbox->mask] = pkt;
+    __atomic_store_n(&inbox->head, head+1, __ATOMIC_RELEASE);
+    sub_bell_ring(plist);
+    
+    return pkt;
+}
+
+
+void pktlist_wait(pktlist_t* plist) {
+    uint64_t count;
+    ssize_t rc;
+    
+    if (plist == NULL) {
+        return;
+    }
+    do {
+        rc = read(plist->bell_fd[0], &count, (plist->bell_fd[0] == plist->bell_fd[1]) ? 8 : 1);
+    } while ((rc < 0) && (errno == EINTR));
+    
+    __atomic_exchange_n(&plist->bell_pending, 0, __ATOMIC_ACQ_REL);
+}
+
+
+void pktlist_release(pkt_t* pkt) {
+    pktlist_t* plist;
+    
+    if ((pkt != NULL) && (pkt->parent != NULL)) {
+        plist = pkt->parent;
+        pthread_mutex_lock(&plist->mutex);
+        sub_pktfree(plist, pkt);
+        pthread_mutex_unlock(&plist->mutex);
+    }
+}
+
+
+
 int pktlist_del(pkt_t* pkt) {
     pktlist_t* plist;
 
@@ -538,6 +1243,24 @@ int pktlist_punt(pkt_t* pkt) {
 
 
 
+int pktlist_policy_set(pktlist_t* plist, pktlist_policy_t policy, int block_ms) {
+    if ((plist == NULL) || ((unsigned)policy >= PKTLIST_POLICY_MAX)) {
+        return -1;
+    }
+    pthread_mutex_lock(&plist->mutex);
+    plist->policy   = policy;
+    plist->block_ms = (block_ms > 0) ? block_ms : 0;
+    pthread_cond_broadcast(&plist->space_cond);
+    pthread_mutex_unlock(&plist->mutex);
+    return 0;
+}
+
+
+int pktlist_session(void) {
+    return sub_session;
+}
+
+
 int pktlist_del_sequence(pktlist_t* plist, uint32_t sequence) {
     pkt_t* pkt;
     int rc = 0;
@@ -579,8 +1302,52 @@ pkt_t* pktlist_get(pktlist_t* plist) {
 }
 
 
+pkt_t* pktlist_take(pktlist_t* plist) {
+/// Like pktlist_get(), but the packet is unlinked from the list.  It is still
+/// allocated from plist and must be freed with pktlist_del(), but it doesn't
+/// count against the list size anymore, so it is never dropped on overflow
+/// while somebody else is holding it.
+    pkt_t* pkt = NULL;
+
+    if (plist != NULL) {
+        pthread_mutex_lock(&plist->mutex);
+        if (plist->cursor != NULL) {
+            pkt = plist->cursor;
+            sub_detachpkt(plist, pkt);
+        }
+        pthread_mutex_unlock(&plist->mutex);
+    }
+
+    return pkt;
+}
+
+
+int pktlist_detach(pkt_t* pkt) {
+/// For a packet already returned by pktlist_parse(): same as what
+/// pktlist_take() does to the cursor packet.  If it's already detached, there
+/// is nothing to do.
+    pktlist_t* plist;
+
+    if (pkt == NULL) {
+        return -1;
+    }
+    if (pkt->parent == NULL) {
+        return -2;
+    }
+    plist = pkt->parent;
+
+    pthread_mutex_lock(&plist->mutex);
+    if ((pkt->prev != NULL) || (plist->front == pkt)) {
+        sub_detachpkt(plist, pkt);
+    }
+    pthread_mutex_unlock(&plist->mutex);
+    return 0;
+}
+
+
+
+
 pkt_t* pktlist_parse(int* errcode, pktlist_t* plist) {
-    IO_Type intf;
     int outcode;
     pkt_t* pkt = NULL;
     //time_t      seconds;
@@ -589,9 +1356,10 @@ pkt_t* pktlist_parse(int* errcode, pktlist_t* plist) {
     if (plist == NULL) {
         outcode = -11;
     }
-    // packet list is fine
+    // packet list is fine.  Posted packets are moved into it first.
     else {
         pthread_mutex_lock(&plist->mutex);
+        sub_inbox_drain(plist);
         
         // pktlist is empty if cursor == NULL
         if (plist->cursor == NULL) {
@@ -601,27 +1369,8 @@ pkt_t* pktlist_parse(int* errcode, pktlist_t* plist) {
             pkt             = plist->cursor;
             plist->cursor   = plist->cursor->next;
             pkt->tstamp     = time(NULL);   //;localtime(&seconds);
-            intf            = cliopt_getio();
-            
-            // MPipe uses Sequence-ID for message matching
-            ///@todo move this into pktlist_add() via sub_mpipe_readframe()
-            if (intf == IO_mpipe) {
-                uint16_t crc_val;
-                uint16_t crc_comp;
-            
-                pkt->sequence   = pkt->buffer[4];
-                crc_val         = (pkt->buffer[0] << 8) + pkt->buffer[1];
-                crc_comp        = crc_calc_block(&pkt->buffer[2], pkt->size-2);
-                pkt->crcqual    = (crc_comp ^ crc_val);
-            }
-            else if (intf == IO_modbus) {
-                // do nothing
-            }
-            else {
-                pkt->crcqual  = 0;
-            }
-            
-            outcode = 0;
+            SUB_FRAMING->qualify(pkt);
+            outcode         = 0;
         }
         
         pthread_mutex_unlock(&plist->mutex);
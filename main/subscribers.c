@@ -47,10 +47,13 @@ typedef struct {
 } subscr_item_t;
 
 
+/// The table is read-mostly: parser threads post to it concurrently, while
+/// new/del are rare, so it is guarded by a rwlock.
 typedef struct {
     subscr_item_t**   item;
     size_t            size;
     size_t            alloc;
+    pthread_rwlock_t  lock;
 } subscr_tab_t;
 
 
@@ -117,9 +120,10 @@ subscr_t subscriber_new(subscr_handle_t handle, int alp_id, size_t max_frames, s
         goto subscriber_new_ERR;
     }
 
+    pthread_rwlock_wrlock(&table->lock);
     item = subscr_add(table, alp_id);
     if (item == NULL) {
-        goto subscriber_new_ERR;
+        goto subscriber_new_ERR0;
     }
 
     oldhead     = item->head;
@@ -152,6 +156,7 @@ subscr_t subscriber_new(subscr_handle_t handle, int alp_id, size_t max_frames, s
     if (oldhead != NULL) {
         oldhead->prev   = item->head;
     }
+    pthread_rwlock_unlock(&table->lock);
 
     return (subscr_t)item->head;
     
@@ -159,6 +164,7 @@ subscr_t subscriber_new(subscr_handle_t handle, int alp_id, size_t max_frames, s
     subscriber_new_ERR3:    pthread_mutex_destroy(&item->head->mutex);
     subscriber_new_ERR2:    free(item->head);
     subscriber_new_ERR1:    item->head = oldhead;
+    subscriber_new_ERR0:    pthread_rwlock_unlock(&table->lock);
     subscriber_new_ERR:     return NULL;
 }
 
@@ -169,7 +175,9 @@ void subscriber_del(subscr_handle_t handle, subscr_t subscriber) {
     subscr_node_t*  node    = (subscr_node_t*)subscriber;
 
     if (table != NULL) {
+        pthread_rwlock_wrlock(&table->lock);
         subscr_freenode(node);
+        pthread_rwlock_unlock(&table->lock);
     }
 }
 
@@ -180,7 +188,7 @@ int subscriber_open(subscr_t subscriber, int sigmask) {
     if (node == NULL) {
         return -1;
     }
-    node->sigmask = sigmask;
+    __atomic_store_n(&node->sigmask, sigmask, __ATOMIC_RELEASE);
     return 0;
 }
 
@@ -191,7 +199,7 @@ int subscriber_close(subscr_t subscriber) {
     if (node == NULL) {
         return -1;
     }
-    node->sigmask = 0;
+    __atomic_store_n(&node->sigmask, 0, __ATOMIC_RELEASE);
     return 0;
 }
 
@@ -244,11 +252,12 @@ void subscriber_post(subscr_handle_t handle, int alp_id, int signal, uint8_t* pa
     subscr_node_t*  node;
     
     if (table != NULL) {
+        pthread_rwlock_rdlock(&table->lock);
         item = subscr_search_insert(table, alp_id, false);
         if (item != NULL) {
             node = item->head;
             while (node != NULL) {
-                if (node->sigmask & signal) {
+                if (__atomic_load_n(&node->sigmask, __ATOMIC_ACQUIRE) & signal) {
                     pthread_mutex_lock(&node->mutex);
                     node->cond_inactive = false;
                     pthread_cond_signal(&node->cond);
@@ -257,6 +266,7 @@ void subscriber_post(subscr_handle_t handle, int alp_id, int signal, uint8_t* pa
                 node = node->next;
             }
         }
+        pthread_rwlock_unlock(&table->lock);
     }
 }
 
@@ -272,6 +282,25 @@ void subscriber_post(subscr_handle_t handle, int alp_id, int signal, uint8_t* pa
 
 
 
+static int sub_rwlock_init(pthread_rwlock_t* lock) {
+/// glibc rwlocks prefer readers by default, so a burst of posts could keep a
+/// command from ever adding its subscriber.  Writers go first here.
+    pthread_rwlockattr_t attr;
+    int rc;
+    
+    if (pthread_rwlockattr_init(&attr) != 0) {
+        return -1;
+    }
+#   if defined(__GLIBC__)
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#   endif
+    rc = pthread_rwlock_init(lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    return rc;
+}
+
+
+
 static int subscr_init(subscr_tab_t* table) {
     if (table == NULL) {
         return -3;
@@ -285,6 +314,11 @@ static int subscr_init(subscr_tab_t* table) {
     if (table->item == NULL) {
         return -4;
     }
+    if (sub_rwlock_init(&table->lock) != 0) {
+        free(table->item);
+        table->item = NULL;
+        return -5;
+    }
     
     table->alloc = OTTER_SUBSCR_CHUNK;
     return 0;
@@ -301,6 +335,7 @@ static void subscr_deinit(subscr_tab_t* table) {
             while (--i >= 0) {
                 subscr_freeitem(table->item[i]);
             }
+            pthread_rwlock_destroy(&table->lock);
         }
         table->item     = NULL;
         table->size     = 0;
@@ -23,6 +23,7 @@
 #include "cliopt.h"
 #include "otter_cfg.h"
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -53,6 +54,10 @@ typedef struct {
 
 static user_t   current_user;
 
+/// Endpoint changes are rare (mknode, chuser), and it is read for every
+/// packet, so it's guarded by a read-mostly lock.
+static pthread_rwlock_t endpoint_lock = PTHREAD_RWLOCK_INITIALIZER;
+
 
 
 
@@ -88,6 +93,22 @@ const char* user_typestring_get(void) {
 
 
 
+void user_endpoint_get(user_endpoint_t* dst, user_endpoint_t* endpoint) {
+    pthread_rwlock_rdlock(&endpoint_lock);
+    *dst = *endpoint;
+    pthread_rwlock_unlock(&endpoint_lock);
+}
+
+
+void user_endpoint_set(user_endpoint_t* endpoint, USER_Type usertype, devtab_node_t node) {
+    pthread_rwlock_wrlock(&endpoint_lock);
+    endpoint->usertype  = usertype;
+    endpoint->node      = node;
+    pthread_rwlock_unlock(&endpoint_lock);
+}
+
+
+
 USER_Type user_get_type(const char* type_string) {
     USER_Type usertype;
 